@@ -2,11 +2,50 @@
 
 #include <mpi.h>
 
+#include <cstddef>
+#include <map>
 #include <string>
 #include <vector>
 
 namespace amr {
 namespace lb {
+//
+// PlacementEval: summary statistics of a placement
+// Loads are in the units of the costlist
+//
+struct PlacementEval {
+  int nblocks;
+  int nranks;
+  double load_min;   // min rank load
+  double load_avg;   // avg rank load
+  double makespan;   // max rank load
+  double imbalance;  // makespan / load_avg (1.0 is perfect)
+  double load_p50;   // rank load percentiles
+  double load_p90;
+  double load_p99;
+  int nblocks_min;   // min blocks on a rank
+  int nblocks_max;   // max blocks on a rank
+  double loc_score;  // locality loss, lower is better (0 to 3, see
+                     // PolicyUtils::ComputeLocCost)
+};
+
+//
+// PlacementTelemetry: optional per-call telemetry, filled in when
+// PlacementArgs::telemetry is set. Phases are reported by the policies
+// that ran (e.g. sort, prefix_sum, dp, backtrack, lpt, gather, iterate,
+// alt); composite policies report the phases of their stages, so a phase
+// may accumulate time from more than one stage.
+//
+struct PlacementTelemetry {
+  std::string policy;                      // policy id (auto: the pick)
+  double total_ms = 0;                     // wall time of the whole call
+  std::map<std::string, double> phase_ms;  // per-phase wall time
+  int niters = 0;                          // iterations of iterative stages
+  size_t mem_hwm_bytes = 0;                // largest policy working set
+  bool cache_hit = false;                  // served by the assignment cache
+  PlacementEval eval = {};                 // quality of the final placement
+};
+
 //
 // PlacementArgs: minimal placement inputs and outputs
 // Valid placement policy names:
@@ -17,8 +56,20 @@ namespace lb {
 // - "cdpi50": CDP + iterative improvements, not used in final runs
 // - "cdpi250": CDP + iterative improvements, not used in final runs
 // - "hybrid<X>": CPLX, internal name (X in 0-100). E.g. hybrid50
+// - "cdpi<N>dl<M>", "cdpidl<M>", "hybrid<X>alt<A>dl<M>": anytime variants,
+//   M: wall-clock budget in ms. The best placement found within the
+//   budget is returned
+// - "auto": picks one of baseline/lpt/cdp/cdpc512/hybrid25 per call, based
+//   on observed makespan and solve time. Choices are logged at INFO
 // - "cdpc<C>par<P>": CDP-Chunked for higher parallelism
 //   C: chunk size (512), P: parallelism (8 for 4096 ranks)
+// - "nodecdp", "nodelpt": node-hierarchical placement. Blocks are split into
+//   contiguous per-node ranges, then placed within each node via CDP/LPT
+// - "robust", "robustlpt": CDP/LPT followed by moves that minimize the
+//   90th-percentile rank load, given per-block cost variances (cost_vars).
+//   Without cost_vars, a coefficient of variation of 0.1 is assumed
+// - "bnb": exact branch-and-bound (5s budget), as an optimality reference
+//   for small instances. Needs no Gurobi, unlike the ILP policy
 //
 // See kPolicyMap in `src/policy_utils.cc` for more
 //
@@ -27,6 +78,9 @@ struct PlacementArgs {
   std::vector<double> const &costlist; // size assumed to be nblocks
   std::vector<int> &ranklist;          // will be resized to nblocks
   int nranks;                          // number of policy ranks
+  PlacementTelemetry *telemetry = nullptr;  // optional, filled if set
+  std::vector<double> const *cost_vars = nullptr;  // optional, per-block
+                                                   // cost variance (robust)
 };
 
 //
@@ -41,6 +95,24 @@ struct PlacementArgsMpi {
   MPI_Comm comm;         // MPI communicator
 };
 
+//
+// ResizeArgs: re-placement inputs and outputs for a change in rank count
+// ranklist_old is a placement over nranks_old ranks. By default, old rank r
+// keeps its id if r < nranks and is gone otherwise (and new ranks start
+// empty); rank_map overrides this (rank_map[r]: new id of old rank r, or
+// -1 if it is gone; no two old ranks may share a new id)
+//
+struct ResizeArgs {
+  std::string policy_name;              // policy for the new placement
+  std::vector<double> const &costlist;  // size assumed to be nblocks
+  std::vector<int> const &ranklist_old; // placement over nranks_old
+  int nranks_old;
+  std::vector<int> &ranklist;           // will be resized to nblocks
+  int nranks;                           // new number of ranks
+  std::vector<int> const *rank_map = nullptr;  // optional, size nranks_old
+  int nblocks_moved = 0;                // output: blocks that change ranks
+};
+
 //
 // LoadBalance: top-level interface for placement
 //
@@ -57,6 +129,140 @@ public:
   // Returns 0 on success, 1 on failure
   //
   static int AssignBlocksMpi(PlacementArgsMpi args);
+
+  //
+  // AssignBlocksResize: balanced placement over args.nranks that moves as
+  // few blocks as possible from args.ranklist_old. Works with any policy:
+  // contiguous policies shift their range boundaries, in rank order, and
+  // others reuse the old placement, where balance permits
+  // Returns 0 on success, -1 on failure
+  //
+  static int AssignBlocksResize(ResizeArgs &args);
+
+  //
+  // EvaluatePlacement: compute PlacementEval for a placement, with one loop
+  // over (costlist, ranklist) for loads and one over ranklist for locality.
+  // nthreads > 1 splits the blocks across threads for large inputs.
+  // Returns 0 on success, -1 on invalid input
+  //
+  static int EvaluatePlacement(std::vector<double> const &costlist,
+                               std::vector<int> const &ranklist, int nranks,
+                               PlacementEval &eval, int nthreads = 1);
+};
+
+//
+// LBTriggerOpts: cost model for LBTrigger. All costs are in the units of
+// the costlist (e.g. us of compute per block per timestep)
+//
+struct LBTriggerOpts {
+  double migration_cost = 0;  // cost of migrating one block (0: ignore)
+  int horizon = 10;           // timesteps a new placement is expected to last
+  double ewma_alpha = 0.5;    // smoothing for the observed history
+};
+
+//
+// LBTrigger: decides whether rebalancing pays off. A placement is
+// predicted to cut the makespan to load_avg * (imbalance observed right
+// after recent placements), saving the difference on every timestep
+// until the next trigger (opts.horizon). Rebalancing is worth it if that
+// exceeds the measured placement time plus the expected migration cost
+// (recent fraction of blocks moved * nblocks * opts.migration_cost).
+//
+// Call ShouldTrigger with current costs and placement, and RecordPlacement
+// after each placement to update the history. Mesh changes that leave
+// blocks without a rank must still be placed, regardless of the trigger
+//
+class LBTrigger {
+public:
+  explicit LBTrigger(LBTriggerOpts const &opts = LBTriggerOpts());
+
+  bool ShouldTrigger(std::vector<double> const &costlist,
+                     std::vector<int> const &ranklist, int nranks);
+
+  //
+  // RecordPlacement: ranklist is the new placement, placement_cost the
+  // time it took (costlist units), nblocks_moved the blocks that changed
+  // ranks (-1 if unknown)
+  //
+  void RecordPlacement(std::vector<double> const &costlist,
+                       std::vector<int> const &ranklist, int nranks,
+                       double placement_cost, int nblocks_moved);
+
+  // Predicted benefit and cost from the last ShouldTrigger call
+  double LastGain() const { return last_gain_; }
+  double LastCost() const { return last_cost_; }
+
+  // Reset: forget all recorded placements, as if newly constructed
+  void Reset();
+
+private:
+  const LBTriggerOpts opts_;
+
+  double imbalance_after_;  // EWMA of imbalance right after placement
+  double placement_cost_;   // EWMA of placement time
+  double moved_frac_;       // EWMA of fraction of blocks migrated
+  int nplacements_;
+
+  double last_gain_;
+  double last_cost_;
+};
+
+//
+// PlacementService: offloads placement to a reserved helper rank. Every
+// other rank of comm is a client, and client calls are collective over the
+// clients, with the same arguments. Only the leader (the lowest client
+// rank) sends the request (policy name, nranks, costlist); the helper
+// places once and fans the reply (rv, ranklist) out to all clients. The
+// helper calls Serve(), which answers requests until the clients call
+// Shutdown(). All messages are point-to-point on comm, using tags reserved
+// by the service.
+//
+// Typical use: SplitHelper() to carve the helper out of the job, the helper
+// runs Serve(), and application ranks place through AssignBlocks(), or
+// Post() early and Wait() when the placement is needed
+//
+class PlacementService {
+public:
+  PlacementService(MPI_Comm comm, int helper_rank);
+
+  //
+  // SplitHelper: app_comm is comm without helper_rank (MPI_COMM_NULL on
+  // the helper). Collective over comm. Returns 0 on success
+  //
+  static int SplitHelper(MPI_Comm comm, int helper_rank, MPI_Comm *app_comm);
+
+  // Serve: helper side. Returns 0 once the clients call Shutdown()
+  int Serve();
+
+  //
+  // AssignBlocks: client side, blocking. Same semantics as
+  // LoadBalance::AssignBlocks (telemetry is not forwarded)
+  //
+  int AssignBlocks(PlacementArgs args);
+
+  //
+  // Post/Wait: split-phase AssignBlocks. costlist must stay valid until
+  // Wait() returns. One request may be outstanding at a time
+  //
+  int Post(std::string const &policy_name, std::vector<double> const &costlist,
+           int nranks);
+
+  int Wait(std::vector<int> &ranklist);
+
+  // Shutdown: tell the helper the clients are done
+  int Shutdown();
+
+private:
+  bool IsLeader() const;
+
+  const MPI_Comm comm_;
+  const int helper_rank_;
+  const int leader_rank_;
+
+  int hdr_[4];  // request header, must outlive the sends
+  std::string policy_name_;
+  MPI_Request reqs_[3];
+  bool pending_;
 };
 } // namespace lb
 } // namespace amr
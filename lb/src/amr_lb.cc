@@ -2,15 +2,36 @@
 
 #include "lb-common/lb_policies.h"
 #include "lb-common/policy_utils.h"
+#include "lb-common/telemetry.h"
+#include "placement_eval.h"
 #include "tools-common/logging.h"
 
 namespace amr {
 namespace lb {
 int LoadBalance::AssignBlocks(PlacementArgs args) {
   Logging::Init("amr_lb");
+  Telemetry::ScopedSink sink(args.telemetry);
+  double ts_beg = Deadline::NowMs();
+
   auto& policy = PolicyUtils::GetPolicy(args.policy_name.c_str());
-  return LoadBalancePolicies::AssignBlocks(policy, args.costlist, args.ranklist,
-                                           args.nranks);
+  Telemetry::Begin(args.telemetry, policy.id);
+
+  int rv;
+  if (policy.policy == LoadBalancePolicy::kPolicyRobust and
+      args.cost_vars != nullptr) {
+    rv = LoadBalancePolicies::AssignBlocksRobust(
+        args.costlist, *args.cost_vars, args.ranklist, args.nranks,
+        policy.robust_opts);
+  } else {
+    rv = LoadBalancePolicies::AssignBlocks(policy, args.costlist,
+                                           args.ranklist, args.nranks);
+  }
+  if (rv == 0) {
+    Telemetry::Finish(args.telemetry, args.costlist, args.ranklist,
+                      args.nranks, ts_beg);
+  }
+
+  return rv;
 }
 
 int LoadBalance::AssignBlocksMpi(PlacementArgsMpi args) {
@@ -20,7 +41,39 @@ int LoadBalance::AssignBlocksMpi(PlacementArgsMpi args) {
   // retaining for compatibility for now
   return LoadBalancePolicies::AssignBlocksCached(
       pin.policy_name.c_str(), pin.costlist, pin.ranklist, args.nranks,
-      args.my_rank, args.comm);
+      args.my_rank, args.comm, pin.telemetry, nullptr, pin.cost_vars);
+}
+
+int LoadBalance::AssignBlocksResize(ResizeArgs& args) {
+  Logging::Init("amr_lb");
+
+  std::vector<int> rank_map;
+  if (args.rank_map != nullptr) {
+    rank_map = *args.rank_map;
+  } else {
+    for (int rank = 0; rank < args.nranks_old; rank++) {
+      rank_map.push_back(rank < args.nranks ? rank : -1);
+    }
+  }
+
+  if (rank_map.size() != args.nranks_old) {
+    MLOG(MLOG_WARN, "[Resize] rank_map size %zu != nranks_old %d",
+         rank_map.size(), args.nranks_old);
+    return -1;
+  }
+
+  auto policy = PolicyUtils::GetPolicy(args.policy_name.c_str());
+  return LoadBalancePolicies::AssignBlocksResize(
+      policy, args.costlist, args.ranklist_old, rank_map, args.ranklist,
+      args.nranks, args.nblocks_moved);
+}
+
+int LoadBalance::EvaluatePlacement(std::vector<double> const& costlist,
+                                   std::vector<int> const& ranklist,
+                                   int nranks, PlacementEval& eval,
+                                   int nthreads) {
+  return PlacementEvaluator::Evaluate(costlist, ranklist, nranks, eval,
+                                      nthreads);
 }
 }  // namespace lb
 }  // namespace amr
\ No newline at end of file
@@ -1,51 +1,203 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
 #include <unordered_map>
 #include <vector>
 #include "tools-common/logging.h"
 
 namespace amr {
+//
+// AssignmentCacheKey: a placement is only reusable for the same policy,
+// the same number of ranks, and (approximately) the same costlist.
+// The costlist is reduced to a fingerprint over quantized costs, so
+// near-identical timesteps map to the same key.
+//
+struct AssignmentCacheKey {
+  std::string policy_id;
+  int nranks;
+  int nblocks;
+  uint64_t fingerprint;
+
+  bool operator==(const AssignmentCacheKey& other) const {
+    return policy_id == other.policy_id && nranks == other.nranks &&
+           nblocks == other.nblocks && fingerprint == other.fingerprint;
+  }
+};
+
+struct AssignmentCacheKeyHash {
+  size_t operator()(const AssignmentCacheKey& key) const {
+    size_t h = std::hash<std::string>()(key.policy_id);
+    h ^= std::hash<uint64_t>()(key.fingerprint) + 0x9e3779b97f4a7c15ull +
+         (h << 6) + (h >> 2);
+    h ^= std::hash<int>()(key.nranks) + (h << 6) + (h >> 2);
+    h ^= std::hash<int>()(key.nblocks) + (h << 6) + (h >> 2);
+    return h;
+  }
+};
+
 struct CachedAssignment {
   std::vector<int> ranklist;
+  double imbalance;  // of ranklist for the costlist it was put with
   int reuse_count;
+  uint64_t put_seq;  // insertion order, used for eviction
 };
 
 class AssignmentCache {
  public:
-  AssignmentCache(int max_reuse) : max_reuse_(max_reuse) {}
+  //
+  // max_reuse: max number of times an entry is served before expiring
+  // max_regression: max allowed relative increase in imbalance
+  //   (makespan / mean rank load) when a cached placement is applied to
+  //   the new costlist (0.02 = 2%). Like the fingerprint, this ignores
+  //   the scale of the costs
+  // quantum: costs are quantized to multiples of (quantum * mean cost)
+  //   before fingerprinting
+  // max_entries: entries beyond this evict the oldest one
+  //
+  AssignmentCache(int max_reuse, double max_regression = 0.0,
+                  double quantum = 0.0, int max_entries = 64)
+      : max_reuse_(max_reuse),
+        max_regression_(max_regression),
+        quantum_(quantum),
+        max_entries_(max_entries),
+        put_seq_(0) {}
 
-  bool Get(int nblocks, std::vector<int>& ranklist) {
-    MLOG(MLOG_DBG0, "Cache get (nblocks: %d)", nblocks);
+  bool Get(const std::string& policy_id, int nranks,
+           std::vector<double> const& costlist, std::vector<int>& ranklist) {
+    auto key = MakeKey(policy_id, nranks, costlist);
+    MLOG(MLOG_DBG2, "Cache get (policy: %s, nranks: %d, nblocks: %d)",
+         policy_id.c_str(), nranks, key.nblocks);
 
-    if (cache_.find(nblocks) == cache_.end()) {
+    auto it = cache_.find(key);
+    if (it == cache_.end()) {
       return false;
     }
 
-    auto& entry = cache_[nblocks];
+    auto& entry = it->second;
     if (entry.reuse_count >= max_reuse_) {
-      MLOG(MLOG_DBG0, "Cache entry for %d blocks expired",
-           nblocks);
-      cache_.erase(nblocks);
+      MLOG(MLOG_DBG0, "Cache entry for %d blocks expired", key.nblocks);
+      cache_.erase(it);
+      return false;
+    }
+
+    // the fingerprint is lossy, so verify the placement still holds up
+    double imbalance = ComputeImbalance(costlist, entry.ranklist, nranks);
+    double regression = entry.imbalance > 0
+                            ? (imbalance - entry.imbalance) / entry.imbalance
+                            : 0;
+    if (regression > max_regression_) {
+      MLOG(MLOG_DBG0, "Cache entry rejected (regression: %.3lf > %.3lf)",
+           regression, max_regression_);
       return false;
     }
 
     entry.reuse_count++;
     ranklist = entry.ranklist;
 
-    MLOG(MLOG_DBG0, "Cache hit (nblocks: %d, new reusecnt: %d)",
-         nblocks, entry.reuse_count);
+    MLOG(MLOG_DBG0,
+         "Cache hit (nblocks: %d, new reusecnt: %d, regression: %.3lf)",
+         key.nblocks, entry.reuse_count, regression);
 
     return true;
   }
 
-  void Put(int nblocks, std::vector<int> const& ranklist) {
-    MLOG(MLOG_DBG0, "Cache put (nblocks: %d)", nblocks);
+  void Put(const std::string& policy_id, int nranks,
+           std::vector<double> const& costlist,
+           std::vector<int> const& ranklist) {
+    if (max_reuse_ <= 0) return;
+
+    auto key = MakeKey(policy_id, nranks, costlist);
+    MLOG(MLOG_DBG2, "Cache put (policy: %s, nranks: %d, nblocks: %d)",
+         policy_id.c_str(), nranks, key.nblocks);
+
+    if (cache_.size() >= max_entries_ && cache_.find(key) == cache_.end()) {
+      EvictOldest();
+    }
 
-    cache_[nblocks] = {ranklist, 0};
+    double imbalance = ComputeImbalance(costlist, ranklist, nranks);
+    cache_[key] = {ranklist, imbalance, 0, put_seq_++};
+  }
+
+  size_t Size() const { return cache_.size(); }
+
+  //
+  // Fingerprint: FNV-1a over costs quantized relative to the mean cost.
+  // quantum = 0 hashes the exact bit patterns
+  //
+  static uint64_t Fingerprint(std::vector<double> const& costlist,
+                              double quantum) {
+    const uint64_t kFnvPrime = 0x100000001b3ull;
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    double step = 0;
+    if (quantum > 0 && !costlist.empty()) {
+      double sum = 0;
+      for (auto c : costlist) sum += c;
+      step = quantum * sum / costlist.size();
+    }
+
+    for (auto c : costlist) {
+      uint64_t q;
+      if (step > 0) {
+        q = static_cast<uint64_t>(std::llround(c / step));
+      } else {
+        static_assert(sizeof(double) == sizeof(uint64_t), "unexpected double");
+        std::memcpy(&q, &c, sizeof(q));
+      }
+
+      for (int i = 0; i < 8; i++) {
+        h ^= (q >> (i * 8)) & 0xff;
+        h *= kFnvPrime;
+      }
+    }
+
+    return h;
   }
 
  private:
-  int max_reuse_;  // max cached allocation reuse count
-  std::unordered_map<int, CachedAssignment> cache_;
+  AssignmentCacheKey MakeKey(const std::string& policy_id, int nranks,
+                             std::vector<double> const& costlist) const {
+    return {policy_id, nranks, static_cast<int>(costlist.size()),
+            Fingerprint(costlist, quantum_)};
+  }
+
+  // ComputeImbalance: makespan / mean rank load, 0 if there is no load
+  static double ComputeImbalance(std::vector<double> const& costlist,
+                                 std::vector<int> const& ranklist,
+                                 int nranks) {
+    std::vector<double> rank_costs(nranks, 0);
+    double total = 0;
+    for (size_t bidx = 0; bidx < costlist.size(); bidx++) {
+      rank_costs[ranklist[bidx]] += costlist[bidx];
+      total += costlist[bidx];
+    }
+
+    if (rank_costs.empty() or total <= 0) return 0;
+
+    double makespan = *std::max_element(rank_costs.begin(), rank_costs.end());
+    return makespan * nranks / total;
+  }
+
+  void EvictOldest() {
+    auto oldest = cache_.begin();
+    for (auto it = cache_.begin(); it != cache_.end(); it++) {
+      if (it->second.put_seq < oldest->second.put_seq) oldest = it;
+    }
+
+    if (oldest != cache_.end()) cache_.erase(oldest);
+  }
+
+  int max_reuse_;          // max cached allocation reuse count
+  double max_regression_;  // max tolerated relative imbalance regression
+  double quantum_;         // fingerprint quantization, relative to mean cost
+  size_t max_entries_;
+  uint64_t put_seq_;
+  std::unordered_map<AssignmentCacheKey, CachedAssignment,
+                     AssignmentCacheKeyHash>
+      cache_;
 };
 }  // namespace amr
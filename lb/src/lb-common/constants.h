@@ -7,8 +7,25 @@
 namespace amr {
 class Constants {
  public:
-  static constexpr int kMaxAssignmentCacheReuse = 0;
+  // Defaults for AssignmentCache, overridable via AMRLB_CONFIG
+  // (lb_cache_max_reuse, lb_cache_max_regression, lb_cache_quantum)
+  static constexpr int kMaxAssignmentCacheReuse = 8;
+  static constexpr double kAssignmentCacheMaxRegression = 0.02;
+  static constexpr double kAssignmentCacheQuantum = 0.01;
   static constexpr int kRanksPerNode = 16;
+  // Defaults for the "auto" policy (lb_auto_solve_weight,
+  // lb_auto_explore_intvl)
+  static constexpr double kAutoSolveWeight = 1000.0;
+  static constexpr int kAutoExploreIntvl = 16;
+  // Coefficient of variation assumed by robust policies when no per-block
+  // variances are given (lb_robust_cv)
+  static constexpr double kRobustCostCV = 0.1;
+  // Max makespan regression (vs. from-scratch placement) accepted to keep
+  // blocks in place on a rank count change (lb_resize_tolerance)
+  static constexpr double kResizeMakespanTolerance = 0.02;
+  // Iterative policies stop once their makespan is within this fraction of
+  // a lower bound (lb_early_exit_eps)
+  static constexpr double kLowerBoundEpsilon = 0.001;
   static constexpr int kScaleSimIters = 1;
 };
 }  // namespace amr
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "tools-common/logging.h"
+
+namespace amr {
+//
+// CostExtrapolator: maps per-block costs across one AMR step for a
+// Dim-dimensional mesh (2^Dim children per refined block).
+//
+// refs and derefs hold indices into the previous block list:
+// - a block listed k times in refs is refined k levels, into 2^(Dim * k)
+//   children, each inheriting its cost
+// - a run of 2^(Dim * k) consecutive blocks, each listed k times in derefs,
+//   is coarsened k levels into one block with their mean cost
+// k = 1 is the usual single-level step. refs and derefs need not be
+// sorted, and are not modified. Extrapolate makes a single linear merge
+// pass over the blocks, writing into a pre-sized output.
+//
+template <int Dim>
+class CostExtrapolator {
+ public:
+  static constexpr int kNumChildren = 1 << Dim;
+
+  // NumBlocksNext: block count after a single-level step, from list sizes
+  static int NumBlocksNext(int nblocks, int nrefs, int nderefs) {
+    return nblocks + nrefs * (kNumChildren - 1) -
+           nderefs / kNumChildren * (kNumChildren - 1);
+  }
+
+  // NumBlocksNext: exact block count after a step of any depth
+  static int NumBlocksNext(int nblocks, std::vector<int> const& refs,
+                           std::vector<int> const& derefs) {
+    std::vector<int> refs_sorted, derefs_sorted;
+    auto const& r = Sorted(refs, refs_sorted);
+    auto const& d = Sorted(derefs, derefs_sorted);
+
+    int nblocks_next = nblocks;
+    ForEachRun(r, [&](int, int depth) {
+      nblocks_next += NumDescendants(depth) - 1;
+      return 1;
+    });
+    ForEachRun(d, [&](int, int depth) {
+      nblocks_next -= NumDescendants(depth) - 1;
+      return NumDescendants(depth);
+    });
+
+    return nblocks_next;
+  }
+
+  static void Extrapolate(std::vector<double> const& costs_prev,
+                          std::vector<int> const& refs,
+                          std::vector<int> const& derefs,
+                          std::vector<double>& costs_cur) {
+    std::vector<int> refs_sorted, derefs_sorted;
+    auto const& r = Sorted(refs, refs_sorted);
+    auto const& d = Sorted(derefs, derefs_sorted);
+
+    int nblocks_prev = costs_prev.size();
+    costs_cur.resize(NumBlocksNext(nblocks_prev, r, d));
+    double* out = costs_cur.data();
+
+    int ref_idx = 0;
+    int deref_idx = 0;
+    int bidx = 0;
+
+    while (bidx < nblocks_prev) {
+      if (ref_idx < r.size() and r[ref_idx] == bidx) {
+        int depth = RunLength(r, ref_idx);
+        out = std::fill_n(out, NumDescendants(depth), costs_prev[bidx]);
+        ref_idx += depth;
+        bidx++;
+      } else if (deref_idx < d.size() and d[deref_idx] == bidx) {
+        int depth = RunLength(d, deref_idx);
+        int group = NumDescendants(depth);
+        if (bidx + group > nblocks_prev) {
+          ABORT("[CostExtrapolator] Deref group past the last block");
+        }
+
+        double cost_sum = 0;
+        for (int i = 0; i < group; i++) {
+          cost_sum += costs_prev[bidx + i];
+        }
+        *out++ = cost_sum / group;
+        deref_idx += group * depth;
+        bidx += group;
+      } else {
+        *out++ = costs_prev[bidx];
+        bidx++;
+      }
+    }
+
+    if (out != costs_cur.data() + costs_cur.size()) {
+      ABORT("[CostExtrapolator] Malformed refs/derefs");
+    }
+  }
+
+ private:
+  static int NumDescendants(int depth) { return 1 << (Dim * depth); }
+
+  static std::vector<int> const& Sorted(std::vector<int> const& v,
+                                        std::vector<int>& scratch) {
+    if (std::is_sorted(v.begin(), v.end())) return v;
+    scratch = v;
+    std::sort(scratch.begin(), scratch.end());
+    return scratch;
+  }
+
+  static int RunLength(std::vector<int> const& v, int idx) {
+    int end = idx;
+    while (end < v.size() and v[end] == v[idx]) end++;
+    return end - idx;
+  }
+
+  //
+  // ForEachRun: f(bidx, depth) for each group in sorted v; f returns the
+  // number of distinct blocks the group spans in v
+  //
+  template <typename F>
+  static void ForEachRun(std::vector<int> const& v, F f) {
+    int idx = 0;
+    while (idx < v.size()) {
+      int depth = RunLength(v, idx);
+      idx += f(v[idx], depth) * depth;
+    }
+  }
+};
+}  // namespace amr
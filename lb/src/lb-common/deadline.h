@@ -0,0 +1,34 @@
+#pragma once
+
+#include <time.h>
+
+namespace amr {
+//
+// Deadline: wall-clock budget for anytime placement.
+// A budget <= 0 means no deadline, and Expired() is always false.
+//
+class Deadline {
+ public:
+  explicit Deadline(double budget_ms)
+      : budget_ms_(budget_ms), ts_beg_ms_(NowMs()) {}
+
+  bool Enabled() const { return budget_ms_ > 0; }
+
+  bool Expired() const { return Enabled() and ElapsedMs() >= budget_ms_; }
+
+  double ElapsedMs() const { return NowMs() - ts_beg_ms_; }
+
+  double BudgetMs() const { return budget_ms_; }
+
+  static double NowMs() {
+    // wrapper over clock_monotonic
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+  }
+
+ private:
+  const double budget_ms_;
+  const double ts_beg_ms_;
+};
+}  // namespace amr
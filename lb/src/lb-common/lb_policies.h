@@ -6,6 +6,7 @@
 
 #include <mpi.h>
 
+#include <cstdint>
 #include <vector>
 
 #include "policy_wopts.h"
@@ -17,9 +18,26 @@ struct PolicyOptsHybridCDPFirst;
 struct PolicyOptsHybrid;
 struct PolicyOptsILP;
 struct PolicyOptsChunked;
+struct PolicyOptsNodeHier;
+struct PolicyOptsRobust;
+struct PolicyOptsBnB;
+
+namespace lb {
+struct PlacementTelemetry;
+}  // namespace lb
+
+class PolicyState;
 
 enum class LoadBalancePolicy;
 
+// BnBProgress: incumbent and lower bound of a BnB search at some point
+struct BnBProgress {
+  double elapsed_ms;
+  double makespan;     // best placement found so far
+  double lower_bound;  // makespan of no placement is below this
+  int64_t nnodes;      // search nodes visited so far
+};
+
 class LoadBalancePolicies {
  public:
   //
@@ -31,13 +49,29 @@ class LoadBalancePolicies {
   // There exists no callpath in which AssignBlocksCached ends up calling
   // itself.
   //
+  // If telemetry is set, it is reset and filled in (see amr_lb.h).
+  //
   // If a policy is configured with the parameter skip_cache,
-  // the cache will be bypassed.
+  // the cache will be bypassed. Otherwise, a cached placement is reused
+  // for the same (policy, nranks, approximate costlist) if its imbalance
+  // (makespan / mean rank load) on the new costlist regresses by at most
+  // lb_cache_max_regression.
+  //
+  // The cache (and the "auto" policy's history) live in state, or in
+  // PolicyState::Shared() if state is null. Concurrent callers are safe
+  // either way, but should pass their own state to keep their histories
+  // apart (see policy_state.h).
+  //
+  // cost_vars, if set, go to robust policies (see AssignBlocksRobust),
+  // which then bypass the cache, as it keys on costs alone.
   //
   static int AssignBlocksCached(const char* policy_name,
                                 std::vector<double> const& costlist,
                                 std::vector<int>& ranklist, int nranks,
-                                int my_rank = 0, MPI_Comm comm = MPI_COMM_NULL);
+                                int my_rank = 0, MPI_Comm comm = MPI_COMM_NULL,
+                                lb::PlacementTelemetry* telemetry = nullptr,
+                                PolicyState* state = nullptr,
+                                std::vector<double> const* cost_vars = nullptr);
 
   static int AssignBlocks(const LBPolicyWithOpts& policy,
                           std::vector<double> const& costlist,
@@ -58,6 +92,54 @@ class LoadBalancePolicies {
                                   std::vector<int>& ranklist, int nranks,
                                   MPI_Comm comm);
 
+  //
+  // AssignBlocksRobust: placement for uncertain costs. cost_means and
+  // cost_vars are per-block estimates (e.g. from recent history). Runs
+  // opts.base_policy on the means, then moves blocks off the rank with the
+  // highest opts.quantile load (assuming independent normal block costs)
+  // while that lowers the highest per-rank quantile. Contiguous base
+  // placements stay contiguous.
+  //
+  static int AssignBlocksRobust(std::vector<double> const& cost_means,
+                                std::vector<double> const& cost_vars,
+                                std::vector<int>& ranklist, int nranks,
+                                PolicyOptsRobust const& opts);
+
+  //
+  // AssignBlocksResize: re-place blocks after the rank count changes,
+  // moving as few blocks as possible. ranklist_old is over
+  // rank_map.size() old ranks, and rank_map[r] is the new id of old rank r
+  // (-1 if it is gone); rank_map must not map two old ranks to the same
+  // new one. The policy is run over nranks from scratch, and its makespan,
+  // plus lb_resize_tolerance, bounds the result. A contiguous result has
+  // its range boundaries shifted, in rank order, to keep the most blocks in
+  // place (it is kept as is if that DP is too large). Otherwise the old
+  // placement is repaired (orphaned blocks placed, then rebalanced) if that
+  // gets within the bound, or else the result has its ranks relabeled to
+  // maximize blocks kept in place.
+  // nblocks_moved is set to the number of blocks that change ranks
+  //
+  static int AssignBlocksResize(const LBPolicyWithOpts& policy,
+                                std::vector<double> const& costlist,
+                                std::vector<int> const& ranklist_old,
+                                std::vector<int> const& rank_map,
+                                std::vector<int>& ranklist, int nranks,
+                                int& nblocks_moved);
+
+  //
+  // AssignBlocksBnB: exact placement by branch-and-bound, for reference
+  // runs (up to a few hundred blocks and tens of ranks). Starts from the
+  // better of LPT and Karmarkar-Karp, and searches until the placement is
+  // within opts.rel_gap of the lower bound, or opts.time_limit_ms runs out.
+  // If progress is set, it gets a (makespan, lower bound) entry at the
+  // start, on every improvement, and at the end; the gap of the last entry
+  // is 0 iff the placement was proven optimal
+  //
+  static int AssignBlocksBnB(std::vector<double> const& costlist,
+                             std::vector<int>& ranklist, int nranks,
+                             PolicyOptsBnB const& opts,
+                             std::vector<BnBProgress>* progress = nullptr);
+
  private:
   static int AssignBlocksRoundRobin(std::vector<double> const& costlist,
                                     std::vector<int>& ranklist, int nranks);
@@ -78,6 +160,13 @@ class LoadBalancePolicies {
                              std::vector<int>& ranklist, int nranks,
                              PolicyOptsILP const& opts);
 
+  //
+  // AssignBlocksContigImproved (CDP): contiguous runs of floor or ceil of
+  // nblocks/nranks blocks, placed by a DP. A greedy pass is tried first and
+  // kept if its makespan is within LowerBound::ContiguousFixedSize * (1 + eps),
+  // eps being LowerBound::Epsilon(); the placement can then differ from the
+  // DP's, but never by more than that factor in makespan
+  //
   static int AssignBlocksContigImproved(std::vector<double> const& costlist,
                                         std::vector<int>& ranklist, int nranks);
 
@@ -108,6 +197,32 @@ class LoadBalancePolicies {
                                             MPI_Comm comm, int mympirank,
                                             int nmpiranks);
 
+  //
+  // AssignBlocksNodeHierarchical: two-level placement. Blocks are first
+  // split into contiguous per-node ranges (weighted by ranks per node), and
+  // each range is then placed within its node using opts.intra_policy.
+  // node_map[r] is the node id of rank r (see PolicyUtils::GetNodeMap)
+  //
+  static int AssignBlocksNodeHierarchical(std::vector<double> const& costlist,
+                                          std::vector<int>& ranklist,
+                                          int nranks,
+                                          PolicyOptsNodeHier const& opts,
+                                          std::vector<int> const& node_map);
+
+  //
+  // AssignBlocksAuto: picks one of the PolicyAutotuner candidates per call,
+  // based on running makespan and solve time statistics. comm may be
+  // MPI_COMM_NULL, otherwise the candidate runs via AssignBlocksParallel
+  //
+  static int AssignBlocksAuto(std::vector<double> const& costlist,
+                              std::vector<int>& ranklist, int nranks,
+                              MPI_Comm comm);
+
+  // AssignBlocksRobust with variances from Constants::kRobustCostCV
+  static int AssignBlocksRobust(std::vector<double> const& costlist,
+                                std::vector<int>& ranklist, int nranks,
+                                PolicyOptsRobust const& opts);
+
   static int AssignBlocksParallelHybridCDPFirst(
       std::vector<double> const& costlist, std::vector<int>& ranklist,
       int nranks, PolicyOptsHybridCDPFirst const& opts, MPI_Comm comm,
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <numeric>
+#include <vector>
+
+#include "lb-common/constants.h"
+#include "tools-common/config_parser.h"
+
+namespace amr {
+//
+// LowerBound: makespan lower bounds, so that iterative policies can stop
+// once they are provably within Epsilon() of optimal.
+// - Simple: max(average rank load, largest block); valid for any placement
+// - Any: Simple, plus: for each k, some rank gets k + 1 of the
+//   k * nranks + 1 largest blocks, so it carries at least the k + 1
+//   smallest of them. O(nblocks log nblocks)
+// - ContiguousFixedSize: for placements where every rank owns a run of
+//   floor or ceil(nblocks / nranks) blocks (the CDP search space). The
+//   run holding block i carries at least the cheapest window of
+//   floor(nblocks / nranks) blocks that covers i
+//
+class LowerBound {
+ public:
+  static double Simple(std::vector<double> const& costlist, int nranks) {
+    if (costlist.empty() or nranks <= 0) return 0;
+
+    double sum = std::accumulate(costlist.begin(), costlist.end(), 0.0);
+    double max = *std::max_element(costlist.begin(), costlist.end());
+    return std::max(sum / nranks, max);
+  }
+
+  static double Any(std::vector<double> const& costlist, int nranks) {
+    double lb = Simple(costlist, nranks);
+    int nblocks = costlist.size();
+    if (nblocks <= nranks) return lb;
+
+    std::vector<double> costs_desc(costlist);
+    std::sort(costs_desc.begin(), costs_desc.end(), std::greater<double>());
+
+    for (int k = 1; k * nranks < nblocks; k++) {
+      double lb_k = 0;
+      for (int i = k * nranks - k; i <= k * nranks; i++) {
+        lb_k += costs_desc[i];
+      }
+      lb = std::max(lb, lb_k);
+    }
+
+    return lb;
+  }
+
+  static double ContiguousFixedSize(std::vector<double> const& costlist,
+                                    int nranks) {
+    double lb = Simple(costlist, nranks);
+    int nblocks = costlist.size();
+    int k = nranks > 0 ? nblocks / nranks : 0;
+    if (k <= 1) return lb;
+
+    // win[j]: sum of blocks [j, j + k)
+    int nwin = nblocks - k + 1;
+    std::vector<double> win(nwin);
+    win[0] = std::accumulate(costlist.begin(), costlist.begin() + k, 0.0);
+    for (int j = 1; j < nwin; j++) {
+      win[j] = win[j - 1] + costlist[j + k - 1] - costlist[j - 1];
+    }
+
+    // windows covering block i: [max(0, i - k + 1), min(i, nwin - 1)].
+    // Sliding-window minimum over win, via a monotonic deque
+    std::deque<int> dq;
+    int j_next = 0;
+    for (int i = 0; i < nblocks; i++) {
+      int j_end = std::min(i, nwin - 1);
+      for (; j_next <= j_end; j_next++) {
+        while (not dq.empty() and win[dq.back()] >= win[j_next]) {
+          dq.pop_back();
+        }
+        dq.push_back(j_next);
+      }
+      while (dq.front() < i - k + 1) dq.pop_front();
+      lb = std::max(lb, win[dq.front()]);
+    }
+
+    return lb;
+  }
+
+  // Within: cost is within a fraction eps of lb
+  static bool Within(double cost, double lb, double eps) {
+    return cost <= lb * (1 + eps);
+  }
+
+  static double Epsilon() {
+    return ConfigUtils::GetParamOrDefault<double>(
+        "lb_early_exit_eps", Constants::kLowerBoundEpsilon);
+  }
+};
+}  // namespace amr
@@ -25,7 +25,11 @@ enum class LoadBalancePolicy {
   kPolicyHybrid,
   kPolicyHybridCppFirst,
   kPolicyHybridCppFirstV2,
-  kPolicyCDPChunked
+  kPolicyCDPChunked,
+  kPolicyNodeHierarchical,
+  kPolicyAuto,
+  kPolicyRobust,
+  kPolicyBnB
 };
 
 /** Policy kUnitCost is not really necessary
@@ -38,13 +42,15 @@ enum class CostEstimationPolicy {
   kExtrapolatedCost,
   kOracleCost,
   kCachedExtrapolatedCost,
+  kPredictedCost,
 };
 
 enum class TriggerPolicy {
   kUnspecified,
   kEveryTimestep,
   kEveryNTimesteps,
-  kOnMeshChange
+  kOnMeshChange,
+  kCostBenefit  // on mesh change, or when lb::LBTrigger predicts a gain
 };
 
 struct LBPolicyWithOpts;
@@ -64,6 +70,11 @@ struct PolicyExecOpts {
 
   int cache_ttl;
   int trigger_interval;
+  double cost_ewma_alpha;  // smoothing for per-block cost mean/variance
+  double cost_trend_beta;  // trend smoothing for kPredictedCost
+  int mesh_ndims;          // mesh dimensionality, for cost extrapolation
+  double migration_cost;   // per-block migration cost, for kCostBenefit
+  int trigger_horizon;     // expected placement lifetime, for kCostBenefit
 
  public:
   PolicyExecOpts()
@@ -76,7 +87,12 @@ struct PolicyExecOpts {
       , nranks(0)
       , nblocks_init(0)
       , cache_ttl(15)
-      , trigger_interval(100) {}
+      , trigger_interval(100)
+      , cost_ewma_alpha(0.3)
+      , cost_trend_beta(0.1)
+      , mesh_ndims(2)
+      , migration_cost(0)
+      , trigger_horizon(10) {}
 
   void SetPolicy(const char* name, const char* id, CostEstimationPolicy cep,
                  TriggerPolicy tp) {
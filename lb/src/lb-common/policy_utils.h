@@ -22,15 +22,37 @@ class PolicyUtils {
 
   static std::string PolicyToString(TriggerPolicy policy);
 
+  //
+  // ExtrapolateCosts: costs after one AMR step of an ndims-D mesh, see
+  // CostExtrapolator for the refs/derefs format (multi-level steps are
+  // supported). O(N) for sorted refs/derefs
+  //
+  static void ExtrapolateCosts(int ndims, std::vector<double> const& costs_prev,
+                               std::vector<int> const& refs,
+                               std::vector<int> const& derefs,
+                               std::vector<double>& costs_cur);
+
   static void ExtrapolateCosts2D(std::vector<double> const& costs_prev,
-                                 std::vector<int>& refs,
-                                 std::vector<int>& derefs,
-                                 std::vector<double>& costs_cur);
+                                 std::vector<int> const& refs,
+                                 std::vector<int> const& derefs,
+                                 std::vector<double>& costs_cur) {
+    ExtrapolateCosts(2, costs_prev, refs, derefs, costs_cur);
+  }
 
   static void ExtrapolateCosts3D(std::vector<double> const& costs_prev,
-                                 std::vector<int>& refs,
-                                 std::vector<int>& derefs,
-                                 std::vector<double>& costs_cur);
+                                 std::vector<int> const& refs,
+                                 std::vector<int> const& derefs,
+                                 std::vector<double>& costs_cur) {
+    ExtrapolateCosts(3, costs_prev, refs, derefs, costs_cur);
+  }
+
+  // GetNumBlocksNext: exact block count after a step of any depth
+  static int GetNumBlocksNext(int ndims, int nblocks,
+                              std::vector<int> const& refs,
+                              std::vector<int> const& derefs);
+
+  // GetNumBlocksNext: block count after a single-level step
+  static int GetNumBlocksNext(int ndims, int nblocks, int nrefs, int nderefs);
 
   static void ComputePolicyCosts(int nranks,
                                  std::vector<double> const& cost_list,
@@ -40,6 +62,26 @@ class PolicyUtils {
 
   static double ComputeLocCost(std::vector<int> const& rank_list);
 
+  // ComputeLocCost with an explicit rank->node mapping. Off-node pairs
+  // always cost 3, including rank neighbors (see policy_utils.cc)
+  static double ComputeLocCost(std::vector<int> const& rank_list,
+                               std::vector<int> const& node_map);
+
+  //
+  // GetNodeMap: rank->node mapping assuming Constants::kRanksPerNode
+  // ranks packed sequentially onto each node
+  //
+  static void GetNodeMap(int nranks, std::vector<int>& node_map);
+
+  //
+  // ComputeNodeMap: actual rank->node mapping for comm, obtained via
+  // MPI_Comm_split_type(MPI_COMM_TYPE_SHARED). Collective over comm, so
+  // placement caches the result in PolicyState.
+  // Node ids are dense and ordered by the lowest rank on each node.
+  // Returns 0 on success
+  //
+  static int ComputeNodeMap(MPI_Comm comm, std::vector<int>& node_map);
+
   static std::string GetSafePolicyName(const char* policy_name) {
     std::string result = policy_name;
 
@@ -67,6 +109,8 @@ class PolicyUtils {
 
   static const LBPolicyWithOpts GenCDPC(const std::string& policy_str);
 
+  static const LBPolicyWithOpts GenCDPI(const std::string& policy_str);
+
   static const std::map<std::string, LBPolicyWithOpts> kPolicyMap;
 
   friend class MiscTest;
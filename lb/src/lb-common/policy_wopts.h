@@ -8,13 +8,15 @@
 namespace amr {
 struct PolicyOptsCDPI {
   double niter_frac;
-  int niters;
+  int niters;          // 0 with a deadline: iterate until the deadline
+  double deadline_ms;  // wall-clock budget for iterations, 0 = none
 };
 
 struct PolicyOptsHybridCDPFirst {
   bool v2;             // whether to use v2 or not, always yes
   double lpt_frac;     // frac of ranks to run LPT on
   int alt_solncnt_max; // max no. of alt solns to explore
+  double deadline_ms;  // wall-clock budget for alt solns, 0 = none
 };
 
 // PolicyOptsILP: options for Gurobi-based solver
@@ -69,6 +71,42 @@ struct PolicyOptsChunked {
   }
 };
 
+// PolicyOptsNodeHier: two-level placement, nodes first and ranks second
+struct PolicyOptsNodeHier {
+  LoadBalancePolicy intra_policy; // policy used within a node (cdp or lpt)
+
+  std::string ToString() const {
+    return std::string("\n\tintra_policy: \t") +
+           std::to_string(static_cast<int>(intra_policy));
+  }
+};
+
+// PolicyOptsRobust: placement on uncertain (mean, variance) block costs
+struct PolicyOptsRobust {
+  LoadBalancePolicy base_policy; // initial placement on means (cdp or lpt)
+  double quantile;               // per-rank load quantile to minimize
+  int max_iters;                 // max block moves after the base policy
+
+  std::string ToString() const {
+    return std::string("\n\tbase_policy: \t") +
+           std::to_string(static_cast<int>(base_policy)) +
+           std::string("\n\tquantile: \t") + std::to_string(quantile) +
+           std::string("\n\tmax_iters: \t") + std::to_string(max_iters);
+  }
+};
+
+// PolicyOptsBnB: options for the built-in branch-and-bound solver
+struct PolicyOptsBnB {
+  double time_limit_ms; // wall-clock budget, best placement returned after
+  double rel_gap;       // stop once within this fraction of the lower bound
+
+  std::string ToString() const {
+    return std::string("\n\ttime_limit_ms: \t") +
+           std::to_string(time_limit_ms) + std::string("\n\trel_gap: \t") +
+           std::to_string(rel_gap);
+  }
+};
+
 struct LBPolicyWithOpts {
   std::string id;
   std::string name;
@@ -83,6 +121,9 @@ struct LBPolicyWithOpts {
     PolicyOptsILP ilp_opts;
     PolicyOptsHybrid hybrid_opts;
     PolicyOptsChunked chunked_opts;
+    PolicyOptsNodeHier node_opts;
+    PolicyOptsRobust robust_opts;
+    PolicyOptsBnB bnb_opts;
   };
 };
 } // namespace amr
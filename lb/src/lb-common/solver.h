@@ -6,14 +6,33 @@
 
 #include "tools-common/logging.h"
 #include "iter.h"
+#include "lb-common/deadline.h"
+#include "lb-common/lower_bound.h"
 #include "lb-common/rank.h"
+#include "lb-common/telemetry.h"
 
 #include <algorithm>
 #include <cassert>
+#include <tuple>
 
 namespace amr {
+// SolverStats: what an anytime solve achieved
+struct SolverStats {
+  int niters;           // iterations executed
+  double cost_initial;  // max rank cost of the input placement
+  double cost_final;    // max rank cost of the returned placement
+  double elapsed_ms;
+  bool deadline_hit;    // stopped because the budget ran out
+  bool bound_hit;       // stopped within LowerBound::Epsilon() of optimal
+};
+
 class Solver {
  public:
+  //
+  // AssignBlocks: improve ranklist for up to niters iterations, stopping
+  // early on convergence or at the lower bound. Returns the number of
+  // iterations run
+  //
   int AssignBlocks(std::vector<double> const& costlist,
                    std::vector<int>& ranklist, int nranks, int niters) {
     nranks_ = nranks;
@@ -24,8 +43,19 @@ class Solver {
     LogRankStats("INITIAL", avg_cost, max_cost);
     iter_.LogCost(max_cost);
 
+    const double lb = LowerBound::Any(costlist, nranks);
+    const double eps = LowerBound::Epsilon();
+
+    int niters_run = 0;
     for (int iter = 0; iter < niters; iter++) {
+      if (LowerBound::Within(max_cost, lb, eps)) {
+        MLOG(MLOG_DBG0, "[Solver] Within %.2lf%% of lower bound, stopping",
+             eps * 100);
+        break;
+      }
+
       Iterate();
+      niters_run++;
       GetRankStats(ranks_, avg_cost, max_cost);
       LogRankStats(iter, avg_cost, max_cost);
 
@@ -35,10 +65,11 @@ class Solver {
       }
     }
 
+    Telemetry::AddIters(niters_run);
     LogRankStats("FINAL", avg_cost, max_cost);
 
     UpdateRanklist(ranklist);
-    return 0;
+    return niters_run;
   }
 
   int AssignBlocks(std::vector<double> const& costlist,
@@ -72,6 +103,74 @@ class Solver {
     return 0;
   }
 
+  //
+  // AssignBlocksAnytime: improve ranklist until max_iters, convergence,
+  // or the deadline, whichever comes first. max_iters <= 0 means no
+  // iteration limit. Iterations may transiently worsen the max cost, so
+  // moves since the best placement are undone before returning: ranklist
+  // always comes back as the best placement seen.
+  //
+  int AssignBlocksAnytime(std::vector<double> const& costlist,
+                          std::vector<int>& ranklist, int nranks,
+                          int max_iters, Deadline const& deadline,
+                          SolverStats& stats) {
+    nranks_ = nranks;
+    double avg_cost, max_cost;
+
+    InitializeRanks(nranks, costlist, ranklist);
+    GetRankStats(ranks_, avg_cost, max_cost);
+    LogRankStats("INITIAL", avg_cost, max_cost);
+    iter_.Clear();
+    iter_.LogCost(max_cost);
+
+    ScopedPhase phase("iterate");
+    stats = {0, max_cost, max_cost, 0, false, false};
+    double best_cost = max_cost;
+    moves_.clear();
+    track_moves_ = true;
+
+    const double lb = LowerBound::Any(costlist, nranks);
+    const double eps = LowerBound::Epsilon();
+
+    while (max_iters <= 0 or stats.niters < max_iters) {
+      if (deadline.Expired()) {
+        stats.deadline_hit = true;
+        break;
+      }
+
+      if (LowerBound::Within(best_cost, lb, eps)) {
+        stats.bound_hit = true;
+        break;
+      }
+
+      Iterate();
+      GetRankStats(ranks_, avg_cost, max_cost);
+      LogRankStats(stats.niters, avg_cost, max_cost);
+      stats.niters++;
+
+      if (max_cost < best_cost) {
+        best_cost = max_cost;
+        moves_.clear();
+      }
+
+      if (iter_.ShouldStop(max_cost)) {
+        MLOG(MLOG_DBG0, "[Solver] IterationTracker says we should stop!!");
+        break;
+      }
+    }
+
+    track_moves_ = false;
+    UndoMoves();
+
+    stats.cost_final = best_cost;
+    stats.elapsed_ms = deadline.ElapsedMs();
+    Telemetry::AddIters(stats.niters);
+    LogRankStats("FINAL", avg_cost, best_cost);
+
+    UpdateRanklist(ranklist);
+    return 0;
+  }
+
   static void AnalyzePlacement(std::vector<double> const& costlist,
                                std::vector<int>& ranklist, int nranks,
                                double& avg_cost, double& max_cost) {
@@ -85,6 +184,9 @@ class Solver {
   std::vector<Rank> ranks_;
   std::vector<std::pair<double, int>> rank_cost_vec_;
   IterationTracker iter_;
+  // (bidx, src, dest) transfers since the best placement, for anytime mode
+  std::vector<std::tuple<int, int, int>> moves_;
+  bool track_moves_ = false;
 
   void InitializeRanks(int nranks, std::vector<double> const& costlist,
                        std::vector<int> const& ranklist) {
@@ -217,6 +319,21 @@ class Solver {
 
     rank_cost_vec_[src_ridx].first -= cost;
     rank_cost_vec_[dest_ridx].first += cost;
+
+    if (track_moves_) {
+      moves_.emplace_back(bidx, src_rank, dest_rank);
+    }
+  }
+
+  // revert logged transfers, newest first. rank_cost_vec_ is stale after
+  void UndoMoves() {
+    for (auto it = moves_.rbegin(); it != moves_.rend(); it++) {
+      int bidx = std::get<0>(*it);
+      double cost = ranks_[std::get<2>(*it)].RemoveBlock(bidx);
+      ranks_[std::get<1>(*it)].AddBlock(bidx, cost);
+    }
+
+    moves_.clear();
   }
 
   static void LogRankStats(int iter, double& avg_cost, double& max_cost) {
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+#include "amr_lb.h"
+#include "lb-common/deadline.h"
+#include "placement_eval.h"
+
+namespace amr {
+//
+// Telemetry: per-thread sink for lb::PlacementTelemetry.
+// Top-level entry points install the caller's struct via ScopedSink,
+// and policies report phases, iterations and working-set sizes into
+// whatever sink is current. With no sink installed, all calls are no-ops,
+// and ScopedPhase does not read the clock.
+//
+class Telemetry {
+ public:
+  class ScopedSink {
+   public:
+    explicit ScopedSink(lb::PlacementTelemetry* sink) : prev_(Current()) {
+      Current() = sink;
+    }
+
+    ~ScopedSink() { Current() = prev_; }
+
+   private:
+    lb::PlacementTelemetry* const prev_;
+  };
+
+  static lb::PlacementTelemetry*& Current() {
+    static thread_local lb::PlacementTelemetry* sink = nullptr;
+    return sink;
+  }
+
+  static bool Enabled() { return Current() != nullptr; }
+
+  static void AddPhase(const char* phase, double ms) {
+    auto* t = Current();
+    if (t) t->phase_ms[phase] += ms;
+  }
+
+  static void AddIters(int niters) {
+    auto* t = Current();
+    if (t) t->niters += niters;
+  }
+
+  // Record the size of a policy's working set; the max is retained
+  static void NoteWorkingSet(size_t bytes) {
+    auto* t = Current();
+    if (t) t->mem_hwm_bytes = std::max(t->mem_hwm_bytes, bytes);
+  }
+
+  // Begin/Finish: reset t at the start of a top-level call, and fill in
+  // the total time and quality of the final placement at the end
+  static void Begin(lb::PlacementTelemetry* t, std::string const& policy) {
+    if (t == nullptr) return;
+    *t = lb::PlacementTelemetry();
+    t->policy = policy;
+  }
+
+  static void Finish(lb::PlacementTelemetry* t,
+                     std::vector<double> const& costlist,
+                     std::vector<int> const& ranklist, int nranks,
+                     double ts_beg_ms) {
+    if (t == nullptr) return;
+    t->total_ms = Deadline::NowMs() - ts_beg_ms;
+    PlacementEvaluator::Evaluate(costlist, ranklist, nranks, t->eval);
+  }
+};
+
+//
+// ScopedPhase: adds the lifetime of the object to phase_ms[phase]
+//
+class ScopedPhase {
+ public:
+  explicit ScopedPhase(const char* phase)
+      : phase_(phase), ts_beg_(Telemetry::Enabled() ? Deadline::NowMs() : 0) {}
+
+  ~ScopedPhase() {
+    if (Telemetry::Enabled()) {
+      Telemetry::AddPhase(phase_, Deadline::NowMs() - ts_beg_);
+    }
+  }
+
+ private:
+  const char* const phase_;
+  const double ts_beg_;
+};
+}  // namespace amr
@@ -0,0 +1,244 @@
+#include "lb_autotune.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "lb-common/constants.h"
+#include "lb-common/deadline.h"
+#include "lb-common/lb_policies.h"
+#include "lb-common/policy_utils.h"
+#include "lb-common/policy_wopts.h"
+#include "lb-common/telemetry.h"
+#include "policy_state.h"
+#include "tools-common/config_parser.h"
+#include "tools-common/logging.h"
+
+namespace amr {
+std::string AutotuneFeatures::ToString() const {
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "nblocks: %d, nranks: %d, cost_avg: %.2lf, cost_cv: %.3lf, "
+           "bucket: (%d, %d)",
+           nblocks, nranks, cost_avg, cost_cv, bpr_bucket, skew_bucket);
+  return buf;
+}
+
+PolicyAutotuner::PolicyAutotuner(std::vector<std::string> const& candidates,
+                                 double solve_weight, double budget_ms,
+                                 int explore_intvl, double ewma_alpha)
+    : candidates_(candidates),
+      solve_weight_(solve_weight),
+      budget_ms_(budget_ms),
+      explore_intvl_(explore_intvl),
+      alpha_(ewma_alpha),
+      ncalls_(0) {
+  if (candidates_.empty()) {
+    ABORT("[Auto] No candidate policies");
+  }
+}
+
+AutotuneFeatures PolicyAutotuner::ComputeFeatures(
+    std::vector<double> const& costlist, int nranks) {
+  AutotuneFeatures f;
+  f.nblocks = costlist.size();
+  f.nranks = nranks;
+
+  double sum = 0, sumsq = 0;
+  for (auto c : costlist) {
+    sum += c;
+    sumsq += c * c;
+  }
+
+  int n = std::max(f.nblocks, 1);
+  f.cost_avg = sum / n;
+  double var = std::max(sumsq / n - f.cost_avg * f.cost_avg, 0.0);
+  f.cost_cv = f.cost_avg > 0 ? std::sqrt(var) / f.cost_avg : 0;
+
+  double bpr = std::max(f.nblocks * 1.0 / std::max(nranks, 1), 1.0);
+  f.bpr_bucket = std::min(static_cast<int>(std::log2(bpr)), 7);
+
+  if (f.cost_cv < 0.1) {
+    f.skew_bucket = 0;
+  } else if (f.cost_cv < 0.25) {
+    f.skew_bucket = 1;
+  } else if (f.cost_cv < 0.5) {
+    f.skew_bucket = 2;
+  } else {
+    f.skew_bucket = 3;
+  }
+
+  return f;
+}
+
+std::vector<PolicyAutotuner::Stats>& PolicyAutotuner::BucketStats(
+    AutotuneFeatures const& features) {
+  auto& bstats = stats_[features.Key()];
+  bstats.resize(candidates_.size());
+  return bstats;
+}
+
+bool PolicyAutotuner::IsEligible(AutotuneFeatures const& features,
+                                 int cidx) const {
+  auto const& name = candidates_[cidx];
+  if (name.substr(0, 4) != "cdpc") return true;
+
+  auto policy = PolicyUtils::GetPolicy(name.c_str());
+  int chunk_size = policy.chunked_opts.chunk_size;
+  return features.nranks > chunk_size and features.nranks % chunk_size == 0;
+}
+
+double PolicyAutotuner::ExpectedCost(AutotuneFeatures const& features,
+                                     Stats const& stats) const {
+  double rank_time_avg = features.cost_avg * features.nblocks / features.nranks;
+  return stats.makespan_ratio * rank_time_avg + solve_weight_ * stats.solve_ms;
+}
+
+int PolicyAutotuner::Choose(AutotuneFeatures const& features) {
+  ncalls_++;
+  auto& bstats = BucketStats(features);
+  int nc = candidates_.size();
+
+  int chosen = -1;
+  const char* reason = "";
+
+  // 1. try every eligible candidate once per bucket
+  for (int cidx = 0; cidx < nc; cidx++) {
+    if (IsEligible(features, cidx) and bstats[cidx].ntrials == 0) {
+      chosen = cidx;
+      reason = "untried";
+      break;
+    }
+  }
+
+  auto within_budget = [&](int cidx) {
+    return IsEligible(features, cidx) and
+           (budget_ms_ <= 0 or bstats[cidx].solve_ms <= budget_ms_);
+  };
+
+  // 2. periodically revisit the stalest candidate, stats drift over time
+  if (chosen == -1 and explore_intvl_ > 0 and ncalls_ % explore_intvl_ == 0) {
+    for (int cidx = 0; cidx < nc; cidx++) {
+      if (not within_budget(cidx)) continue;
+      if (chosen == -1 or bstats[cidx].last_trial < bstats[chosen].last_trial) {
+        chosen = cidx;
+      }
+    }
+    reason = "explore";
+  }
+
+  // 3. lowest expected makespan + solve cost
+  if (chosen == -1) {
+    double best_cost = 0;
+    for (int cidx = 0; cidx < nc; cidx++) {
+      if (not within_budget(cidx)) continue;
+      double cost = ExpectedCost(features, bstats[cidx]);
+      if (chosen == -1 or cost < best_cost) {
+        chosen = cidx;
+        best_cost = cost;
+      }
+    }
+    reason = "exploit";
+  }
+
+  // 4. nothing fits the budget, fall back to the fastest one
+  if (chosen == -1) {
+    for (int cidx = 0; cidx < nc; cidx++) {
+      if (not IsEligible(features, cidx)) continue;
+      if (chosen == -1 or bstats[cidx].solve_ms < bstats[chosen].solve_ms) {
+        chosen = cidx;
+      }
+    }
+    reason = "over-budget";
+  }
+
+  if (chosen == -1) {
+    ABORT("[Auto] No eligible candidate policy");
+  }
+
+  MLOG(MLOG_DBG0,
+       "[Auto] Call %d (%s): chose %s (%s, expected cost: %.0lf, "
+       "trials: %d)",
+       ncalls_, features.ToString().c_str(), candidates_[chosen].c_str(),
+       reason, ExpectedCost(features, bstats[chosen]), bstats[chosen].ntrials);
+
+  return chosen;
+}
+
+void PolicyAutotuner::Update(AutotuneFeatures const& features, int cidx,
+                             double makespan, double rank_time_avg,
+                             double solve_ms) {
+  auto& stats = BucketStats(features)[cidx];
+  double ratio = rank_time_avg > 0 ? makespan / rank_time_avg : 1.0;
+
+  if (stats.ntrials == 0) {
+    stats.makespan_ratio = ratio;
+    stats.solve_ms = solve_ms;
+  } else {
+    stats.makespan_ratio = (1 - alpha_) * stats.makespan_ratio + alpha_ * ratio;
+    stats.solve_ms = (1 - alpha_) * stats.solve_ms + alpha_ * solve_ms;
+  }
+
+  stats.ntrials++;
+  stats.last_trial = ncalls_;
+
+  MLOG(MLOG_DBG0,
+       "[Auto] Call %d: %s achieved makespan ratio %.3lf in %.2lf ms "
+       "(ewma: %.3lf, %.2lf ms)",
+       ncalls_, candidates_[cidx].c_str(), ratio, solve_ms,
+       stats.makespan_ratio, stats.solve_ms);
+}
+
+int LoadBalancePolicies::AssignBlocksAuto(std::vector<double> const& costlist,
+                                          std::vector<int>& ranklist,
+                                          int nranks, MPI_Comm comm) {
+  PolicyState& state = PolicyState::CurrentOrShared();
+
+  auto features = PolicyAutotuner::ComputeFeatures(costlist, nranks);
+  int cidx;
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    cidx = state.tuner.Choose(features);
+  }
+
+  int rank = 0;
+  if (comm != MPI_COMM_NULL) {
+    // solve times differ across ranks, so rank 0's choice is authoritative
+    MPI_Bcast(&cidx, 1, MPI_INT, 0, comm);
+    MPI_Comm_rank(comm, &rank);
+  }
+
+  auto policy =
+      PolicyUtils::GetPolicy(state.tuner.GetCandidate(cidx).c_str());
+  if (rank == 0) {
+    MLOG(MLOG_INFO, "[Auto] %s: chose %s", features.ToString().c_str(),
+         policy.id.c_str());
+  }
+  if (Telemetry::Enabled()) {
+    Telemetry::Current()->policy = "auto/" + policy.id;
+  }
+
+  double ts_beg = Deadline::NowMs();
+  int rv;
+  if (comm == MPI_COMM_NULL) {
+    rv = AssignBlocks(policy, costlist, ranklist, nranks);
+  } else {
+    rv = AssignBlocksParallel(policy, costlist, ranklist, nranks, comm);
+  }
+  double solve_ms = Deadline::NowMs() - ts_beg;
+
+  if (rv) {
+    MLOG(MLOG_WARN, "[Auto] Policy %s failed", policy.id.c_str());
+    return rv;
+  }
+
+  std::vector<double> rank_times;
+  double rank_time_avg, rank_time_max;
+  PolicyUtils::ComputePolicyCosts(nranks, costlist, ranklist, rank_times,
+                                  rank_time_avg, rank_time_max);
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.tuner.Update(features, cidx, rank_time_max, rank_time_avg, solve_ms);
+
+  return 0;
+}
+}  // namespace amr
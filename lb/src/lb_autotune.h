@@ -0,0 +1,94 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace amr {
+//
+// AutotuneFeatures: cheap features of a placement problem, bucketed so
+// that statistics learned on one timestep transfer to similar ones
+//
+struct AutotuneFeatures {
+  int nblocks;
+  int nranks;
+  double cost_avg;  // mean block cost
+  double cost_cv;   // coefficient of variation of block costs
+  int bpr_bucket;   // log2(nblocks / nranks), clamped
+  int skew_bucket;  // bucketed cost_cv
+
+  std::pair<int, int> Key() const { return {bpr_bucket, skew_bucket}; }
+
+  std::string ToString() const;
+};
+
+//
+// PolicyAutotuner: picks a placement policy per call ("auto" policy).
+// For every (feature bucket, candidate) it keeps an EWMA of the achieved
+// makespan (normalized by the average rank load) and of the solve time.
+// Every candidate is tried once per bucket, after which the one with the
+// lowest expected (makespan + weighted solve time) is picked, with
+// periodic re-exploration of the least recently tried candidate.
+//
+class PolicyAutotuner {
+ public:
+  struct Stats {
+    double makespan_ratio = 0;  // EWMA of makespan / avg rank load
+    double solve_ms = 0;        // EWMA of policy runtime
+    int ntrials = 0;
+    int last_trial = -1;  // call index of the last trial
+  };
+
+  //
+  // solve_weight: cost units per ms of solve time (costs are in us
+  // in our traces, so 1000 counts solve time 1:1)
+  // budget_ms: candidates with an expected solve time above this are
+  // skipped once tried (0 = no budget)
+  // explore_intvl: every explore_intvl-th call re-explores (0 = never)
+  //
+  PolicyAutotuner(std::vector<std::string> const& candidates,
+                  double solve_weight, double budget_ms, int explore_intvl,
+                  double ewma_alpha = 0.3);
+
+  static AutotuneFeatures ComputeFeatures(std::vector<double> const& costlist,
+                                          int nranks);
+
+  // Candidate index to use for this problem. Logs the decision
+  int Choose(AutotuneFeatures const& features);
+
+  // Record the outcome of running candidate cidx on features
+  void Update(AutotuneFeatures const& features, int cidx, double makespan,
+              double rank_time_avg, double solve_ms);
+
+  std::string const& GetCandidate(int cidx) const { return candidates_[cidx]; }
+
+  int NumCandidates() const { return candidates_.size(); }
+
+  Stats const& GetStats(AutotuneFeatures const& features, int cidx) {
+    return BucketStats(features)[cidx];
+  }
+
+  static std::vector<std::string> DefaultCandidates() {
+    return {"baseline", "lpt", "cdp", "cdpc512", "hybrid25"};
+  }
+
+ private:
+  std::vector<Stats>& BucketStats(AutotuneFeatures const& features);
+
+  // cdpc needs nranks to be a multiple of (and larger than) its chunk size
+  bool IsEligible(AutotuneFeatures const& features, int cidx) const;
+
+  double ExpectedCost(AutotuneFeatures const& features,
+                      Stats const& stats) const;
+
+  const std::vector<std::string> candidates_;
+  const double solve_weight_;
+  const double budget_ms_;
+  const int explore_intvl_;
+  const double alpha_;
+
+  int ncalls_;
+  std::map<std::pair<int, int>, std::vector<Stats>> stats_;
+};
+}  // namespace amr
@@ -0,0 +1,306 @@
+//
+// Exact placement via branch-and-bound (no external solver)
+//
+
+#include <algorithm>
+#include <numeric>
+#include <queue>
+#include <vector>
+
+#include "lb-common/deadline.h"
+#include "lb-common/lb_policies.h"
+#include "lb-common/lower_bound.h"
+#include "lb-common/policy_wopts.h"
+#include "lb-common/telemetry.h"
+#include "tools-common/logging.h"
+
+namespace {
+double ComputeMakespan(std::vector<double> const& costlist,
+                       std::vector<int> const& ranklist, int nranks) {
+  std::vector<double> loads(nranks, 0);
+  for (int bidx = 0; bidx < costlist.size(); bidx++) {
+    loads[ranklist[bidx]] += costlist[bidx];
+  }
+  return *std::max_element(loads.begin(), loads.end());
+}
+
+//
+// AssignBlocksKK: multiway Karmarkar-Karp (largest differencing).
+// Each block starts as a partial placement with the block on one rank;
+// the two partials with the largest spread are repeatedly merged, pairing
+// the heaviest rank of one with the lightest rank of the other
+//
+void AssignBlocksKK(std::vector<double> const& costlist,
+                    std::vector<int>& ranklist, int nranks) {
+  struct Partial {
+    std::vector<double> loads;             // descending
+    std::vector<std::vector<int>> blocks;  // blocks[i]: blocks on loads[i]
+
+    double Spread() const { return loads.front() - loads.back(); }
+  };
+
+  int nblocks = costlist.size();
+  std::vector<Partial> partials(nblocks);
+
+  using SpreadIdx = std::pair<double, int>;
+  std::priority_queue<SpreadIdx> pq;
+
+  for (int bidx = 0; bidx < nblocks; bidx++) {
+    auto& p = partials[bidx];
+    p.loads.assign(nranks, 0);
+    p.blocks.resize(nranks);
+    p.loads[0] = costlist[bidx];
+    p.blocks[0].push_back(bidx);
+    pq.emplace(p.Spread(), bidx);
+  }
+
+  while (pq.size() > 1) {
+    int a = pq.top().second;
+    pq.pop();
+    int b = pq.top().second;
+    pq.pop();
+
+    auto& pa = partials[a];
+    auto& pb = partials[b];
+    for (int i = 0; i < nranks; i++) {
+      int j = nranks - 1 - i;
+      pa.loads[i] += pb.loads[j];
+      pa.blocks[i].insert(pa.blocks[i].end(), pb.blocks[j].begin(),
+                          pb.blocks[j].end());
+    }
+
+    // re-sort subsets by load, keeping blocks attached
+    std::vector<int> order(nranks);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&pa](int x, int y) { return pa.loads[x] > pa.loads[y]; });
+
+    Partial merged;
+    for (int i : order) {
+      merged.loads.push_back(pa.loads[i]);
+      merged.blocks.push_back(std::move(pa.blocks[i]));
+    }
+    pa = std::move(merged);
+    pb = Partial();
+    pq.emplace(pa.Spread(), a);
+  }
+
+  ranklist.resize(nblocks);
+  if (nblocks == 0) return;
+
+  auto const& p = partials[pq.top().second];
+  for (int rank = 0; rank < nranks; rank++) {
+    for (int bidx : p.blocks[rank]) {
+      ranklist[bidx] = rank;
+    }
+  }
+}
+
+//
+// BnBSolver: depth-first search over blocks in descending cost order,
+// assigning each to a rank. Prunes on the incumbent, and on wasted space:
+// rank headroom (below the incumbent) smaller than the smallest block
+// can not be used, and the rest must fit all unplaced blocks. Skips ranks
+// with the same load as one already tried at this level (symmetric
+// subtrees), and stops once the incumbent meets the lower bound within
+// rel_gap
+//
+class BnBSolver {
+ public:
+  BnBSolver(std::vector<double> const& costlist, int nranks,
+            amr::PolicyOptsBnB const& opts,
+            std::vector<amr::BnBProgress>* progress)
+      : costlist_(costlist),
+        nranks_(nranks),
+        opts_(opts),
+        deadline_(opts.time_limit_ms),
+        progress_(progress),
+        order_(costlist.size()),
+        suffix_sum_(costlist.size() + 1, 0),
+        loads_(nranks, 0),
+        cur_(costlist.size()),
+        nnodes_(0),
+        timed_out_(false) {
+    std::iota(order_.begin(), order_.end(), 0);
+    std::stable_sort(order_.begin(), order_.end(), [&costlist](int a, int b) {
+      return costlist[a] > costlist[b];
+    });
+
+    lower_bound_ = amr::LowerBound::Any(costlist, nranks);
+
+    for (int i = order_.size() - 1; i >= 0; i--) {
+      suffix_sum_[i] = suffix_sum_[i + 1] + costlist[order_[i]];
+    }
+    cost_min_ = order_.empty() ? 0 : costlist[order_.back()];
+  }
+
+  // Solve: ranklist holds the incumbent on entry, and the best on return
+  bool Solve(std::vector<int>& ranklist) {
+    best_ = ranklist;
+    best_makespan_ = ComputeMakespan(costlist_, best_, nranks_);
+    Record(true);
+
+    if (not Done()) {
+      Search(0, 0);
+    }
+
+    // an exhausted search proves the incumbent optimal if nothing was
+    // pruned by rel_gap; otherwise, only that it is within rel_gap of it
+    if (not timed_out_) {
+      lower_bound_ = (opts_.rel_gap == 0)
+                         ? best_makespan_
+                         : std::max(lower_bound_,
+                                    best_makespan_ / (1 + opts_.rel_gap));
+    }
+    Record(true);
+
+    ranklist = best_;
+    return not timed_out_;
+  }
+
+  double Gap() const {
+    return lower_bound_ > 0 ? best_makespan_ / lower_bound_ - 1 : 0;
+  }
+
+  double Makespan() const { return best_makespan_; }
+  double LowerBound() const { return lower_bound_; }
+  int64_t NumNodes() const { return nnodes_; }
+
+ private:
+  // Search: place the idx-th largest block, given the max load so far
+  void Search(int idx, double cur_max) {
+    if (timed_out_ or Done()) return;
+
+    if (++nnodes_ % kNodesPerDeadlineCheck == 0 and deadline_.Expired()) {
+      timed_out_ = true;
+      return;
+    }
+
+    if (idx == order_.size()) {
+      best_makespan_ = cur_max;
+      for (int i = 0; i < order_.size(); i++) {
+        best_[order_[i]] = cur_[i];
+      }
+      Record(false);
+      return;
+    }
+
+    double c = costlist_[order_[idx]];
+    double bound = best_makespan_ - Tolerance();
+
+    double headroom = 0;
+    for (int rank = 0; rank < nranks_; rank++) {
+      double h = bound - loads_[rank];
+      if (h >= cost_min_) headroom += h;
+    }
+    if (headroom < suffix_sum_[idx]) return;
+
+    std::vector<double> tried;
+    for (int rank = 0; rank < nranks_; rank++) {
+      double load = loads_[rank] + c;
+      if (load >= bound) continue;
+      if (std::find(tried.begin(), tried.end(), loads_[rank]) != tried.end()) {
+        continue;
+      }
+      tried.push_back(loads_[rank]);
+
+      double load_prev = loads_[rank];
+      loads_[rank] = load;
+      cur_[idx] = rank;
+      Search(idx + 1, std::max(cur_max, load));
+      loads_[rank] = load_prev;
+
+      if (timed_out_ or Done()) return;
+      bound = best_makespan_ - Tolerance();
+    }
+  }
+
+  bool Done() const {
+    return best_makespan_ <= lower_bound_ * (1 + opts_.rel_gap) + 1e-9;
+  }
+
+  // improvements smaller than this are not worth searching for
+  double Tolerance() const {
+    return std::max(opts_.rel_gap * lower_bound_, 1e-9 * best_makespan_);
+  }
+
+  // Record: log the incumbent; unforced, only if it improved noticeably
+  void Record(bool force) {
+    if (progress_ == nullptr) return;
+    if (not force and not progress_->empty() and
+        best_makespan_ > progress_->back().makespan * (1 - kMinRecordedGain)) {
+      return;
+    }
+    progress_->push_back(
+        {deadline_.ElapsedMs(), best_makespan_, lower_bound_, nnodes_});
+  }
+
+  static constexpr int kNodesPerDeadlineCheck = 4096;
+  static constexpr double kMinRecordedGain = 1e-4;
+
+  std::vector<double> const& costlist_;
+  const int nranks_;
+  const amr::PolicyOptsBnB opts_;
+  const amr::Deadline deadline_;
+  std::vector<amr::BnBProgress>* const progress_;
+
+  std::vector<int> order_;     // blocks, by descending cost
+  std::vector<double> suffix_sum_;  // suffix_sum_[i]: cost of order_[i:]
+  double cost_min_;
+  std::vector<double> loads_;  // per-rank load of the partial placement
+  std::vector<int> cur_;       // cur_[i]: rank of block order_[i]
+
+  std::vector<int> best_;
+  double best_makespan_;
+  double lower_bound_;
+  int64_t nnodes_;
+  bool timed_out_;
+};
+}  // namespace
+
+namespace amr {
+int LoadBalancePolicies::AssignBlocksBnB(std::vector<double> const& costlist,
+                                         std::vector<int>& ranklist,
+                                         int nranks,
+                                         PolicyOptsBnB const& opts,
+                                         std::vector<BnBProgress>* progress) {
+  int nblocks = costlist.size();
+  if (nranks <= 0) {
+    MLOG(MLOG_WARN, "[BnB] Invalid nranks: %d", nranks);
+    return -1;
+  }
+
+  ranklist.resize(nblocks);
+  if (progress) progress->clear();
+
+  // incumbent: the better of LPT and KK
+  std::vector<int> ranklist_kk;
+  {
+    ScopedPhase phase("incumbent");
+    int rv = AssignBlocksLPT(costlist, ranklist, nranks);
+    if (rv) return rv;
+
+    AssignBlocksKK(costlist, ranklist_kk, nranks);
+    if (ComputeMakespan(costlist, ranklist_kk, nranks) <
+        ComputeMakespan(costlist, ranklist, nranks)) {
+      ranklist.swap(ranklist_kk);
+    }
+  }
+
+  ScopedPhase phase("search");
+  BnBSolver solver(costlist, nranks, opts, progress);
+  bool complete = solver.Solve(ranklist);
+
+  Telemetry::AddIters(solver.NumNodes());
+  Telemetry::NoteWorkingSet(nblocks * (sizeof(int) * 3 + sizeof(double)));
+
+  MLOG(MLOG_DBG0,
+       "[BnB] nblocks: %d, nranks: %d, makespan: %.2lf, lb: %.2lf, "
+       "gap: %.2lf%% (%s, %ld nodes)",
+       nblocks, nranks, solver.Makespan(), solver.LowerBound(),
+       solver.Gap() * 100, complete ? "complete" : "time limit",
+       static_cast<long>(solver.NumNodes()));
+
+  return 0;
+}
+}  // namespace amr
@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "lb-common/lb_policies.h"
+#include "lb-common/telemetry.h"
 #include "tools-common/logging.h"
 
 namespace amr {
@@ -127,6 +128,7 @@ public:
 
     int sendcnt = (mympirank < nchunks) ? chunks[mympirank].NumBlocks() : 0;
 
+    ScopedPhase phase("gather");
     int rv =
         MPI_Allgatherv(chunk_ranklist.data(), sendcnt, MPI_INT, ranklist.data(),
                        recvcnts.data(), displs.data(), MPI_INT, comm);
@@ -8,7 +8,10 @@
 #include <numeric>
 #include <vector>
 
+#include "lb-common/constants.h"
 #include "lb-common/lb_policies.h"
+#include "lb-common/lower_bound.h"
+#include "lb-common/telemetry.h"
 #include "tools-common/logging.h"
 
 namespace {
@@ -66,12 +69,59 @@ double GetSumRange(std::vector<double> const& cum_sum, int a, int b) {
   }
 }
 
-#define LOG_TIME(evt) \
-  MLOG(MLOG_DBG0, "Time taken until %s: %.2lf ms", evt, GetTimeMs() - _ts_beg);
+// logs the time since the start, and reports the time since the previous
+// LOG_TIME as a telemetry phase
+#define LOG_TIME(evt, phase)                                                \
+  do {                                                                      \
+    double _ts_now = GetTimeMs();                                           \
+    MLOG(MLOG_DBG0, "Time taken until %s: %.2lf ms", evt, _ts_now - _ts_beg); \
+    amr::Telemetry::AddPhase(phase, _ts_now - _ts_prev);                    \
+    _ts_prev = _ts_now;                                                     \
+  } while (0)
+
+//
+// AssignBlocksGreedyCapped: one left-to-right pass over the DP's search
+// space, taking the larger chunk whenever it fits under cap. Succeeds iff
+// every chunk fits, in which case the placement is within cap of the DP
+// optimum and the DP can be skipped
+//
+bool AssignBlocksGreedyCapped(std::vector<double> const& costlist,
+                              std::vector<int>& ranklist, int nranks,
+                              double cap) {
+  int nblocks = costlist.size();
+  int n_a = nblocks / nranks;
+  int n_b = n_a + 1;
+  int nalloc_b = nblocks % nranks;
+  int nalloc_a = nranks - nalloc_b;
+
+  int bidx = 0;
+  for (int rank = 0; rank < nranks; rank++) {
+    double sum_a = std::accumulate(costlist.begin() + bidx,
+                                   costlist.begin() + bidx + n_a, 0.0);
+    double sum_b = nalloc_b > 0 ? sum_a + costlist[bidx + n_a] : cap + 1;
+
+    int n;
+    if (nalloc_b > 0 and (sum_b <= cap or nalloc_a == 0)) {
+      n = n_b;
+      nalloc_b--;
+      if (sum_b > cap) return false;
+    } else {
+      n = n_a;
+      nalloc_a--;
+      if (sum_a > cap) return false;
+    }
+
+    std::fill(ranklist.begin() + bidx, ranklist.begin() + bidx + n, rank);
+    bidx += n;
+  }
+
+  return true;
+}
 
 int AssignBlocksDP(std::vector<double> const& costlist,
                    std::vector<int>& ranklist, int nranks) {
   double _ts_beg = GetTimeMs();
+  double _ts_prev = _ts_beg;
 
   double cost_total = std::accumulate(costlist.begin(), costlist.end(), 0.0);
   double cost_target = cost_total / nranks;
@@ -101,7 +151,9 @@ int AssignBlocksDP(std::vector<double> const& costlist,
     }
   }
 
-  LOG_TIME("INIT");
+  amr::Telemetry::NoteWorkingSet(
+      sizeof(double) * (nblocks + (nalloc_a + 1) * (nalloc_b + 1)));
+  LOG_TIME("INIT", "prefix_sum");
 
   dp[0][0] = 0;
   for (int i = 0; i <= nalloc_a; i++) {
@@ -136,7 +188,7 @@ int AssignBlocksDP(std::vector<double> const& costlist,
     }
   }
 
-  LOG_TIME("DP");
+  LOG_TIME("DP", "dp");
   MLOG(MLOG_DBG2, "DP Cost: %.2lf", dp[nalloc_a][nalloc_b]);
 
   int i = nalloc_a;
@@ -179,13 +231,16 @@ int AssignBlocksDP(std::vector<double> const& costlist,
     cur_rank--;
   }
 
-  LOG_TIME("BACKTRACK");
+  LOG_TIME("BACKTRACK", "backtrack");
 
   return 0;
 }
 }  // namespace
 
 namespace amr {
+// LowerBound::Epsilon binds it to a const&, so it needs a definition
+constexpr double Constants::kLowerBoundEpsilon;
+
 int LoadBalancePolicies::AssignBlocksContigImproved(
     std::vector<double> const& costlist, std::vector<int>& ranklist,
     int nranks) {
@@ -194,8 +249,25 @@ int LoadBalancePolicies::AssignBlocksContigImproved(
     MLOG(MLOG_DBG0,
          "Blocks evenly divisible by nranks_, using AssignBlocksContiguous");
     return AssignBlocksContiguous(costlist, ranklist, nranks);
-  } else {
-    return ::AssignBlocksDP(costlist, ranklist, nranks);
   }
+
+  // skip the DP if a greedy pass is provably within eps of its optimum.
+  // The placement then need not match the DP's, but its makespan is at most
+  // ContiguousFixedSize * (1 + eps), and so within eps of the DP's
+  double lb = LowerBound::ContiguousFixedSize(costlist, nranks);
+  double eps = LowerBound::Epsilon();
+  bool greedy_ok;
+  {
+    ScopedPhase phase("greedy");
+    greedy_ok =
+        ::AssignBlocksGreedyCapped(costlist, ranklist, nranks, lb * (1 + eps));
+  }
+
+  if (greedy_ok) {
+    MLOG(MLOG_DBG0, "[CDP] Greedy placement within %.2lf%% of bound", eps * 100);
+    return 0;
+  }
+
+  return ::AssignBlocksDP(costlist, ranklist, nranks);
 }
 }  // namespace amr
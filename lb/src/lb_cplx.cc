@@ -4,9 +4,12 @@
 #include <numeric>
 
 #include "tools-common/logging.h"
+#include "lb-common/deadline.h"
 #include "lb-common/lb_policies.h"
+#include "lb-common/lower_bound.h"
 #include "lb-common/policy_utils.h"
 #include "lb-common/policy_wopts.h"
+#include "lb-common/telemetry.h"
 
 struct PartialLPTSolution {
   // inputs
@@ -98,17 +101,14 @@ int LoadBalancePolicies::AssignBlocksHybridCppFirst(
   int lpt_ranks = nranks * lpt_frac;
   int alt_solncnt_max = opts.alt_solncnt_max;
 
-  static bool first_time = true;
-
-  if (first_time) {
-    MLOG(MLOG_INFO,
-         "[HybridCppFirst] LPT ranks: %d, V2: %s, altcnt: %d, CDP: %s",
-         lpt_ranks, v2 ? "yes" : "no", alt_solncnt_max,
-         HybridAssignmentCppFirst::kCDPPolicyStr);
-    first_time = false;
-  }
+  MLOG(MLOG_DBG0,
+       "[HybridCppFirst] LPT ranks: %d, V2: %s, altcnt: %d, CDP: %s, "
+       "deadline: %.0lf ms",
+       lpt_ranks, v2 ? "yes" : "no", alt_solncnt_max,
+       HybridAssignmentCppFirst::kCDPPolicyStr, opts.deadline_ms);
 
-  auto hacf = HybridAssignmentCppFirst(lpt_ranks, alt_solncnt_max);
+  auto hacf =
+      HybridAssignmentCppFirst(lpt_ranks, alt_solncnt_max, opts.deadline_ms);
 
   if (v2) {
     rv = hacf.AssignBlocksV2(costlist, ranklist, nranks, MPI_COMM_NULL);
@@ -130,17 +130,14 @@ int LoadBalancePolicies::AssignBlocksParallelHybridCDPFirst(
   int lpt_ranks = nranks * lpt_frac;
   int alt_solncnt_max = opts.alt_solncnt_max;
 
-  static bool first_time = true;
-
-  if (first_time) {
-    MLOG(MLOG_INFO,
-         "[HybridCppFirst] LPT ranks: %d, V2: %s, altcnt: %d, CDP: %s",
-         lpt_ranks, v2 ? "yes" : "no", alt_solncnt_max,
-         HybridAssignmentCppFirst::kCDPPolicyStr);
-    first_time = false;
-  }
+  MLOG(MLOG_DBG0,
+       "[HybridCppFirst] LPT ranks: %d, V2: %s, altcnt: %d, CDP: %s, "
+       "deadline: %.0lf ms",
+       lpt_ranks, v2 ? "yes" : "no", alt_solncnt_max,
+       HybridAssignmentCppFirst::kCDPPolicyStr, opts.deadline_ms);
 
-  auto hacf = HybridAssignmentCppFirst(lpt_ranks, alt_solncnt_max);
+  auto hacf =
+      HybridAssignmentCppFirst(lpt_ranks, alt_solncnt_max, opts.deadline_ms);
 
   if (v2) {
     rv = hacf.AssignBlocksV2(costlist, ranklist, nranks, comm);
@@ -219,6 +216,7 @@ int HybridAssignmentCppFirst::AssignBlocksV2(
     std::vector<double> const& costlist, std::vector<int>& ranklist, int nranks,
     MPI_Comm comm) {
   int rv = 0;
+  Deadline deadline(deadline_ms_);
 
   nblocks_ = costlist.size();
   nranks_ = nranks;
@@ -248,6 +246,16 @@ int HybridAssignmentCppFirst::AssignBlocksV2(
        "[HybridCppFirst] Costs after CPP_Iter, avg: %.0lf, max: %.0lf",
        rank_time_avg, rank_time_max);
 
+  // CDP is already near-optimal: nothing for LPT to fix, and CDP has the
+  // best locality
+  double eps = LowerBound::Epsilon();
+  if (LowerBound::Within(rank_time_max, LowerBound::Any(costlist, nranks),
+                         eps)) {
+    MLOG(MLOG_DBG0, "[HybridCppFirst] CDP within %.2lf%% of bound",
+         eps * 100);
+    return rv;
+  }
+
   rank_costs_.clear();
   rank_costs_.resize(nranks, 0.0);
 
@@ -260,10 +268,25 @@ int HybridAssignmentCppFirst::AssignBlocksV2(
   auto ranklist_best = solution.ranklist;
 
   // Explore alternate solutions with lower locality loss
-  // than the given LPT parameter
+  // than the given LPT parameter. ranklist_best is always valid, so the
+  // search can be cut short by the deadline at any point
   int nlpt_alt = solution.lpt_ranks.size();
+  int alt_idx = 0;
+  bool deadline_hit = false;
+
+  ScopedPhase alt_phase("alt");
+
+  for (alt_idx = 0; alt_idx < alt_max_; alt_idx++) {
+    deadline_hit = deadline.Expired();
+    if (comm != MPI_COMM_NULL and deadline.Enabled()) {
+      // all ranks must agree, or they will return different placements
+      int hit_local = deadline_hit, hit_any = 0;
+      MPI_Allreduce(&hit_local, &hit_any, 1, MPI_INT, MPI_LOR, comm);
+      deadline_hit = hit_any;
+    }
+
+    if (deadline_hit) break;
 
-  for (int alt_idx = 0; alt_idx < alt_max_; alt_idx++) {
     PartialLPTSolution alt(costlist, ranklist, rank_costs_, nlpt_alt / 2);
     ComputePartialLPTSolution(alt);
 
@@ -279,6 +302,15 @@ int HybridAssignmentCppFirst::AssignBlocksV2(
     }
   }
 
+  if (deadline.Enabled()) {
+    MLOG(MLOG_DBG0,
+         "[HybridCppFirst] Explored %d/%d alt solns in %.2lf ms%s "
+         "(LPT ranks: %d -> %d)",
+         alt_idx, alt_max_, deadline.ElapsedMs(),
+         deadline_hit ? ", deadline hit" : "", (int)solution.lpt_ranks.size(),
+         nlpt_alt);
+  }
+
   ranklist = ranklist_best;
   return rv;
 }
@@ -9,8 +9,12 @@ namespace amr {
 // `lpt_ranks` ranks using LPT
 class HybridAssignmentCppFirst {
  public:
-  HybridAssignmentCppFirst(int lpt_ranks, int alt_solncnt_max)
-      : lpt_rank_count_(lpt_ranks), alt_max_(alt_solncnt_max) {}
+  // deadline_ms bounds the alternate-solution search (0 = no deadline)
+  HybridAssignmentCppFirst(int lpt_ranks, int alt_solncnt_max,
+                           double deadline_ms = 0)
+      : lpt_rank_count_(lpt_ranks),
+        alt_max_(alt_solncnt_max),
+        deadline_ms_(deadline_ms) {}
 
   int AssignBlocks(std::vector<double> const& costlist,
                    std::vector<int>& ranklist, int nranks);
@@ -64,6 +68,7 @@ class HybridAssignmentCppFirst {
  private:
   const int lpt_rank_count_;
   const int alt_max_;
+  const double deadline_ms_;
 
   int nblocks_;
   int nranks_;
@@ -1,6 +1,7 @@
 //
 // Created by Ankush J on 7/4/23.
 //
+#include "lb-common/deadline.h"
 #include "lb-common/lb_policies.h"
 #include "lb-common/policy_wopts.h"
 #include "lb-common/solver.h"
@@ -24,27 +25,49 @@ int LoadBalancePolicies::AssignBlocksCppIter(
     max_iters = config_max_iters;
   }
 
-  MLOG(MLOG_DBG0, "[CDPI] Max iters: %d", max_iters);
+  MLOG(MLOG_DBG0, "[CDPI] Max iters: %d, deadline: %.0lf ms", max_iters,
+       opts.deadline_ms);
 
-  double avg_cost, max_cost_lpt, max_cost_cpp, max_cost_iter;
+  // the budget covers the whole policy, including the initial CDP
+  Deadline deadline(opts.deadline_ms);
 
   rv = AssignBlocksContigImproved(costlist, ranklist, nranks);
   if (rv)
     return rv;
 
-  Solver::AnalyzePlacement(costlist, ranklist, nranks, avg_cost, max_cost_cpp);
-
   auto solver = Solver();
-  int iters;
+  SolverStats stats = {0, 0, 0, 0, false, false};
+
+  if (deadline.Enabled()) {
+    // anytime: returns the best placement seen within the budget
+    solver.AssignBlocksAnytime(costlist, ranklist, nranks, max_iters, deadline,
+                               stats);
+  } else {
+    // without a deadline, exactly max_iters iterations (or fewer, on
+    // convergence), ending at the last placement, as before
+    double avg_cost;
+    Solver::AnalyzePlacement(costlist, ranklist, nranks, avg_cost,
+                             stats.cost_initial);
+    {
+      ScopedPhase phase("iterate");
+      stats.niters = solver.AssignBlocks(costlist, ranklist, nranks, max_iters);
+    }
+    Solver::AnalyzePlacement(costlist, ranklist, nranks, avg_cost,
+                             stats.cost_final);
+  }
 
-  solver.AssignBlocks(costlist, ranklist, nranks, max_iters);
-  Solver::AnalyzePlacement(costlist, ranklist, nranks, avg_cost, max_cost_iter);
+  double improv_pct = stats.cost_initial > 0
+                          ? (stats.cost_initial - stats.cost_final) * 100.0 /
+                                stats.cost_initial
+                          : 0;
 
-  MLOG(MLOG_DBG0, "IterativeSolver finished. Took %d iters.", iters);
   MLOG(MLOG_DBG0,
-       "Initial Cost: %.0lf, Target Cost: %.0lf.\n"
-       "\t- Avg Cost: %.0lf, Max Cost: %.0lf",
-       max_cost_cpp, max_cost_lpt, avg_cost, max_cost_iter);
+       "[CDPI] Solver finished. Took %d iters (%.2lf ms%s%s).\n"
+       "\t- Initial Max Cost: %.0lf, Final Max Cost: %.0lf (-%.2lf%%)",
+       stats.niters, stats.elapsed_ms,
+       stats.deadline_hit ? ", deadline hit" : "",
+       stats.bound_hit ? ", at lower bound" : "", stats.cost_initial,
+       stats.cost_final, improv_pct);
   return 0;
 }
 } // namespace amr
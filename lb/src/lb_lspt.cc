@@ -11,6 +11,7 @@
 #include "lb-common/lb_policies.h"
 #include "lb-common/policy_utils.h"
 #include "lb-common/solver.h"
+#include "lb-common/telemetry.h"
 #include "lb-common/rank.h"
 #include "lb_util.h"
 
@@ -41,7 +42,14 @@ void AssignBlocks(std::vector<double> const& costlist,
   // corresponding costs
   std::vector<int> indices(costlist.size());
   std::iota(indices.begin(), indices.end(), 0);
-  std::sort(indices.begin(), indices.end(), comp);
+  {
+    amr::ScopedPhase phase("sort");
+    std::sort(indices.begin(), indices.end(), comp);
+  }
+
+  amr::Telemetry::NoteWorkingSet(sizeof(int) * indices.size() +
+                                 sizeof(Rank) * nranks);
+  amr::ScopedPhase phase("lpt");
 
   // Assign the blocks to the ranks using SPT algorithm
   for (int idx : indices) {
@@ -0,0 +1,166 @@
+//
+// Two-level (node, then rank) placement
+//
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "lb-common/lb_policies.h"
+#include "lb-common/policy_wopts.h"
+#include "tools-common/logging.h"
+
+namespace {
+//
+// GroupRanksByNode: node_ranks[n] holds the ranks on node n, in rank order.
+// Node ids in node_map are expected to be dense
+//
+std::vector<std::vector<int>> GroupRanksByNode(
+    std::vector<int> const& node_map) {
+  int nnodes = *std::max_element(node_map.begin(), node_map.end()) + 1;
+  std::vector<std::vector<int>> node_ranks(nnodes);
+
+  for (int rank = 0; rank < node_map.size(); rank++) {
+    node_ranks[node_map[rank]].push_back(rank);
+  }
+
+  return node_ranks;
+}
+
+//
+// ComputeNodeRanges: split blocks into contiguous per-node ranges
+// node n gets blocks [block_first[n], block_first[n + 1])
+// Each node's target cost is proportional to its rank count, and each node
+// gets at least as many blocks as it has ranks.
+//
+int ComputeNodeRanges(std::vector<double> const& costlist,
+                      std::vector<std::vector<int>> const& node_ranks,
+                      std::vector<int>& block_first) {
+  int nblocks = costlist.size();
+  int nnodes = node_ranks.size();
+
+  double cost_rem = std::accumulate(costlist.begin(), costlist.end(), 0.0);
+  int ranks_rem = 0;
+  for (auto const& ranks : node_ranks) {
+    ranks_rem += ranks.size();
+  }
+
+  block_first.resize(nnodes + 1);
+  block_first[0] = 0;
+
+  for (int node = 0; node < nnodes; node++) {
+    int first = block_first[node];
+    int nranks_node = node_ranks[node].size();
+
+    if (nranks_node == 0) {
+      block_first[node + 1] = first;
+      continue;
+    }
+
+    int last = nblocks;
+    double cost = 0;
+
+    if (node < nnodes - 1) {
+      double target = cost_rem * nranks_node / ranks_rem;
+      // leave at least one block per rank for the remaining nodes
+      int max_last = nblocks - (ranks_rem - nranks_node);
+      last = first + nranks_node;
+
+      for (int bidx = first; bidx < last; bidx++) {
+        cost += costlist[bidx];
+      }
+
+      while (last < max_last and cost + costlist[last] <= target) {
+        cost += costlist[last];
+        last++;
+      }
+
+      // take the block straddling the target if that lands closer to it
+      if (last < max_last and
+          (cost + costlist[last] - target) < (target - cost)) {
+        cost += costlist[last];
+        last++;
+      }
+    } else {
+      cost = cost_rem;
+    }
+
+    MLOG(MLOG_DBG2, "[NodeHier] Node %d: B[%d, %d), %d ranks, cost %.2lf",
+         node, first, last, nranks_node, cost);
+
+    block_first[node + 1] = last;
+    cost_rem -= cost;
+    ranks_rem -= nranks_node;
+  }
+
+  return 0;
+}
+}  // namespace
+
+namespace amr {
+int LoadBalancePolicies::AssignBlocksNodeHierarchical(
+    std::vector<double> const& costlist, std::vector<int>& ranklist,
+    int nranks, PolicyOptsNodeHier const& opts,
+    std::vector<int> const& node_map) {
+  int nblocks = costlist.size();
+
+  if (node_map.size() != nranks) {
+    MLOG(MLOG_WARN, "[NodeHier] node_map size %zu != nranks %d",
+         node_map.size(), nranks);
+    return -1;
+  }
+
+  if (nblocks < nranks) {
+    MLOG(MLOG_WARN, "[NodeHier] nblocks < nranks (%d, %d)", nblocks, nranks);
+    return -1;
+  }
+
+  auto node_ranks = GroupRanksByNode(node_map);
+  int nnodes = node_ranks.size();
+
+  std::vector<int> block_first;
+  int rv = ComputeNodeRanges(costlist, node_ranks, block_first);
+  if (rv) return rv;
+
+  MLOG(MLOG_DBG0, "[NodeHier] Placing %d blocks on %d nodes (%d ranks)",
+       nblocks, nnodes, nranks);
+
+  for (int node = 0; node < nnodes; node++) {
+    auto const& ranks = node_ranks[node];
+    if (ranks.empty()) continue;
+
+    std::vector<double> const node_costlist(
+        costlist.begin() + block_first[node],
+        costlist.begin() + block_first[node + 1]);
+    std::vector<int> node_ranklist(node_costlist.size(), -1);
+    int node_nranks = ranks.size();
+
+    switch (opts.intra_policy) {
+      case LoadBalancePolicy::kPolicyContigImproved:
+        rv = AssignBlocksContigImproved(node_costlist, node_ranklist,
+                                        node_nranks);
+        break;
+      case LoadBalancePolicy::kPolicyLPT:
+        rv = AssignBlocksLPT(node_costlist, node_ranklist, node_nranks);
+        break;
+      default:
+        MLOG(MLOG_WARN, "[NodeHier] Unsupported intra-node policy: %s",
+             opts.ToString().c_str());
+        return -1;
+    }
+
+    if (rv) {
+      MLOG(MLOG_WARN, "[NodeHier] Intra-node placement failed on node %d",
+           node);
+      return rv;
+    }
+
+    // map node-local ranks back to global ranks
+    for (int i = 0; i < node_ranklist.size(); i++) {
+      ranklist[block_first[node] + i] = ranks[node_ranklist[i]];
+    }
+  }
+
+  return 0;
+}
+}  // namespace amr
@@ -8,38 +8,80 @@
 #include <cmath>
 #include <numeric>
 
-#include "assignment_cache.h"
 #include "lb-common/constants.h"
 #include "lb-common/policy.h"
 #include "lb-common/policy_utils.h"
 #include "lb-common/policy_wopts.h"
+#include "lb-common/telemetry.h"
+#include "policy_state.h"
+#include "tools-common/config_parser.h"
 #include "tools-common/logging.h"
 
 namespace amr {
+// bound to a const& by GetParamOrDefault, so they need definitions
+constexpr int Constants::kMaxAssignmentCacheReuse;
+constexpr double Constants::kAssignmentCacheMaxRegression;
+constexpr double Constants::kAssignmentCacheQuantum;
+constexpr double Constants::kAutoSolveWeight;
+constexpr int Constants::kAutoExploreIntvl;
+
+PolicyState::PolicyState()
+    : cache(ConfigUtils::GetParamOrDefault<int>(
+                "lb_cache_max_reuse", Constants::kMaxAssignmentCacheReuse),
+            ConfigUtils::GetParamOrDefault<double>(
+                "lb_cache_max_regression",
+                Constants::kAssignmentCacheMaxRegression),
+            ConfigUtils::GetParamOrDefault<double>(
+                "lb_cache_quantum", Constants::kAssignmentCacheQuantum)),
+      tuner(PolicyAutotuner::DefaultCandidates(),
+            ConfigUtils::GetParamOrDefault<double>(
+                "lb_auto_solve_weight", Constants::kAutoSolveWeight),
+            ConfigUtils::GetParamOrDefault<double>("lb_auto_budget_ms", 0.0),
+            ConfigUtils::GetParamOrDefault<int>(
+                "lb_auto_explore_intvl", Constants::kAutoExploreIntvl)) {}
+
 int LoadBalancePolicies::AssignBlocksCached(const char *policy_name,
                                             std::vector<double> const &costlist,
                                             std::vector<int> &ranklist,
                                             int nranks, int my_rank,
-                                            MPI_Comm comm) {
+                                            MPI_Comm comm,
+                                            lb::PlacementTelemetry *telemetry,
+                                            PolicyState *state,
+                                            std::vector<double> const *cost_vars) {
   Logging::Init("amr_lb");
-  static AssignmentCache cache(Constants::kMaxAssignmentCacheReuse);
+  Telemetry::ScopedSink sink(telemetry);
+  double ts_beg = Deadline::NowMs();
+
+  if (state == nullptr) state = &PolicyState::Shared();
+  PolicyState::Scope scope(state);
   int rv = 0;
 
   auto &policy = PolicyUtils::GetPolicy(policy_name);
+  Telemetry::Begin(telemetry, policy.id);
 
-  if (policy.skip_cache) {
+  bool robust = (policy.policy == LoadBalancePolicy::kPolicyRobust and
+                 cost_vars != nullptr);
+  bool skip_cache = policy.skip_cache or robust;
+
+  if (skip_cache) {
     if (my_rank == 0) {
-      MLOG(MLOG_INFO, "Skipping cache");
+      MLOG(MLOG_DBG0, "Skipping cache");
     }
-
-    bool cache_ret = cache.Get(costlist.size(), ranklist);
-    if (cache_ret) {
-      MLOG(MLOG_DBG0, "Cache hit");
+  } else {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    if (state->cache.Get(policy.id, nranks, costlist, ranklist)) {
+      lock.unlock();
+      if (telemetry) telemetry->cache_hit = true;
+      Telemetry::Finish(telemetry, costlist, ranklist, nranks, ts_beg);
       return 0;
     }
   }
 
-  if (comm == MPI_COMM_NULL) {
+  if (robust) {
+    // serial on every rank, as AssignBlocksParallel would do
+    rv = AssignBlocksRobust(costlist, *cost_vars, ranklist, nranks,
+                            policy.robust_opts);
+  } else if (comm == MPI_COMM_NULL) {
     rv = AssignBlocks(policy, costlist, ranklist, nranks);
   } else {
     rv = AssignBlocksParallel(policy, costlist, ranklist, nranks, comm);
@@ -47,7 +89,14 @@ int LoadBalancePolicies::AssignBlocksCached(const char *policy_name,
 
   PolicyUtils::LogAssignmentStats(costlist, ranklist, nranks, my_rank);
 
-  cache.Put(costlist.size(), ranklist);
+  if (rv == 0 and !skip_cache) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->cache.Put(policy.id, nranks, costlist, ranklist);
+  }
+
+  if (rv == 0) {
+    Telemetry::Finish(telemetry, costlist, ranklist, nranks, ts_beg);
+  }
 
   return rv;
 }
@@ -94,6 +143,19 @@ int LoadBalancePolicies::AssignBlocks(const LBPolicyWithOpts &policy,
   case LoadBalancePolicy::kPolicyCDPChunked:
     return AssignBlocksCDPChunked(costlist, ranklist, nranks,
                                   policy.chunked_opts);
+  case LoadBalancePolicy::kPolicyNodeHierarchical: {
+    // no communicator here, fall back to sequentially packed nodes
+    std::vector<int> node_map;
+    PolicyUtils::GetNodeMap(nranks, node_map);
+    return AssignBlocksNodeHierarchical(costlist, ranklist, nranks,
+                                        policy.node_opts, node_map);
+  }
+  case LoadBalancePolicy::kPolicyAuto:
+    return AssignBlocksAuto(costlist, ranklist, nranks, MPI_COMM_NULL);
+  case LoadBalancePolicy::kPolicyRobust:
+    return AssignBlocksRobust(costlist, ranklist, nranks, policy.robust_opts);
+  case LoadBalancePolicy::kPolicyBnB:
+    return AssignBlocksBnB(costlist, ranklist, nranks, policy.bnb_opts);
   default:
     ABORT("LoadBalancePolicy not implemented!!");
   }
@@ -103,13 +165,10 @@ int LoadBalancePolicies::AssignBlocks(const LBPolicyWithOpts &policy,
 int LoadBalancePolicies::AssignBlocksParallel(
     const LBPolicyWithOpts &policy, std::vector<double> const &costlist,
     std::vector<int> &ranklist, int nranks, MPI_Comm comm) {
-  static int mympirank = -1;
-  static int nmpiranks = -1;
-
-  if (mympirank == -1 or nmpiranks == -1) {
-    MPI_Comm_rank(comm, &mympirank);
-    MPI_Comm_size(comm, &nmpiranks);
-  }
+  // not cached across calls: comm may differ from call to call
+  int mympirank, nmpiranks;
+  MPI_Comm_rank(comm, &mympirank);
+  MPI_Comm_size(comm, &nmpiranks);
 
   ranklist.resize(costlist.size());
   // const LBPolicyWithOpts& policy = PolicyUtils::GetPolicy(policy_name);
@@ -123,6 +182,34 @@ int LoadBalancePolicies::AssignBlocksParallel(
     return AssignBlocksParallelHybridCDPFirst(costlist, ranklist, nranks,
                                               policy.hcf_opts, comm, mympirank,
                                               nmpiranks);
+  case LoadBalancePolicy::kPolicyNodeHierarchical: {
+    // the runtime node map only describes policy ranks if the two match
+    std::vector<int> node_map;
+    if (nranks == nmpiranks) {
+      // every rank makes the same calls, so the cache hits everywhere or
+      // nowhere, and the collective below stays matched
+      PolicyState &state = PolicyState::CurrentOrShared();
+      {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.node_map_comm == comm) node_map = state.node_map;
+      }
+
+      if (node_map.size() != nranks) {
+        int rv = PolicyUtils::ComputeNodeMap(comm, node_map);
+        if (rv) return rv;
+
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.node_map_comm = comm;
+        state.node_map = node_map;
+      }
+    } else {
+      PolicyUtils::GetNodeMap(nranks, node_map);
+    }
+    return AssignBlocksNodeHierarchical(costlist, ranklist, nranks,
+                                        policy.node_opts, node_map);
+  }
+  case LoadBalancePolicy::kPolicyAuto:
+    return AssignBlocksAuto(costlist, ranklist, nranks, comm);
   default:
     return AssignBlocks(policy, costlist, ranklist, nranks);
   }
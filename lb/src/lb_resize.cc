@@ -0,0 +1,390 @@
+//
+// Re-placement when the number of ranks changes
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "lb-common/constants.h"
+#include "lb-common/lb_policies.h"
+#include "lb-common/policy_wopts.h"
+#include "tools-common/config_parser.h"
+#include "tools-common/logging.h"
+
+namespace {
+// IsRankContiguous: every rank owns a single run of blocks
+bool IsRankContiguous(std::vector<int> const& ranklist, int nranks) {
+  std::vector<bool> seen(nranks, false);
+
+  for (int bidx = 0; bidx < ranklist.size(); bidx++) {
+    if (bidx > 0 and ranklist[bidx] == ranklist[bidx - 1]) continue;
+    if (seen[ranklist[bidx]]) return false;
+    seen[ranklist[bidx]] = true;
+  }
+
+  return true;
+}
+
+double Makespan(std::vector<double> const& costlist,
+                std::vector<int> const& ranklist, int nranks) {
+  std::vector<double> loads(nranks, 0);
+  for (int bidx = 0; bidx < costlist.size(); bidx++) {
+    loads[ranklist[bidx]] += costlist[bidx];
+  }
+  return *std::max_element(loads.begin(), loads.end());
+}
+
+int CountMoved(std::vector<int> const& ranklist_kept,
+               std::vector<int> const& ranklist) {
+  int nmoved = 0;
+  for (int bidx = 0; bidx < ranklist.size(); bidx++) {
+    nmoved += (ranklist[bidx] != ranklist_kept[bidx]);
+  }
+  return nmoved;
+}
+
+//
+// RelabelToMinimizeMoves: rename the ranks of a fresh placement so that
+// each one lands where most of its blocks already are. ranklist_kept[b] is
+// the new-rank id block b currently lives on (-1 if its rank is gone).
+// Greedy maximum-overlap matching. Relabeling permutes rank ids, so it is
+// only used for placements that are not contiguous in rank order anyway
+//
+void RelabelToMinimizeMoves(std::vector<int> const& ranklist_kept,
+                            std::vector<int>& ranklist, int nranks) {
+  int nblocks = ranklist.size();
+
+  // overlap[(part, rank)] = nblocks, via sorted pair keys
+  std::vector<int64_t> keys;
+  keys.reserve(nblocks);
+  for (int bidx = 0; bidx < nblocks; bidx++) {
+    if (ranklist_kept[bidx] < 0) continue;
+    keys.push_back(static_cast<int64_t>(ranklist[bidx]) * nranks +
+                   ranklist_kept[bidx]);
+  }
+  std::sort(keys.begin(), keys.end());
+
+  // (overlap, key), largest overlap first
+  std::vector<std::pair<int, int64_t>> overlaps;
+  for (int i = 0; i < keys.size();) {
+    int j = i;
+    while (j < keys.size() and keys[j] == keys[i]) j++;
+    overlaps.emplace_back(j - i, keys[i]);
+    i = j;
+  }
+  std::sort(overlaps.begin(), overlaps.end(),
+            [](std::pair<int, int64_t> const& a,
+               std::pair<int, int64_t> const& b) {
+              return a.first != b.first ? a.first > b.first
+                                        : a.second < b.second;
+            });
+
+  std::vector<int> label(nranks, -1);
+  std::vector<bool> taken(nranks, false);
+
+  for (auto const& o : overlaps) {
+    int part = o.second / nranks;
+    int rank = o.second % nranks;
+    if (label[part] != -1 or taken[rank]) continue;
+    label[part] = rank;
+    taken[rank] = true;
+  }
+
+  // leftover parts take leftover ranks in order
+  int rank = 0;
+  for (int part = 0; part < nranks; part++) {
+    if (label[part] != -1) continue;
+    while (taken[rank]) rank++;
+    label[part] = rank;
+    taken[rank] = true;
+  }
+
+  for (int bidx = 0; bidx < nblocks; bidx++) {
+    ranklist[bidx] = label[ranklist[bidx]];
+  }
+}
+
+//
+// ShiftContiguous: among placements that give each rank one range of
+// blocks, in rank order, with no rank above max_load, the one that keeps
+// the most blocks where they are (ranklist_kept). DP over range
+// boundaries: kept[r][e] is the most blocks kept by ranks 0..r-1 covering
+// blocks [0, e). The starts s that rank r-1 can take for its range [s, e)
+// only move right as e does, so each row is a sliding-window maximum.
+// Boundary r is confined to the blocks where ranks before it can carry
+// their load, and ranks after it theirs. Returns false if nothing fits, or
+// if the DP table would exceed kMaxCells
+//
+bool ShiftContiguous(std::vector<double> const& costlist,
+                     std::vector<int> const& ranklist_kept,
+                     std::vector<int>& ranklist, int nranks,
+                     double max_load) {
+  const int64_t kMaxCells = 1 << 24;
+  int nblocks = costlist.size();
+
+  std::vector<double> prefix(nblocks + 1, 0);
+  for (int bidx = 0; bidx < nblocks; bidx++) {
+    prefix[bidx + 1] = prefix[bidx] + costlist[bidx];
+  }
+
+  // slack for rounding in the prefix sums
+  double cap = max_load * (1 + 1e-9);
+  double total = prefix[nblocks];
+
+  // boundary r (start of rank r's range) lies in [lo[r], hi[r]]
+  std::vector<int> lo(nranks + 1), hi(nranks + 1);
+  int64_t ncells = 0;
+  for (int r = 0; r <= nranks; r++) {
+    lo[r] = std::lower_bound(prefix.begin(), prefix.end(),
+                             total - (nranks - r) * cap) -
+            prefix.begin();
+    hi[r] = std::upper_bound(prefix.begin(), prefix.end(), r * cap) -
+            prefix.begin() - 1;
+    if (r == 0) lo[r] = hi[r] = 0;
+    if (r == nranks) lo[r] = hi[r] = nblocks;
+    if (lo[r] > hi[r]) return false;
+    ncells += hi[r] - lo[r] + 1;
+  }
+
+  if (ncells > kMaxCells) {
+    MLOG(MLOG_DBG0, "[Resize] Boundary DP too large (%ld cells)",
+         static_cast<long>(ncells));
+    return false;
+  }
+
+  // from[r][e - lo[r]]: start of rank r-1's range, if it ends at e
+  std::vector<std::vector<int>> from(nranks + 1);
+  std::vector<int> kept_prev(1, 0), kept_next;
+  std::vector<int> nkept;
+  std::deque<int> window;
+
+  for (int r = 0; r < nranks; r++) {
+    // nkept[x - lo[r]]: blocks of rank r in [lo[r], x)
+    nkept.assign(hi[r + 1] - lo[r] + 1, 0);
+    for (int x = lo[r]; x < hi[r + 1]; x++) {
+      nkept[x + 1 - lo[r]] = nkept[x - lo[r]] + (ranklist_kept[x] == r);
+    }
+
+    auto score = [&](int s) {
+      return kept_prev[s - lo[r]] - nkept[s - lo[r]];
+    };
+
+    kept_next.assign(hi[r + 1] - lo[r + 1] + 1, -1);
+    from[r + 1].assign(kept_next.size(), -1);
+    window.clear();
+    int s_next = lo[r];
+
+    for (int e = lo[r + 1]; e <= hi[r + 1]; e++) {
+      for (; s_next <= std::min(e, hi[r]); s_next++) {
+        if (kept_prev[s_next - lo[r]] < 0) continue;
+        while (not window.empty() and score(window.back()) <= score(s_next)) {
+          window.pop_back();
+        }
+        window.push_back(s_next);
+      }
+
+      while (not window.empty() and
+             prefix[e] - prefix[window.front()] > cap) {
+        window.pop_front();
+      }
+
+      if (window.empty()) continue;
+
+      int s = window.front();
+      kept_next[e - lo[r + 1]] = score(s) + nkept[e - lo[r]];
+      from[r + 1][e - lo[r + 1]] = s;
+    }
+
+    kept_prev.swap(kept_next);
+  }
+
+  if (kept_prev[0] < 0) return false;
+
+  ranklist.resize(nblocks);
+  int e = nblocks;
+  for (int r = nranks; r > 0; r--) {
+    int s = from[r][e - lo[r]];
+    std::fill(ranklist.begin() + s, ranklist.begin() + e, r - 1);
+    e = s;
+  }
+
+  return true;
+}
+
+//
+// RepairKeptPlacement: keep blocks where they are, place orphaned blocks
+// LPT-style, then move blocks from the most to the least loaded rank until
+// the makespan is within target. Returns the achieved makespan
+//
+double RepairKeptPlacement(std::vector<double> const& costlist,
+                           std::vector<int> const& ranklist_kept,
+                           std::vector<int>& ranklist, int nranks,
+                           double target, int max_moves) {
+  int nblocks = costlist.size();
+  std::vector<double> loads(nranks, 0);
+  std::vector<std::vector<int>> rank_blocks(nranks);
+  std::vector<int> orphans;
+
+  ranklist = ranklist_kept;
+  for (int bidx = 0; bidx < nblocks; bidx++) {
+    int rank = ranklist[bidx];
+    if (rank < 0) {
+      orphans.push_back(bidx);
+    } else {
+      loads[rank] += costlist[bidx];
+      rank_blocks[rank].push_back(bidx);
+    }
+  }
+
+  std::sort(orphans.begin(), orphans.end(), [&costlist](int a, int b) {
+    return costlist[a] > costlist[b];
+  });
+
+  using LoadRank = std::pair<double, int>;
+  std::priority_queue<LoadRank, std::vector<LoadRank>, std::greater<LoadRank>>
+      pq;
+  for (int rank = 0; rank < nranks; rank++) {
+    pq.emplace(loads[rank], rank);
+  }
+
+  for (int bidx : orphans) {
+    int rank = pq.top().second;
+    pq.pop();
+    ranklist[bidx] = rank;
+    loads[rank] += costlist[bidx];
+    rank_blocks[rank].push_back(bidx);
+    pq.emplace(loads[rank], rank);
+  }
+
+  for (int nmoves = 0; nmoves < max_moves; nmoves++) {
+    auto mm = std::minmax_element(loads.begin(), loads.end());
+    int rmin = mm.first - loads.begin();
+    int rmax = mm.second - loads.begin();
+    double lmin = *mm.first, lmax = *mm.second;
+    if (lmax <= target) break;
+
+    // the block that brings the pair closest to even
+    auto& src_blocks = rank_blocks[rmax];
+    double best = lmax;
+    int best_idx = -1;
+    for (int idx = 0; idx < src_blocks.size(); idx++) {
+      double c = costlist[src_blocks[idx]];
+      double cost = std::max(lmax - c, lmin + c);
+      if (cost < best) {
+        best = cost;
+        best_idx = idx;
+      }
+    }
+
+    if (best_idx == -1) break;
+
+    int bidx = src_blocks[best_idx];
+    src_blocks[best_idx] = src_blocks.back();
+    src_blocks.pop_back();
+    rank_blocks[rmin].push_back(bidx);
+    ranklist[bidx] = rmin;
+    loads[rmax] -= costlist[bidx];
+    loads[rmin] += costlist[bidx];
+  }
+
+  return *std::max_element(loads.begin(), loads.end());
+}
+}  // namespace
+
+namespace amr {
+// bound to a const& by GetParamOrDefault, so it needs a definition
+constexpr double Constants::kResizeMakespanTolerance;
+
+int LoadBalancePolicies::AssignBlocksResize(
+    const LBPolicyWithOpts& policy, std::vector<double> const& costlist,
+    std::vector<int> const& ranklist_old, std::vector<int> const& rank_map,
+    std::vector<int>& ranklist, int nranks, int& nblocks_moved) {
+  int nblocks = costlist.size();
+  int nranks_old = rank_map.size();
+
+  if (ranklist_old.size() != nblocks or nranks <= 0) {
+    MLOG(MLOG_WARN, "[Resize] Bad input (nblocks: %d/%zu, nranks: %d)",
+         nblocks, ranklist_old.size(), nranks);
+    return -1;
+  }
+
+  // rank_map must be injective into [0, nranks), with -1 for gone ranks
+  std::vector<bool> mapped(nranks, false);
+  for (int rank_old = 0; rank_old < nranks_old; rank_old++) {
+    int rank_new = rank_map[rank_old];
+    if (rank_new == -1) continue;
+    if (rank_new < 0 or rank_new >= nranks or mapped[rank_new]) {
+      MLOG(MLOG_WARN, "[Resize] Bad rank_map: old rank %d -> %d", rank_old,
+           rank_new);
+      return -1;
+    }
+    mapped[rank_new] = true;
+  }
+
+  // ranklist_kept: where each block is now, in new-rank ids
+  std::vector<int> ranklist_kept(nblocks);
+  for (int bidx = 0; bidx < nblocks; bidx++) {
+    int rank_old = ranklist_old[bidx];
+    if (rank_old < 0 or rank_old >= nranks_old) {
+      MLOG(MLOG_WARN, "[Resize] Block %d: bad old rank %d", bidx, rank_old);
+      return -1;
+    }
+    ranklist_kept[bidx] = rank_map[rank_old];
+  }
+
+  int rv = AssignBlocks(policy, costlist, ranklist, nranks);
+  if (rv) return rv;
+
+  double makespan = Makespan(costlist, ranklist, nranks);
+  const char* mode = "relabel";
+
+  // the old placement is reused as long as it ends up about as balanced as
+  // the policy's own placement
+  double tol = ConfigUtils::GetParamOrDefault<double>(
+      "lb_resize_tolerance", Constants::kResizeMakespanTolerance);
+
+  if (IsRankContiguous(ranklist, nranks)) {
+    // contiguous: shift the range boundaries to keep blocks in place.
+    // Relabeling would keep one range per rank, but not the rank order of
+    // the ranges, which contiguity (and locality between neighboring
+    // ranks) relies on
+    std::vector<int> ranklist_shifted;
+    if (ShiftContiguous(costlist, ranklist_kept, ranklist_shifted, nranks,
+                        makespan * (1 + tol))) {
+      ranklist = std::move(ranklist_shifted);
+      makespan = Makespan(costlist, ranklist, nranks);
+      mode = "shift";
+    } else {
+      mode = "contiguous";
+    }
+  } else {
+    // free-form: repair the old placement
+    std::vector<int> ranklist_repaired;
+    double makespan_repaired =
+        RepairKeptPlacement(costlist, ranklist_kept, ranklist_repaired,
+                            nranks, makespan * (1 + tol), nblocks);
+
+    if (makespan_repaired <= makespan * (1 + tol)) {
+      ranklist = std::move(ranklist_repaired);
+      makespan = makespan_repaired;
+      mode = "repair";
+    } else {
+      RelabelToMinimizeMoves(ranklist_kept, ranklist, nranks);
+    }
+  }
+
+  nblocks_moved = CountMoved(ranklist_kept, ranklist);
+
+  MLOG(MLOG_INFO,
+       "[Resize] %s: ranks %d -> %d, %d/%d blocks moved (%s), "
+       "makespan: %.2lf",
+       policy.id.c_str(), nranks_old, nranks, nblocks_moved, nblocks, mode,
+       makespan);
+
+  return 0;
+}
+}  // namespace amr
@@ -0,0 +1,270 @@
+//
+// Placement under cost uncertainty
+//
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "lb-common/constants.h"
+#include "lb-common/lb_policies.h"
+#include "lb-common/policy_wopts.h"
+#include "lb-common/telemetry.h"
+#include "tools-common/config_parser.h"
+#include "tools-common/logging.h"
+
+namespace {
+//
+// NormalQuantile: z such that P(N(0, 1) <= z) = q
+// Abramowitz & Stegun 26.2.23, |error| < 4.5e-4, which is plenty here
+//
+double NormalQuantile(double q) {
+  q = std::min(std::max(q, 1e-6), 1 - 1e-6);
+  double p = q < 0.5 ? q : 1 - q;
+  double t = std::sqrt(-2 * std::log(p));
+  double z = t - (2.515517 + 0.802853 * t + 0.010328 * t * t) /
+                     (1 + 1.432788 * t + 0.189269 * t * t +
+                      0.001308 * t * t * t);
+  return q < 0.5 ? -z : z;
+}
+
+//
+// RobustLoads: per-rank sums of block means and variances. The robust
+// load of a rank is the q-quantile of its load, assuming independent
+// normally distributed block costs: mean + z * sqrt(var)
+//
+class RobustLoads {
+ public:
+  RobustLoads(std::vector<double> const& means, std::vector<double> const& vars,
+              std::vector<int> const& ranklist, int nranks, double z)
+      : means_(means), vars_(vars), z_(z), mu_(nranks, 0), var_(nranks, 0) {
+    for (int bidx = 0; bidx < ranklist.size(); bidx++) {
+      mu_[ranklist[bidx]] += means_[bidx];
+      var_[ranklist[bidx]] += vars_[bidx];
+    }
+  }
+
+  double Load(int rank) const { return Load(rank, 0, 0); }
+
+  // robust load of rank after adding (or removing, sign = -1) block bidx
+  double LoadWith(int rank, int bidx, int sign) const {
+    return Load(rank, sign * means_[bidx], sign * vars_[bidx]);
+  }
+
+  void Move(int bidx, int rank_src, int rank_dest) {
+    mu_[rank_src] -= means_[bidx];
+    var_[rank_src] -= vars_[bidx];
+    mu_[rank_dest] += means_[bidx];
+    var_[rank_dest] += vars_[bidx];
+  }
+
+  int MaxRank() const {
+    int rmax = 0;
+    for (int rank = 1; rank < mu_.size(); rank++) {
+      if (Load(rank) > Load(rmax)) rmax = rank;
+    }
+    return rmax;
+  }
+
+  int MinRank() const {
+    int rmin = 0;
+    for (int rank = 1; rank < mu_.size(); rank++) {
+      if (Load(rank) < Load(rmin)) rmin = rank;
+    }
+    return rmin;
+  }
+
+ private:
+  double Load(int rank, double dmu, double dvar) const {
+    return mu_[rank] + dmu + z_ * std::sqrt(std::max(var_[rank] + dvar, 0.0));
+  }
+
+  std::vector<double> const& means_;
+  std::vector<double> const& vars_;
+  const double z_;
+  std::vector<double> mu_;
+  std::vector<double> var_;
+};
+
+bool IsContiguous(std::vector<int> const& ranklist) {
+  return std::is_sorted(ranklist.begin(), ranklist.end());
+}
+
+//
+// ImproveContiguous: repeatedly shift a boundary block of the rank with
+// the largest robust load to its left or right neighbour, while that
+// lowers the robust makespan. Keeps the placement contiguous.
+// Returns the number of moves made
+//
+int ImproveContiguous(RobustLoads& loads, std::vector<int>& ranklist,
+                      int nranks, int max_iters) {
+  // rank r owns blocks [bnd[r], bnd[r + 1])
+  std::vector<int> bnd(nranks + 1, 0);
+  for (auto rank : ranklist) {
+    bnd[rank + 1]++;
+  }
+  for (int rank = 0; rank < nranks; rank++) {
+    bnd[rank + 1] += bnd[rank];
+  }
+
+  int niters = 0;
+  for (; niters < max_iters; niters++) {
+    int rmax = loads.MaxRank();
+    if (bnd[rmax] == bnd[rmax + 1]) break;
+
+    double best = loads.Load(rmax);
+    int best_dest = -1;
+
+    int bidx_first = bnd[rmax];
+    int bidx_last = bnd[rmax + 1] - 1;
+
+    if (rmax > 0) {
+      double cost = std::max(loads.LoadWith(rmax, bidx_first, -1),
+                             loads.LoadWith(rmax - 1, bidx_first, 1));
+      if (cost < best) {
+        best = cost;
+        best_dest = rmax - 1;
+      }
+    }
+
+    if (rmax < nranks - 1) {
+      double cost = std::max(loads.LoadWith(rmax, bidx_last, -1),
+                             loads.LoadWith(rmax + 1, bidx_last, 1));
+      if (cost < best) {
+        best = cost;
+        best_dest = rmax + 1;
+      }
+    }
+
+    if (best_dest == -1) break;
+
+    if (best_dest < rmax) {
+      loads.Move(bidx_first, rmax, best_dest);
+      ranklist[bidx_first] = best_dest;
+      bnd[rmax]++;
+    } else {
+      loads.Move(bidx_last, rmax, best_dest);
+      ranklist[bidx_last] = best_dest;
+      bnd[rmax + 1]--;
+    }
+  }
+
+  return niters;
+}
+
+//
+// ImproveAny: repeatedly move the block from the rank with the largest
+// robust load to the one with the smallest that lowers the robust
+// makespan the most. Returns the number of moves made
+//
+int ImproveAny(RobustLoads& loads, std::vector<int>& ranklist, int nranks,
+               int max_iters) {
+  std::vector<std::vector<int>> rank_blocks(nranks);
+  for (int bidx = 0; bidx < ranklist.size(); bidx++) {
+    rank_blocks[ranklist[bidx]].push_back(bidx);
+  }
+
+  int niters = 0;
+  for (; niters < max_iters; niters++) {
+    int rmax = loads.MaxRank();
+    int rmin = loads.MinRank();
+    if (rmax == rmin) break;
+
+    auto& src_blocks = rank_blocks[rmax];
+    double best = loads.Load(rmax);
+    int best_idx = -1;
+
+    for (int idx = 0; idx < src_blocks.size(); idx++) {
+      int bidx = src_blocks[idx];
+      double cost = std::max(loads.LoadWith(rmax, bidx, -1),
+                             loads.LoadWith(rmin, bidx, 1));
+      if (cost < best) {
+        best = cost;
+        best_idx = idx;
+      }
+    }
+
+    if (best_idx == -1) break;
+
+    int bidx = src_blocks[best_idx];
+    loads.Move(bidx, rmax, rmin);
+    ranklist[bidx] = rmin;
+    src_blocks[best_idx] = src_blocks.back();
+    src_blocks.pop_back();
+    rank_blocks[rmin].push_back(bidx);
+  }
+
+  return niters;
+}
+}  // namespace
+
+namespace amr {
+// bound to a const& by GetParamOrDefault, so it needs a definition
+constexpr double Constants::kRobustCostCV;
+
+int LoadBalancePolicies::AssignBlocksRobust(
+    std::vector<double> const& cost_means, std::vector<double> const& cost_vars,
+    std::vector<int>& ranklist, int nranks, PolicyOptsRobust const& opts) {
+  int nblocks = cost_means.size();
+
+  if (cost_vars.size() != nblocks) {
+    MLOG(MLOG_WARN, "[Robust] cost_vars size %zu != nblocks %d",
+         cost_vars.size(), nblocks);
+    return -1;
+  }
+
+  ranklist.resize(nblocks);
+
+  int rv;
+  switch (opts.base_policy) {
+    case LoadBalancePolicy::kPolicyContigImproved:
+      rv = AssignBlocksContigImproved(cost_means, ranklist, nranks);
+      break;
+    case LoadBalancePolicy::kPolicyLPT:
+      rv = AssignBlocksLPT(cost_means, ranklist, nranks);
+      break;
+    default:
+      MLOG(MLOG_WARN, "[Robust] Unsupported base policy: %s",
+           opts.ToString().c_str());
+      return -1;
+  }
+
+  if (rv) return rv;
+
+  ScopedPhase phase("robust");
+  double z = NormalQuantile(opts.quantile);
+  RobustLoads loads(cost_means, cost_vars, ranklist, nranks, z);
+  double load_beg = loads.Load(loads.MaxRank());
+
+  int niters;
+  if (IsContiguous(ranklist)) {
+    niters = ImproveContiguous(loads, ranklist, nranks, opts.max_iters);
+  } else {
+    niters = ImproveAny(loads, ranklist, nranks, opts.max_iters);
+  }
+
+  Telemetry::AddIters(niters);
+
+  MLOG(MLOG_DBG0,
+       "[Robust] q%.2lf (z: %.2lf): robust makespan %.2lf -> %.2lf "
+       "(%d moves)",
+       opts.quantile, z, load_beg, loads.Load(loads.MaxRank()), niters);
+
+  return 0;
+}
+
+int LoadBalancePolicies::AssignBlocksRobust(std::vector<double> const& costlist,
+                                            std::vector<int>& ranklist,
+                                            int nranks,
+                                            PolicyOptsRobust const& opts) {
+  // no variance estimates: assume a fixed coefficient of variation
+  double cv = ConfigUtils::GetParamOrDefault<double>("lb_robust_cv",
+                                                     Constants::kRobustCostCV);
+  std::vector<double> cost_vars(costlist.size());
+  for (int bidx = 0; bidx < costlist.size(); bidx++) {
+    cost_vars[bidx] = cv * cv * costlist[bidx] * costlist[bidx];
+  }
+
+  return AssignBlocksRobust(costlist, cost_vars, ranklist, nranks, opts);
+}
+}  // namespace amr
@@ -0,0 +1,80 @@
+//
+// Cost-benefit trigger for rebalancing
+//
+
+#include <algorithm>
+
+#include "amr_lb.h"
+#include "placement_eval.h"
+#include "tools-common/logging.h"
+
+namespace amr {
+namespace lb {
+LBTrigger::LBTrigger(LBTriggerOpts const& opts)
+    : opts_(opts),
+      imbalance_after_(1.0),
+      placement_cost_(0),
+      moved_frac_(0),
+      nplacements_(0),
+      last_gain_(0),
+      last_cost_(0) {}
+
+void LBTrigger::Reset() {
+  imbalance_after_ = 1.0;
+  placement_cost_ = 0;
+  moved_frac_ = 0;
+  nplacements_ = 0;
+  last_gain_ = 0;
+  last_cost_ = 0;
+}
+
+bool LBTrigger::ShouldTrigger(std::vector<double> const& costlist,
+                              std::vector<int> const& ranklist, int nranks) {
+  PlacementEval eval;
+  int rv = PlacementEvaluator::Evaluate(costlist, ranklist, nranks, eval);
+  if (rv) {
+    // no valid current placement (e.g. new blocks): must place
+    last_gain_ = last_cost_ = 0;
+    return true;
+  }
+
+  double makespan_after = eval.load_avg * imbalance_after_;
+  double gain_per_ts = std::max(eval.makespan - makespan_after, 0.0);
+
+  last_gain_ = gain_per_ts * opts_.horizon;
+  last_cost_ =
+      placement_cost_ + moved_frac_ * eval.nblocks * opts_.migration_cost;
+
+  bool trigger = last_gain_ > last_cost_;
+
+  MLOG(MLOG_DBG0,
+       "[LBTrigger] imbalance: %.3lf (expected after: %.3lf), "
+       "gain: %.0lf, cost: %.0lf -> %s",
+       eval.imbalance, imbalance_after_, last_gain_, last_cost_,
+       trigger ? "trigger" : "skip");
+
+  return trigger;
+}
+
+void LBTrigger::RecordPlacement(std::vector<double> const& costlist,
+                                std::vector<int> const& ranklist, int nranks,
+                                double placement_cost, int nblocks_moved) {
+  PlacementEval eval;
+  int rv = PlacementEvaluator::Evaluate(costlist, ranklist, nranks, eval);
+  if (rv) return;
+
+  double alpha = nplacements_ == 0 ? 1.0 : opts_.ewma_alpha;
+  auto ewma = [alpha](double prev, double cur) {
+    return (1 - alpha) * prev + alpha * cur;
+  };
+
+  imbalance_after_ = ewma(imbalance_after_, eval.imbalance);
+  placement_cost_ = ewma(placement_cost_, placement_cost);
+  if (nblocks_moved >= 0 and eval.nblocks > 0) {
+    moved_frac_ = ewma(moved_frac_, nblocks_moved * 1.0 / eval.nblocks);
+  }
+
+  nplacements_++;
+}
+}  // namespace lb
+}  // namespace amr
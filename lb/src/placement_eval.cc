@@ -0,0 +1,157 @@
+#include "placement_eval.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "lb-common/constants.h"
+#include "tools-common/logging.h"
+
+namespace amr {
+void PlacementEvaluator::Accumulate(std::vector<double> const& costlist,
+                                    std::vector<int> const& ranklist,
+                                    int nranks, int bidx_beg, int bidx_end,
+                                    Partial& partial) {
+  partial.loads.assign(nranks, 0.0);
+  partial.counts.assign(nranks, 0);
+  partial.loc_score = 0;
+  partial.valid = true;
+
+  double* loads = partial.loads.data();
+  int* counts = partial.counts.data();
+  const double* costs = costlist.data();
+  const int* ranks = ranklist.data();
+
+  for (int bidx = bidx_beg; bidx < bidx_end; bidx++) {
+    int rank = ranks[bidx];
+    if (static_cast<unsigned>(rank) >= static_cast<unsigned>(nranks)) {
+      partial.valid = false;
+      return;
+    }
+
+    loads[rank] += costs[bidx];
+    counts[rank]++;
+  }
+
+  // locality over pairs (b, b + 1), including the pair straddling
+  // bidx_end. Same model as PolicyUtils::ComputeLocCost, written
+  // branch-free so the loop vectorizes: 0 for the same rank, 1 for
+  // adjacent ranks, 2 for the same node, 3 otherwise
+  int nblocks = ranklist.size();
+  int loc_end = std::min(bidx_end, nblocks - 1);
+  int64_t loc_score = 0;
+
+  for (int bidx = bidx_beg; bidx < loc_end; bidx++) {
+    int p = ranks[bidx];
+    int q = ranks[bidx + 1];
+
+    int diff = (p != q);
+    int off_node = (p / Constants::kRanksPerNode) !=
+                   (q / Constants::kRanksPerNode);
+    int adjacent = (q - p == 1) | (p - q == 1);
+
+    loc_score += diff * (2 + off_node - adjacent * (1 + off_node));
+  }
+
+  partial.loc_score = loc_score;
+}
+
+int PlacementEvaluator::Evaluate(std::vector<double> const& costlist,
+                                 std::vector<int> const& ranklist, int nranks,
+                                 lb::PlacementEval& eval, int nthreads,
+                                 std::vector<double>* rank_loads) {
+  int nblocks = costlist.size();
+
+  if (ranklist.size() != nblocks or nranks <= 0) {
+    MLOG(MLOG_WARN,
+         "[EvaluatePlacement] Bad input (nblocks: %d/%zu, nranks: %d)",
+         nblocks, ranklist.size(), nranks);
+    return -1;
+  }
+
+  nthreads = std::max(1, std::min(nthreads, nblocks / kMinBlocksPerThread));
+  std::vector<Partial> partials(nthreads);
+
+  if (nthreads == 1) {
+    Accumulate(costlist, ranklist, nranks, 0, nblocks, partials[0]);
+  } else {
+    std::vector<std::thread> threads;
+    int bidx_per_thread = (nblocks + nthreads - 1) / nthreads;
+
+    for (int tidx = 0; tidx < nthreads; tidx++) {
+      int bidx_beg = std::min(nblocks, tidx * bidx_per_thread);
+      int bidx_end = std::min(nblocks, bidx_beg + bidx_per_thread);
+      threads.emplace_back(Accumulate, std::cref(costlist),
+                           std::cref(ranklist), nranks, bidx_beg, bidx_end,
+                           std::ref(partials[tidx]));
+    }
+
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+
+  // merge partials into partials[0]
+  auto& total = partials[0];
+  for (int tidx = 0; tidx < nthreads; tidx++) {
+    if (not partials[tidx].valid) {
+      MLOG(MLOG_WARN, "[EvaluatePlacement] Rank id out of range [0, %d)",
+           nranks);
+      return -1;
+    }
+  }
+
+  for (int tidx = 1; tidx < nthreads; tidx++) {
+    auto const& p = partials[tidx];
+    for (int rank = 0; rank < nranks; rank++) {
+      total.loads[rank] += p.loads[rank];
+      total.counts[rank] += p.counts[rank];
+    }
+    total.loc_score += p.loc_score;
+  }
+
+  double const* loads = total.loads.data();
+  int const* counts = total.counts.data();
+
+  double load_sum = 0, load_min = loads[0], load_max = loads[0];
+  int count_min = counts[0], count_max = counts[0];
+
+  for (int rank = 0; rank < nranks; rank++) {
+    load_sum += loads[rank];
+    load_min = std::min(load_min, loads[rank]);
+    load_max = std::max(load_max, loads[rank]);
+    count_min = std::min(count_min, counts[rank]);
+    count_max = std::max(count_max, counts[rank]);
+  }
+
+  eval.nblocks = nblocks;
+  eval.nranks = nranks;
+  eval.load_min = load_min;
+  eval.load_avg = load_sum / nranks;
+  eval.makespan = load_max;
+  eval.imbalance = eval.load_avg > 0 ? load_max / eval.load_avg : 1.0;
+  eval.nblocks_min = count_min;
+  eval.nblocks_max = count_max;
+  eval.loc_score = nblocks > 0 ? total.loc_score * 1.0 / nblocks : 0;
+
+  // percentiles via selection, narrowing the range from the top
+  std::vector<double> sel(total.loads);
+  auto pct_idx = [nranks](double pct) {
+    return std::min(nranks - 1, static_cast<int>(pct * nranks));
+  };
+
+  int idx99 = pct_idx(0.99), idx90 = pct_idx(0.90), idx50 = pct_idx(0.50);
+  std::nth_element(sel.begin(), sel.begin() + idx99, sel.end());
+  eval.load_p99 = sel[idx99];
+  std::nth_element(sel.begin(), sel.begin() + idx90, sel.begin() + idx99);
+  eval.load_p90 = sel[idx90];
+  std::nth_element(sel.begin(), sel.begin() + idx50, sel.begin() + idx90);
+  eval.load_p50 = sel[idx50];
+
+  if (rank_loads != nullptr) {
+    *rank_loads = std::move(total.loads);
+  }
+
+  return 0;
+}
+}  // namespace amr
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "amr_lb.h"
+
+namespace amr {
+//
+// PlacementEvaluator: evaluation of a placement in one call. Each block
+// range is read by two tight loops, one for rank loads and counts and a
+// branch-free one for locality, rather than one loop that vectorizes
+// neither.
+// Backs LoadBalance::EvaluatePlacement, and is used internally wherever
+// rank loads and summary stats of a placement are needed.
+//
+class PlacementEvaluator {
+ public:
+  //
+  // Evaluate: fill eval for (costlist, ranklist). If rank_loads is not
+  // null, per-rank loads are returned through it.
+  // Returns -1 if ranklist is malformed (size mismatch or bad rank ids)
+  //
+  static int Evaluate(std::vector<double> const& costlist,
+                      std::vector<int> const& ranklist, int nranks,
+                      lb::PlacementEval& eval, int nthreads = 1,
+                      std::vector<double>* rank_loads = nullptr);
+
+  // below this many blocks per thread, threading is not worth it
+  static constexpr int kMinBlocksPerThread = 16384;
+
+ private:
+  // per-thread partial results over a block range
+  struct Partial {
+    std::vector<double> loads;
+    std::vector<int> counts;
+    int64_t loc_score;
+    bool valid;
+  };
+
+  static void Accumulate(std::vector<double> const& costlist,
+                         std::vector<int> const& ranklist, int nranks,
+                         int bidx_beg, int bidx_end, Partial& partial);
+};
+}  // namespace amr
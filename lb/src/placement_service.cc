@@ -0,0 +1,159 @@
+//
+// Placement offload to a helper rank
+//
+
+#include "amr_lb.h"
+#include "tools-common/logging.h"
+
+namespace {
+enum RequestType { kRequestPlace = 0, kRequestShutdown = 1 };
+
+// tags reserved for the service, so it can share a communicator
+constexpr int kTagRequest = 0x4c42;
+constexpr int kTagPayload = 0x4c43;
+constexpr int kTagReply = 0x4c44;
+}  // namespace
+
+namespace amr {
+namespace lb {
+PlacementService::PlacementService(MPI_Comm comm, int helper_rank)
+    : comm_(comm),
+      helper_rank_(helper_rank),
+      leader_rank_(helper_rank == 0 ? 1 : 0),
+      pending_(false) {}
+
+int PlacementService::SplitHelper(MPI_Comm comm, int helper_rank,
+                                  MPI_Comm* app_comm) {
+  int my_rank;
+  MPI_Comm_rank(comm, &my_rank);
+
+  int color = (my_rank == helper_rank) ? MPI_UNDEFINED : 0;
+  int rv = MPI_Comm_split(comm, color, my_rank, app_comm);
+  return rv == MPI_SUCCESS ? 0 : -1;
+}
+
+int PlacementService::Serve() {
+  Logging::Init("amr_lb");
+
+  int nmpiranks;
+  MPI_Comm_size(comm_, &nmpiranks);
+  int nclients = nmpiranks - 1;
+
+  std::vector<MPI_Request> reqs(2 * nclients);
+  int nserved = 0;
+
+  while (true) {
+    int hdr[4];
+    MPI_Recv(hdr, 4, MPI_INT, leader_rank_, kTagRequest, comm_,
+             MPI_STATUS_IGNORE);
+
+    if (hdr[0] == kRequestShutdown) break;
+
+    int policy_len = hdr[1], nblocks = hdr[2], nranks = hdr[3];
+
+    // messages from one source are not reordered, so the payload follows
+    std::string policy_name(policy_len, '\0');
+    std::vector<double> costlist(nblocks);
+    MPI_Recv(&policy_name[0], policy_len, MPI_CHAR, leader_rank_, kTagPayload,
+             comm_, MPI_STATUS_IGNORE);
+    MPI_Recv(costlist.data(), nblocks, MPI_DOUBLE, leader_rank_, kTagPayload,
+             comm_, MPI_STATUS_IGNORE);
+
+    std::vector<int> ranklist;
+    int rv = LoadBalance::AssignBlocks({policy_name, costlist, ranklist, nranks});
+    if (rv) ranklist.clear();
+
+    // one placement, fanned out to every client; a slow receiver does not
+    // hold up the others
+    int reply[2] = {rv, static_cast<int>(ranklist.size())};
+    int nreqs = 0;
+    for (int dest = 0; dest < nmpiranks; dest++) {
+      if (dest == helper_rank_) continue;
+      MPI_Isend(reply, 2, MPI_INT, dest, kTagReply, comm_, &reqs[nreqs++]);
+      MPI_Isend(ranklist.data(), reply[1], MPI_INT, dest, kTagReply, comm_,
+                &reqs[nreqs++]);
+    }
+    MPI_Waitall(nreqs, reqs.data(), MPI_STATUSES_IGNORE);
+
+    nserved++;
+    MLOG(MLOG_DBG0, "[PlacementService] Served %s (%d blocks) to %d clients",
+         policy_name.c_str(), nblocks, nclients);
+  }
+
+  MLOG(MLOG_INFO, "[PlacementService] Served %d requests to %d clients",
+       nserved, nclients);
+  return 0;
+}
+
+int PlacementService::AssignBlocks(PlacementArgs args) {
+  int rv = Post(args.policy_name, args.costlist, args.nranks);
+  if (rv) return rv;
+  return Wait(args.ranklist);
+}
+
+int PlacementService::Post(std::string const& policy_name,
+                           std::vector<double> const& costlist, int nranks) {
+  if (pending_) {
+    MLOG(MLOG_WARN, "[PlacementService] Post with a request outstanding");
+    return -1;
+  }
+
+  pending_ = true;
+
+  // inputs are the same on all clients, so only the leader sends them
+  if (not IsLeader()) return 0;
+
+  policy_name_ = policy_name;
+  hdr_[0] = kRequestPlace;
+  hdr_[1] = policy_name_.size();
+  hdr_[2] = costlist.size();
+  hdr_[3] = nranks;
+
+  MPI_Isend(hdr_, 4, MPI_INT, helper_rank_, kTagRequest, comm_, &reqs_[0]);
+  MPI_Isend(policy_name_.data(), hdr_[1], MPI_CHAR, helper_rank_, kTagPayload,
+            comm_, &reqs_[1]);
+  MPI_Isend(costlist.data(), hdr_[2], MPI_DOUBLE, helper_rank_, kTagPayload,
+            comm_, &reqs_[2]);
+
+  return 0;
+}
+
+int PlacementService::Wait(std::vector<int>& ranklist) {
+  if (not pending_) {
+    MLOG(MLOG_WARN, "[PlacementService] Wait without a request outstanding");
+    return -1;
+  }
+
+  if (IsLeader()) MPI_Waitall(3, reqs_, MPI_STATUSES_IGNORE);
+
+  int reply[2];
+  MPI_Recv(reply, 2, MPI_INT, helper_rank_, kTagReply, comm_,
+           MPI_STATUS_IGNORE);
+  ranklist.resize(reply[1]);
+  MPI_Recv(ranklist.data(), reply[1], MPI_INT, helper_rank_, kTagReply, comm_,
+           MPI_STATUS_IGNORE);
+
+  pending_ = false;
+  return reply[0];
+}
+
+bool PlacementService::IsLeader() const {
+  int my_rank;
+  MPI_Comm_rank(comm_, &my_rank);
+  return my_rank == leader_rank_;
+}
+
+int PlacementService::Shutdown() {
+  if (pending_) {
+    std::vector<int> ranklist;
+    Wait(ranklist);
+  }
+
+  if (not IsLeader()) return 0;
+
+  int hdr[4] = {kRequestShutdown, 0, 0, 0};
+  MPI_Send(hdr, 4, MPI_INT, helper_rank_, kTagRequest, comm_);
+  return 0;
+}
+}  // namespace lb
+}  // namespace amr
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <mpi.h>
+
+#include <mutex>
+#include <vector>
+
+#include "assignment_cache.h"
+#include "lb_autotune.h"
+
+namespace amr {
+//
+// PolicyState: state that placement carries from one call to the next,
+// i.e. the assignment cache, the autotuner of the "auto" policy, and the
+// rank->node map of the node-hierarchical policies.
+//
+// Callers that place from several threads at once (e.g. policysim running
+// policies concurrently) give each stream of calls its own PolicyState, so
+// that streams neither race nor see each other's history. Calls made
+// without one share Shared(). Either way, cache and tuner are only
+// touched under mutex, which is never held while a policy runs.
+//
+// The state of the current call is installed per-thread via Scope, the
+// same way as the telemetry sink (see lb-common/telemetry.h).
+//
+class PolicyState {
+ public:
+  // cache and tuner params come from the config (lb_cache_*, lb_auto_*)
+  PolicyState();
+
+  PolicyState(const PolicyState& other) = delete;
+
+  PolicyState& operator=(const PolicyState& other) = delete;
+
+  class Scope {
+   public:
+    explicit Scope(PolicyState* state) : prev_(Current()) {
+      Current() = state;
+    }
+
+    ~Scope() { Current() = prev_; }
+
+   private:
+    PolicyState* const prev_;
+  };
+
+  static PolicyState*& Current() {
+    static thread_local PolicyState* state = nullptr;
+    return state;
+  }
+
+  // CurrentOrShared: the installed state, or the shared one
+  static PolicyState& CurrentOrShared() {
+    PolicyState* state = Current();
+    return state ? *state : Shared();
+  }
+
+  static PolicyState& Shared() {
+    static PolicyState state;
+    return state;
+  }
+
+  std::mutex mutex;  // guards cache, tuner, and the node map
+  AssignmentCache cache;
+  PolicyAutotuner tuner;
+
+  // rank->node map of node_map_comm (see PolicyUtils::ComputeNodeMap).
+  // Computing it is collective, so it is kept across calls; a freed comm
+  // whose handle is reused for another one is not detected
+  MPI_Comm node_map_comm = MPI_COMM_NULL;
+  std::vector<int> node_map;
+};
+}  // namespace amr
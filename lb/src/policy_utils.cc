@@ -12,8 +12,10 @@
 
 #include "tools-common/logging.h"
 #include "lb-common/constants.h"
+#include "lb-common/cost_extrapolator.h"
 #include "lb-common/policy.h"
 #include "lb-common/policy_wopts.h"
+#include "placement_eval.h"
 
 namespace amr {
 const std::map<std::string, LBPolicyWithOpts> PolicyUtils::kPolicyMap = {
@@ -42,13 +44,52 @@ const std::map<std::string, LBPolicyWithOpts> PolicyUtils::kPolicyMap = {
       .name = "CDP-I50",
       .policy = LoadBalancePolicy::kPolicyCppIter,
       .skip_cache = false,
-      .cdp_opts = {.niter_frac = 0, .niters = 50}}},
+      .cdp_opts = {.niter_frac = 0, .niters = 50, .deadline_ms = 0}}},
     {"cdpi250",
      {.id = "cdpi250",
       .name = "CDP-I250",
       .policy = LoadBalancePolicy::kPolicyCppIter,
       .skip_cache = false,
-      .cdp_opts = {.niter_frac = 0, .niters = 250}}},
+      .cdp_opts = {.niter_frac = 0, .niters = 250, .deadline_ms = 0}}},
+    {"nodecdp",
+     {.id = "nodecdp",
+      .name = "Node-Hierarchical CDP",
+      .policy = LoadBalancePolicy::kPolicyNodeHierarchical,
+      .skip_cache = false,
+      .node_opts = {.intra_policy = LoadBalancePolicy::kPolicyContigImproved}}},
+    {"nodelpt",
+     {.id = "nodelpt",
+      .name = "Node-Hierarchical LPT",
+      .policy = LoadBalancePolicy::kPolicyNodeHierarchical,
+      .skip_cache = false,
+      .node_opts = {.intra_policy = LoadBalancePolicy::kPolicyLPT}}},
+    {"auto",
+     {.id = "auto",
+      .name = "Auto",
+      .policy = LoadBalancePolicy::kPolicyAuto,
+      .skip_cache = false}},
+    {"robust",
+     {.id = "robust",
+      .name = "Robust CDP",
+      .policy = LoadBalancePolicy::kPolicyRobust,
+      .skip_cache = false,
+      .robust_opts = {.base_policy = LoadBalancePolicy::kPolicyContigImproved,
+                      .quantile = 0.9,
+                      .max_iters = 1000}}},
+    {"robustlpt",
+     {.id = "robustlpt",
+      .name = "Robust LPT",
+      .policy = LoadBalancePolicy::kPolicyRobust,
+      .skip_cache = false,
+      .robust_opts = {.base_policy = LoadBalancePolicy::kPolicyLPT,
+                      .quantile = 0.9,
+                      .max_iters = 1000}}},
+    {"bnb",
+     {.id = "bnb",
+      .name = "Branch-and-Bound",
+      .policy = LoadBalancePolicy::kPolicyBnB,
+      .skip_cache = true,
+      .bnb_opts = {.time_limit_ms = 5000, .rel_gap = 0}}},
 };
 
 const LBPolicyWithOpts PolicyUtils::GetPolicy(const char* policy_name) {
@@ -62,6 +103,11 @@ const LBPolicyWithOpts PolicyUtils::GetPolicy(const char* policy_name) {
     return GenCDPC(policy_str);
   }
 
+  if (policy_str.substr(0, 4) == "cdpi" and
+      kPolicyMap.find(policy_str) == kPolicyMap.end()) {
+    return GenCDPI(policy_str);
+  }
+
   if (kPolicyMap.find(policy_name) == kPolicyMap.end()) {
     std::stringstream msg;
     msg << "### FATAL ERROR in GetPolicy" << std::endl
@@ -117,6 +163,16 @@ std::string PolicyUtils::PolicyToString(LoadBalancePolicy policy) {
       return "HybridCppFirst";
     case LoadBalancePolicy::kPolicyHybridCppFirstV2:
       return "HybridCppFirstV2";
+    case LoadBalancePolicy::kPolicyCDPChunked:
+      return "CDPChunked";
+    case LoadBalancePolicy::kPolicyNodeHierarchical:
+      return "NodeHierarchical";
+    case LoadBalancePolicy::kPolicyAuto:
+      return "Auto";
+    case LoadBalancePolicy::kPolicyRobust:
+      return "Robust";
+    case LoadBalancePolicy::kPolicyBnB:
+      return "BnB";
     default:
       return "<undefined>";
   }
@@ -132,6 +188,8 @@ std::string PolicyUtils::PolicyToString(CostEstimationPolicy policy) {
       return "CachedExtrapolatedCost";
     case CostEstimationPolicy::kOracleCost:
       return "OracleCost";
+    case CostEstimationPolicy::kPredictedCost:
+      return "PredictedCost";
     default:
       return "<undefined>";
   }
@@ -145,97 +203,62 @@ std::string PolicyUtils::PolicyToString(TriggerPolicy policy) {
       return "EveryTimestep";
     case TriggerPolicy::kOnMeshChange:
       return "OnMeshChange";
+    case TriggerPolicy::kCostBenefit:
+      return "CostBenefit";
     default:
       return "<undefined>";
   }
 }
 
-void PolicyUtils::ExtrapolateCosts2D(std::vector<double> const& costs_prev,
-                                     std::vector<int>& refs,
-                                     std::vector<int>& derefs,
-                                     std::vector<double>& costs_cur) {
-  static bool first_time = true;
-  if (first_time) {
-    MLOG(MLOG_WARN, "ALERT: Using 2D extrapolation!");
-    first_time = false;
-  }
-
-  int nblocks_prev = costs_prev.size();
-  int nblocks_cur = nblocks_prev + (refs.size() * 3) - (derefs.size() * 3 / 4);
-
-  costs_cur.resize(0);
-  std::sort(refs.begin(), refs.end());
-  std::sort(derefs.begin(), derefs.end());
-
-  int ref_idx = 0;
-  int deref_idx = 0;
-  for (int bidx = 0; bidx < nblocks_prev;) {
-    if (ref_idx < refs.size() && refs[ref_idx] == bidx) {
-      for (int dim = 0; dim < 4; dim++) {
-        costs_cur.push_back(costs_prev[bidx]);
-      }
-      ref_idx++;
-      bidx++;
-    } else if (deref_idx < derefs.size() && derefs[deref_idx] == bidx) {
-      double cost_deref_avg = 0;
-      for (int dim = 0; dim < 4; dim++) {
-        cost_deref_avg += costs_prev[bidx + dim];
-      }
-      cost_deref_avg /= 4;
-      costs_cur.push_back(cost_deref_avg);
-      deref_idx += 4;
-      bidx += 4;
-    } else {
-      costs_cur.push_back(costs_prev[bidx]);
-      bidx++;
-    }
+void PolicyUtils::ExtrapolateCosts(int ndims,
+                                   std::vector<double> const& costs_prev,
+                                   std::vector<int> const& refs,
+                                   std::vector<int> const& derefs,
+                                   std::vector<double>& costs_cur) {
+  switch (ndims) {
+    case 1:
+      CostExtrapolator<1>::Extrapolate(costs_prev, refs, derefs, costs_cur);
+      break;
+    case 2:
+      CostExtrapolator<2>::Extrapolate(costs_prev, refs, derefs, costs_cur);
+      break;
+    case 3:
+      CostExtrapolator<3>::Extrapolate(costs_prev, refs, derefs, costs_cur);
+      break;
+    default:
+      ABORT("ExtrapolateCosts: ndims must be 1, 2 or 3");
   }
-
-  assert(costs_cur.size() == nblocks_cur);
 }
 
-void PolicyUtils::ExtrapolateCosts3D(std::vector<double> const& costs_prev,
-                                     std::vector<int>& refs,
-                                     std::vector<int>& derefs,
-                                     std::vector<double>& costs_cur) {
-  static bool first_time = true;
-  if (first_time) {
-    MLOG(MLOG_WARN, "ALERT: Using 3D extrapolation!");
-    first_time = false;
+int PolicyUtils::GetNumBlocksNext(int ndims, int nblocks,
+                                  std::vector<int> const& refs,
+                                  std::vector<int> const& derefs) {
+  switch (ndims) {
+    case 1:
+      return CostExtrapolator<1>::NumBlocksNext(nblocks, refs, derefs);
+    case 2:
+      return CostExtrapolator<2>::NumBlocksNext(nblocks, refs, derefs);
+    case 3:
+      return CostExtrapolator<3>::NumBlocksNext(nblocks, refs, derefs);
+    default:
+      ABORT("GetNumBlocksNext: ndims must be 1, 2 or 3");
   }
+  return -1;
+}
 
-  int nblocks_prev = costs_prev.size();
-  int nblocks_cur = nblocks_prev + (refs.size() * 7) - (derefs.size() * 7 / 8);
-
-  costs_cur.resize(0);
-  std::sort(refs.begin(), refs.end());
-  std::sort(derefs.begin(), derefs.end());
-
-  int ref_idx = 0;
-  int deref_idx = 0;
-  for (int bidx = 0; bidx < nblocks_prev;) {
-    if (ref_idx < refs.size() && refs[ref_idx] == bidx) {
-      for (int dim = 0; dim < 8; dim++) {
-        costs_cur.push_back(costs_prev[bidx]);
-      }
-      ref_idx++;
-      bidx++;
-    } else if (deref_idx < derefs.size() && derefs[deref_idx] == bidx) {
-      double cost_deref_avg = 0;
-      for (int dim = 0; dim < 8; dim++) {
-        cost_deref_avg += costs_prev[bidx + dim];
-      }
-      cost_deref_avg /= 8;
-      costs_cur.push_back(cost_deref_avg);
-      deref_idx += 8;
-      bidx += 8;
-    } else {
-      costs_cur.push_back(costs_prev[bidx]);
-      bidx++;
-    }
+int PolicyUtils::GetNumBlocksNext(int ndims, int nblocks, int nrefs,
+                                  int nderefs) {
+  switch (ndims) {
+    case 1:
+      return CostExtrapolator<1>::NumBlocksNext(nblocks, nrefs, nderefs);
+    case 2:
+      return CostExtrapolator<2>::NumBlocksNext(nblocks, nrefs, nderefs);
+    case 3:
+      return CostExtrapolator<3>::NumBlocksNext(nblocks, nrefs, nderefs);
+    default:
+      ABORT("GetNumBlocksNext: ndims must be 1, 2 or 3");
   }
-
-  assert(costs_cur.size() == nblocks_cur);
+  return -1;
 }
 
 void PolicyUtils::ComputePolicyCosts(int nranks,
@@ -253,11 +276,10 @@ void PolicyUtils::ComputePolicyCosts(int nranks,
     rank_times[block_rank] += cost_list[bid];
   }
 
-  int const& (*max_func)(int const&, int const&) = std::max<int>;
-  rank_time_max = std::accumulate(rank_times.begin(), rank_times.end(),
-                                  rank_times.front(), max_func);
-  uint64_t rtsum = std::accumulate(rank_times.begin(), rank_times.end(), 0ull);
-  rank_time_avg = rtsum * 1.0 / nranks;
+  // max and sum over doubles, integer accumulation truncated fractional costs
+  rank_time_max = *std::max_element(rank_times.begin(), rank_times.end());
+  double rtsum = std::accumulate(rank_times.begin(), rank_times.end(), 0.0);
+  rank_time_avg = rtsum / nranks;
 }
 
 //
@@ -294,6 +316,98 @@ double PolicyUtils::ComputeLocCost(std::vector<int> const& rank_list) {
   return norm_score;
 }
 
+//
+// Same costs as above, but node membership comes from node_map instead
+// of assuming kRanksPerNode sequentially packed ranks, and node
+// membership is checked first: neighboring ranks cost 1 only if they
+// share a node, and any off-node pair costs 3. The rank-only version
+// scores neighbors 1 even across a node boundary, so the two differ
+// even when node_map comes from GetNodeMap
+//
+double PolicyUtils::ComputeLocCost(std::vector<int> const& rank_list,
+                                   std::vector<int> const& node_map) {
+  int nb = rank_list.size();
+  int local_score = 0;
+
+  for (int bidx = 0; bidx < nb - 1; bidx++) {
+    int p = rank_list[bidx];
+    int q = rank_list[bidx + 1];
+
+    if (p == q) {
+      // nothing
+    } else if (node_map[p] != node_map[q]) {
+      local_score += 3;
+    } else if (abs(q - p) == 1) {
+      local_score += 1;
+    } else {
+      local_score += 2;
+    }
+  }
+
+  double norm_score = local_score * 1.0 / nb;
+  return norm_score;
+}
+
+void PolicyUtils::GetNodeMap(int nranks, std::vector<int>& node_map) {
+  node_map.resize(nranks);
+  for (int rank = 0; rank < nranks; rank++) {
+    node_map[rank] = rank / Constants::kRanksPerNode;
+  }
+}
+
+int PolicyUtils::ComputeNodeMap(MPI_Comm comm, std::vector<int>& node_map) {
+  int rv;
+  int my_rank, nranks;
+  MPI_Comm_rank(comm, &my_rank);
+  MPI_Comm_size(comm, &nranks);
+
+  MPI_Comm shm_comm;
+  rv = MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, my_rank, MPI_INFO_NULL,
+                           &shm_comm);
+  if (rv != MPI_SUCCESS) {
+    MLOG(MLOG_WARN, "MPI_Comm_split_type failed, rv: %d", rv);
+    return rv;
+  }
+
+  // the node leader is the lowest rank (in comm) on the node
+  int node_leader = my_rank;
+  rv = MPI_Allreduce(MPI_IN_PLACE, &node_leader, 1, MPI_INT, MPI_MIN,
+                     shm_comm);
+  MPI_Comm_free(&shm_comm);
+  if (rv != MPI_SUCCESS) {
+    MLOG(MLOG_WARN, "MPI_Allreduce failed, rv: %d", rv);
+    return rv;
+  }
+
+  std::vector<int> leaders(nranks, -1);
+  rv = MPI_Allgather(&node_leader, 1, MPI_INT, leaders.data(), 1, MPI_INT,
+                     comm);
+  if (rv != MPI_SUCCESS) {
+    MLOG(MLOG_WARN, "MPI_Allgather failed, rv: %d", rv);
+    return rv;
+  }
+
+  // leaders are visited in rank order, so node ids come out dense
+  // and ordered by the lowest rank on each node
+  std::vector<int> leader_to_node(nranks, -1);
+  int nnodes = 0;
+
+  node_map.resize(nranks);
+  for (int rank = 0; rank < nranks; rank++) {
+    int leader = leaders[rank];
+    if (leader_to_node[leader] == -1) {
+      leader_to_node[leader] = nnodes++;
+    }
+    node_map[rank] = leader_to_node[leader];
+  }
+
+  if (my_rank == 0) {
+    MLOG(MLOG_DBG0, "[NodeMap] %d ranks on %d nodes", nranks, nnodes);
+  }
+
+  return 0;
+}
+
 std::string PolicyUtils::GetLogPath(const char* output_dir,
                                     const char* policy_name,
                                     const char* suffix) {
@@ -311,57 +425,49 @@ void PolicyUtils::LogAssignmentStats(std::vector<double> const& costlist,
     return;
   }
 
-  int nblocks = costlist.size();
-  std::vector<double> rank_costs(nranks, 0.0);
-  std::vector<double> rank_counts(nranks, 0.0);
-
-  for (int bidx = 0; bidx < nblocks; bidx++) {
-    int rank = ranklist[bidx];
-    rank_costs[rank] += costlist[bidx];
-    rank_counts[rank] += 1.0;
-  }
+  lb::PlacementEval eval;
+  int rv = PlacementEvaluator::Evaluate(costlist, ranklist, nranks, eval);
+  if (rv) return;
 
-  // compute max, med, min of costs
-  std::sort(rank_costs.begin(), rank_costs.end());
-  double min_cost = rank_costs.front();
-  double max_cost = rank_costs.back();
-  double med_cost = rank_costs[nranks / 2];
-
-  // compute max, med, min of counts
-  std::sort(rank_counts.begin(), rank_counts.end());
-  double min_count = rank_counts.front();
-  double max_count = rank_counts.back();
-  double med_count = rank_counts[nranks / 2];
-
-  MLOG(MLOG_INFO, "Rank statistics (nblocks=%d):", nblocks);
-  MLOG(MLOG_INFO, "  Costs: min=%.0lf med=%.0lf max=%.0lf",
-       min_cost / 1e3, med_cost / 1e3, max_cost / 1e3);
-  MLOG(MLOG_INFO, "  Counts: min=%.0lf med=%.0lf max=%.0lf",
-       min_count, med_count, max_count);
+  MLOG(MLOG_INFO, "Rank statistics (nblocks=%d):", eval.nblocks);
+  MLOG(MLOG_INFO, "  Costs: min=%.0lf med=%.0lf p99=%.0lf max=%.0lf",
+       eval.load_min / 1e3, eval.load_p50 / 1e3, eval.load_p99 / 1e3,
+       eval.makespan / 1e3);
+  MLOG(MLOG_INFO, "  Counts: min=%d max=%d, imbalance: %.3lf, loc: %.3lf",
+       eval.nblocks_min, eval.nblocks_max, eval.imbalance, eval.loc_score);
 }
 
 const LBPolicyWithOpts PolicyUtils::GenHybrid(const std::string& policy_str) {
   // policy_name = hybridX, where X is to be parsed into lpt_frac
   // parse policy_name, throw error if not in the correct format
   //
-  std::regex re_oneparam("hybrid([0-9]+)");
-  std::regex re_twoparam("hybrid([0-9]+)alt([0-9]+)");
+  // Either form may carry a "dl<ms>" suffix for a wall-clock budget
+  std::regex re_oneparam("hybrid([0-9]+)(dl([0-9]+))?");
+  std::regex re_twoparam("hybrid([0-9]+)alt([0-9]+)(dl([0-9]+))?");
   std::smatch match;
 
   // HybridPolicy
-  PolicyOptsHybridCDPFirst hcf_opts = {
-      .v2 = true, .lpt_frac = 0.5, .alt_solncnt_max = 0};
+  PolicyOptsHybridCDPFirst hcf_opts = {.v2 = true,
+                                       .lpt_frac = 0.5,
+                                       .alt_solncnt_max = 0,
+                                       .deadline_ms = 0};
 
   if (std::regex_match(policy_str, match, re_oneparam)) {
     MLOG(MLOG_DBG0, "One param matched: %s", match.str(1).c_str());
 
     hcf_opts.lpt_frac = std::stoi(match.str(1)) / 100.0;
+    if (not match.str(3).empty()) {
+      hcf_opts.deadline_ms = std::stoi(match.str(3));
+    }
   } else if (std::regex_match(policy_str, match, re_twoparam)) {
     MLOG(MLOG_DBG0, "Two params matched: %s, %s",
          match.str(1).c_str(), match.str(2).c_str());
 
     hcf_opts.lpt_frac = std::stoi(match.str(1)) / 100.0;
     hcf_opts.alt_solncnt_max = std::stoi(match.str(2));
+    if (not match.str(4).empty()) {
+      hcf_opts.deadline_ms = std::stoi(match.str(4));
+    }
   } else {
     std::stringstream msg;
     msg << "### FATAL ERROR in GenHybrid" << std::endl
@@ -369,13 +475,8 @@ const LBPolicyWithOpts PolicyUtils::GenHybrid(const std::string& policy_str) {
     ABORT(msg.str().c_str());
   }
 
-  static bool first_time = true;
-  if (first_time) {
-    MLOG(MLOG_INFO,
-         "[LB] Using Hybrid policy with LPT frac: %.2lf%%",
-         hcf_opts.lpt_frac * 100);
-    first_time = false;
-  }
+  MLOG(MLOG_DBG0, "[LB] Using Hybrid policy with LPT frac: %.2lf%%",
+       hcf_opts.lpt_frac * 100);
 
   std::string policy_name_friendly =
       "Hybrid (" + std::to_string(hcf_opts.lpt_frac * 100) + "%)";
@@ -432,4 +533,38 @@ const LBPolicyWithOpts PolicyUtils::GenCDPC(const std::string& policy_str) {
   return policy;
 }
 
+const LBPolicyWithOpts PolicyUtils::GenCDPI(const std::string& policy_str) {
+  // policy name: cdpi(N)?(dlM)? - N: max iters, M: deadline in ms
+  // At least one of N or M must be present. cdpidlM iterates until the
+  // deadline (or convergence), cdpiNdlM stops at whichever comes first
+  std::regex re("cdpi([0-9]+)?(dl([0-9]+))?");
+  std::smatch match;
+
+  if (!std::regex_match(policy_str, match, re) or
+      (match.str(1).empty() and match.str(3).empty())) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in GenCDPI" << std::endl
+        << "Policy " << policy_str << " not in the correct format" << std::endl;
+    ABORT(msg.str().c_str());
+  }
+
+  PolicyOptsCDPI cdp_opts = {.niter_frac = 0, .niters = 0, .deadline_ms = 0};
+  if (not match.str(1).empty()) {
+    cdp_opts.niters = std::stoi(match.str(1));
+  }
+  if (not match.str(3).empty()) {
+    cdp_opts.deadline_ms = std::stoi(match.str(3));
+  }
+
+  LBPolicyWithOpts policy = {
+      .id = policy_str,
+      .name = "CDP-I (anytime)",
+      .policy = LoadBalancePolicy::kPolicyCppIter,
+      .skip_cache = false,
+      .cdp_opts = cdp_opts,
+  };
+
+  return policy;
+}
+
 }  // namespace amr
@@ -0,0 +1,79 @@
+//
+// PlacementService tests, run with mpirun -n 2 (or more)
+//
+
+#include <gtest/gtest.h>
+#include <mpi.h>
+
+#include "amr_lb.h"
+
+namespace amr {
+class PlacementServiceTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank_);
+    MPI_Comm_size(MPI_COMM_WORLD, &nmpiranks_);
+    helper_rank_ = nmpiranks_ - 1;
+  }
+
+  int my_rank_;
+  int nmpiranks_;
+  int helper_rank_;
+};
+
+TEST_F(PlacementServiceTest, OffloadTest) {
+  if (nmpiranks_ < 2) {
+    GTEST_SKIP() << "needs at least 2 MPI ranks";
+  }
+
+  MPI_Comm app_comm;
+  int rv = lb::PlacementService::SplitHelper(MPI_COMM_WORLD, helper_rank_,
+                                             &app_comm);
+  ASSERT_EQ(rv, 0);
+
+  lb::PlacementService service(MPI_COMM_WORLD, helper_rank_);
+
+  if (my_rank_ == helper_rank_) {
+    EXPECT_EQ(app_comm, MPI_COMM_NULL);
+    rv = service.Serve();
+    EXPECT_EQ(rv, 0);
+  } else {
+    int app_nranks;
+    MPI_Comm_size(app_comm, &app_nranks);
+    EXPECT_EQ(app_nranks, nmpiranks_ - 1);
+
+    std::vector<double> costlist = {1, 2, 3, 4, 1, 2, 10, 3};
+    int nranks = 3;
+
+    // blocking: same result as local placement
+    std::vector<int> ranklist_local, ranklist_remote;
+    lb::LoadBalance::AssignBlocks({"cdp", costlist, ranklist_local, nranks});
+    rv = service.AssignBlocks({"cdp", costlist, ranklist_remote, nranks});
+    EXPECT_EQ(rv, 0);
+    EXPECT_EQ(ranklist_remote, ranklist_local);
+
+    // split-phase
+    lb::LoadBalance::AssignBlocks({"lpt", costlist, ranklist_local, nranks});
+    rv = service.Post("lpt", costlist, nranks);
+    EXPECT_EQ(rv, 0);
+    EXPECT_NE(service.Post("lpt", costlist, nranks), 0);
+    rv = service.Wait(ranklist_remote);
+    EXPECT_EQ(rv, 0);
+    EXPECT_EQ(ranklist_remote, ranklist_local);
+    EXPECT_NE(service.Wait(ranklist_remote), 0);
+
+    service.Shutdown();
+    MPI_Comm_free(&app_comm);
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+}
+}  // namespace amr
+
+int main(int argc, char** argv) {
+  MPI_Init(&argc, &argv);
+  ::testing::InitGoogleTest(&argc, argv);
+  int rv = RUN_ALL_TESTS();
+  MPI_Finalize();
+  return rv;
+}
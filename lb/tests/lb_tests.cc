@@ -4,7 +4,12 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
+#include "amr_lb.h"
 #include "lb-common/lb_policies.h"
+#include "lb-common/lower_bound.h"
+#include "lb-common/telemetry.h"
 #include "tools-common/common.h"
 #include "tools-common/logging.h"
 
@@ -102,4 +107,213 @@ TEST_F(LoadBalancingPoliciesTest, CDPTest1) {
   AssignBlocksContigImproved(costlist, ranklist, nranks);
   AssignBlocksContigImproved2(costlist, ranklist, nranks);
 }
+
+TEST_F(LoadBalancingPoliciesTest, TelemetryTest) {
+  std::vector<double> costlist = {1, 2, 3, 4, 1, 2, 10};
+  std::vector<int> ranklist;
+  lb::PlacementTelemetry telemetry;
+
+  lb::PlacementArgs args{"cdp", costlist, ranklist, 3, &telemetry};
+  int rv = lb::LoadBalance::AssignBlocks(args);
+  ASSERT_EQ(rv, 0);
+
+  // the greedy pass meets the contiguous bound here, so CDP skips its DP
+  ASSERT_EQ(telemetry.policy, "cdp");
+  ASSERT_EQ(telemetry.phase_ms.count("greedy"), 1);
+  ASSERT_EQ(telemetry.phase_ms.count("dp"), 0);
+  ASSERT_GE(telemetry.total_ms, 0);
+  ASSERT_EQ(telemetry.eval.nblocks, costlist.size());
+
+  // iterative policies report iterations, and the struct is reset per call
+  args.policy_name = "cdpi50";
+  rv = lb::LoadBalance::AssignBlocks(args);
+  ASSERT_EQ(rv, 0);
+  ASSERT_EQ(telemetry.policy, "cdpi50");
+  ASSERT_EQ(telemetry.phase_ms.count("iterate"), 1);
+  ASSERT_LE(telemetry.niters, 50);
+
+  lb::PlacementEval eval;
+  lb::LoadBalance::EvaluatePlacement(costlist, ranklist, 3, eval);
+  ASSERT_DOUBLE_EQ(telemetry.eval.makespan, eval.makespan);
+
+  // the iterations actually run are recorded, not the cap
+  std::vector<double> costlist_long(100);
+  for (int bidx = 0; bidx < costlist_long.size(); bidx++) {
+    costlist_long[bidx] = 1 + (bidx * 37) % 11;
+  }
+  std::vector<int> ranklist_long;
+  rv = lb::LoadBalance::AssignBlocks(
+      {"cdpi50", costlist_long, ranklist_long, 8, &telemetry});
+  ASSERT_EQ(rv, 0);
+  ASSERT_GT(telemetry.niters, 0);
+  ASSERT_LT(telemetry.niters, 50);
+
+  // no sink installed: nothing is recorded, not even into the sink of
+  // an earlier call
+  telemetry = lb::PlacementTelemetry();
+  args.telemetry = nullptr;
+  rv = lb::LoadBalance::AssignBlocks(args);
+  ASSERT_EQ(rv, 0);
+  ASSERT_FALSE(Telemetry::Enabled());
+  ASSERT_TRUE(telemetry.policy.empty());
+  ASSERT_TRUE(telemetry.phase_ms.empty());
+  ASSERT_EQ(telemetry.total_ms, 0);
+  ASSERT_EQ(telemetry.niters, 0);
+  ASSERT_EQ(telemetry.mem_hwm_bytes, 0);
+  ASSERT_EQ(telemetry.eval.nblocks, 0);
+}
+
+TEST_F(LoadBalancingPoliciesTest, CDPGreedyTest) {
+  lb::PlacementTelemetry telemetry;
+
+  // no contiguous placement meets the bound, so CDP falls back to its DP
+  std::vector<double> costlist = {4, 4, 4, 4, 4, 4, 4};
+  std::vector<int> ranklist;
+  int rv = lb::LoadBalance::AssignBlocks({"cdp", costlist, ranklist, 3,
+                                          &telemetry});
+  ASSERT_EQ(rv, 0);
+  ASSERT_EQ(telemetry.phase_ms.count("greedy"), 1);
+  ASSERT_EQ(telemetry.phase_ms.count("dp"), 1);
+  ASSERT_EQ(telemetry.phase_ms.count("backtrack"), 1);
+  ASSERT_GT(telemetry.mem_hwm_bytes, 0);
+  ASSERT_DOUBLE_EQ(telemetry.eval.makespan, 12);
+
+  // a greedy placement need not be the DP's, but it stays within
+  // ContiguousFixedSize * (1 + eps) and keeps blocks in rank order
+  double eps = LowerBound::Epsilon();
+  int ngreedy = 0;
+  for (int nranks : {3, 5, 7, 12}) {
+    for (int seed = 0; seed < 16; seed++) {
+      std::vector<double> costlist(nranks * 5 + 1 + seed % nranks);
+      for (int bidx = 0; bidx < costlist.size(); bidx++) {
+        costlist[bidx] = 1 + (bidx * 31 + seed * 17) % 13;
+      }
+
+      std::vector<int> ranklist;
+      rv = lb::LoadBalance::AssignBlocks({"cdp", costlist, ranklist, nranks,
+                                          &telemetry});
+      ASSERT_EQ(rv, 0);
+      ASSERT_TRUE(std::is_sorted(ranklist.begin(), ranklist.end()));
+
+      double lb = LowerBound::ContiguousFixedSize(costlist, nranks);
+      ASSERT_GE(telemetry.eval.makespan, lb - 1e-9);
+      if (telemetry.phase_ms.count("greedy") &&
+          !telemetry.phase_ms.count("dp")) {
+        ASSERT_LE(telemetry.eval.makespan, lb * (1 + eps) + 1e-9);
+        ngreedy++;
+      }
+    }
+  }
+  ASSERT_GT(ngreedy, 0);
+}
+
+TEST_F(LoadBalancingPoliciesTest, ResizeTest) {
+  std::vector<double> costlist(64);
+  for (int bidx = 0; bidx < costlist.size(); bidx++) {
+    costlist[bidx] = 1 + (bidx * 7) % 5;
+  }
+
+  auto count_moved = [](std::vector<int> const& a, std::vector<int> const& b) {
+    int nmoved = 0;
+    for (int bidx = 0; bidx < a.size(); bidx++) nmoved += (a[bidx] != b[bidx]);
+    return nmoved;
+  };
+
+  for (std::string policy : {"cdp", "lpt"}) {
+    std::vector<int> ranklist_old, ranklist_scratch, ranklist;
+    int rv = lb::LoadBalance::AssignBlocks(
+        {policy, costlist, ranklist_old, 8});
+    ASSERT_EQ(rv, 0);
+
+    // shrink 8 -> 6: ranks 6 and 7 are gone
+    rv = lb::LoadBalance::AssignBlocks({policy, costlist, ranklist_scratch, 6});
+    ASSERT_EQ(rv, 0);
+
+    lb::ResizeArgs args{policy, costlist, ranklist_old, 8, ranklist, 6};
+    rv = lb::LoadBalance::AssignBlocksResize(args);
+    ASSERT_EQ(rv, 0);
+    ASSERT_EQ(ranklist.size(), costlist.size());
+    ASSERT_EQ(args.nblocks_moved, count_moved(ranklist_old, ranklist));
+    EXPECT_LE(args.nblocks_moved, count_moved(ranklist_old, ranklist_scratch));
+    if (policy == "cdp") {
+      // range boundaries shift to keep blocks in place, in rank order
+      EXPECT_LT(args.nblocks_moved,
+                count_moved(ranklist_old, ranklist_scratch));
+      EXPECT_TRUE(std::is_sorted(ranklist.begin(), ranklist.end()));
+    }
+
+    lb::PlacementEval eval, eval_scratch;
+    lb::LoadBalance::EvaluatePlacement(costlist, ranklist, 6, eval);
+    lb::LoadBalance::EvaluatePlacement(costlist, ranklist_scratch, 6,
+                                       eval_scratch);
+    EXPECT_LE(eval.makespan, eval_scratch.makespan * 1.021);
+    EXPECT_GT(eval.nblocks_min, 0);
+
+    // grow 6 -> 8, with an explicit map that renumbers the old ranks
+    std::vector<int> rank_map = {2, 3, 4, 5, 6, 7};
+    std::vector<int> ranklist_grown;
+    lb::ResizeArgs args_grow{policy, costlist, ranklist,       6,
+                             ranklist_grown, 8,  &rank_map};
+    rv = lb::LoadBalance::AssignBlocksResize(args_grow);
+    ASSERT_EQ(rv, 0);
+    if (policy == "cdp") {
+      // contiguous placements stay in rank order
+      EXPECT_TRUE(std::is_sorted(ranklist_grown.begin(), ranklist_grown.end()));
+    } else {
+      EXPECT_LT(args_grow.nblocks_moved, costlist.size() / 2);
+    }
+
+    // rank_map with duplicate or out-of-range targets is rejected
+    rank_map = {2, 3, 4, 5, 6, 2};
+    rv = lb::LoadBalance::AssignBlocksResize(args_grow);
+    EXPECT_NE(rv, 0);
+    rank_map = {2, 3, 4, 5, 6, -2};
+    rv = lb::LoadBalance::AssignBlocksResize(args_grow);
+    EXPECT_NE(rv, 0);
+
+    // rank_map of the wrong size is rejected
+    rank_map = {2, 3, 4, 5, 6};
+    rv = lb::LoadBalance::AssignBlocksResize(args_grow);
+    EXPECT_NE(rv, 0);
+  }
+}
+
+TEST_F(LoadBalancingPoliciesTest, LBTriggerTest) {
+  std::vector<double> costlist(64, 1.0);
+  std::vector<int> ranklist(64);
+  for (int bidx = 0; bidx < 64; bidx++) {
+    ranklist[bidx] = bidx / 8;
+  }
+
+  lb::LBTrigger trigger;
+
+  // balanced: nothing to gain
+  EXPECT_FALSE(trigger.ShouldTrigger(costlist, ranklist, 8));
+
+  // one rank 4x as loaded as the rest
+  std::vector<double> costlist_skewed = costlist;
+  for (int bidx = 0; bidx < 8; bidx++) {
+    costlist_skewed[bidx] = 4.0;
+  }
+  EXPECT_TRUE(trigger.ShouldTrigger(costlist_skewed, ranklist, 8));
+  EXPECT_GT(trigger.LastGain(), trigger.LastCost());
+
+  // blocks without a rank must always be placed
+  std::vector<int> ranklist_short(ranklist.begin(), ranklist.end() - 1);
+  EXPECT_TRUE(trigger.ShouldTrigger(costlist, ranklist_short, 8));
+
+  // no placement cost observed yet: even a mild imbalance is worth fixing
+  std::vector<double> costlist_mild = costlist;
+  costlist_mild[0] = 2.0;
+  EXPECT_TRUE(trigger.ShouldTrigger(costlist_mild, ranklist, 8));
+
+  // placement is expensive: a mild imbalance is no longer worth fixing
+  trigger.RecordPlacement(costlist, ranklist, 8, 1000.0, 0);
+  EXPECT_FALSE(trigger.ShouldTrigger(costlist_mild, ranklist, 8));
+  EXPECT_DOUBLE_EQ(trigger.LastCost(), 1000.0);
+
+  // after a reset, the expensive placement is forgotten
+  trigger.Reset();
+  EXPECT_TRUE(trigger.ShouldTrigger(costlist_mild, ranklist, 8));
+}
 } // namespace amr
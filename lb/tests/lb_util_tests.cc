@@ -2,6 +2,16 @@
 #include <gtest/gtest.h>
 
 #include "assignment_cache.h"
+#include "lb_autotune.h"
+#include "lb-common/lb_policies.h"
+#include "lb-common/lower_bound.h"
+#include "lb-common/policy_utils.h"
+#include "lb-common/solver.h"
+#include "placement_eval.h"
+#include "policy_state.h"
+
+#include <random>
+#include <thread>
 
 namespace amr {
 class LBUtilTest : public ::testing::Test {};
@@ -19,21 +29,301 @@ TEST_F(LBUtilTest, AssignmentCacheTest) {
   std::vector<int> ranklist;
   bool rv;
 
-  cache.Put(3, {1, 2, 3});
-  rv = cache.Get(3, ranklist);
+  cache.Put("lpt", 3, {1, 1, 1}, {0, 1, 2});
+  rv = cache.Get("lpt", 3, {1, 1, 1}, ranklist);
   ASSERT_TRUE(rv);
-  AssertVectorEqual(ranklist, {1, 2, 3});
+  AssertVectorEqual(ranklist, {0, 1, 2});
 
-  cache.Put(4, {1, 2, 3, 4});
-  rv = cache.Get(4, ranklist);
+  cache.Put("lpt", 4, {1, 1, 1, 1}, {0, 1, 2, 3});
+  rv = cache.Get("lpt", 4, {1, 1, 1, 1}, ranklist);
   ASSERT_TRUE(rv);
 
-  cache.Put(5, {1, 2, 3, 4, 5});
-  rv = cache.Get(5, ranklist);
-  rv = cache.Get(3, ranklist);
+  cache.Put("lpt", 5, {1, 1, 1, 1, 1}, {0, 1, 2, 3, 4});
+  rv = cache.Get("lpt", 5, {1, 1, 1, 1, 1}, ranklist);
+  rv = cache.Get("lpt", 3, {1, 1, 1}, ranklist);
   ASSERT_TRUE(rv);
 
-  rv = cache.Get(3, ranklist);
+  rv = cache.Get("lpt", 3, {1, 1, 1}, ranklist);
   ASSERT_FALSE(rv);
 }
+
+TEST_F(LBUtilTest, AssignmentCacheKeyTest) {
+  AssignmentCache cache(8);
+
+  std::vector<int> ranklist;
+
+  cache.Put("cdp", 2, {1, 2, 3, 4}, {0, 0, 1, 1});
+  // different policy, nranks or costs must miss
+  ASSERT_FALSE(cache.Get("lpt", 2, {1, 2, 3, 4}, ranklist));
+  ASSERT_FALSE(cache.Get("cdp", 4, {1, 2, 3, 4}, ranklist));
+  ASSERT_FALSE(cache.Get("cdp", 2, {1, 2, 3, 5}, ranklist));
+  ASSERT_TRUE(cache.Get("cdp", 2, {1, 2, 3, 4}, ranklist));
+  AssertVectorEqual(ranklist, {0, 0, 1, 1});
+}
+
+TEST_F(LBUtilTest, AssignmentCacheToleranceTest) {
+  // quantum of 10% of the mean cost, tolerate up to 2% regression
+  AssignmentCache cache(8, 0.02, 0.1);
+
+  std::vector<int> ranklist;
+
+  cache.Put("cdp", 2, {10, 10, 10, 10}, {0, 0, 1, 1});
+  // small perturbation, same quantized fingerprint, small regression
+  ASSERT_TRUE(cache.Get("cdp", 2, {10.1, 10, 10, 10}, ranklist));
+  AssertVectorEqual(ranklist, {0, 0, 1, 1});
+
+  // a uniform change in cost keeps the imbalance, and is a hit
+  ASSERT_EQ(AssignmentCache::Fingerprint({10, 10, 10, 10}, 0.1),
+            AssignmentCache::Fingerprint({10.4, 10.4, 10.4, 10.4}, 0.1));
+  ASSERT_TRUE(cache.Get("cdp", 2, {10.4, 10.4, 10.4, 10.4}, ranklist));
+  ASSERT_TRUE(cache.Get("cdp", 2, {9, 9, 9, 9}, ranklist));
+
+  // same fingerprint, but imbalance regresses by 4%, even though the
+  // makespan drops with the overall cost
+  ASSERT_EQ(AssignmentCache::Fingerprint({10, 10, 10, 10}, 0.1),
+            AssignmentCache::Fingerprint({9.36, 9.36, 8.64, 8.64}, 0.1));
+  ASSERT_FALSE(cache.Get("cdp", 2, {9.36, 9.36, 8.64, 8.64}, ranklist));
+  ASSERT_FALSE(cache.Get("cdp", 2, {10.4, 10.4, 9.6, 9.6}, ranklist));
+
+  ASSERT_EQ(AssignmentCache::Fingerprint({10, 10}, 0.1),
+            AssignmentCache::Fingerprint({10.2, 9.9}, 0.1));
+  ASSERT_NE(AssignmentCache::Fingerprint({10, 10}, 0),
+            AssignmentCache::Fingerprint({10.2, 9.9}, 0));
+}
+
+TEST_F(LBUtilTest, AutotuneFeaturesTest) {
+  auto f = PolicyAutotuner::ComputeFeatures({1, 1, 1, 1, 1, 1, 1, 1}, 2);
+  ASSERT_EQ(f.bpr_bucket, 2);
+  ASSERT_EQ(f.skew_bucket, 0);
+  ASSERT_DOUBLE_EQ(f.cost_avg, 1.0);
+
+  f = PolicyAutotuner::ComputeFeatures({1, 9, 1, 9}, 4);
+  ASSERT_EQ(f.bpr_bucket, 0);
+  ASSERT_EQ(f.skew_bucket, 3);
+}
+
+TEST_F(LBUtilTest, AutotuneChooseTest) {
+  // no periodic exploration, solve time counted 1:1 with cost units
+  PolicyAutotuner tuner({"lpt", "cdp", "cdpc512"}, 1.0, 0, 0);
+  auto f = PolicyAutotuner::ComputeFeatures(std::vector<double>(64, 10), 8);
+
+  // cdpc512 is ineligible for 8 ranks, others are tried in order
+  ASSERT_EQ(tuner.Choose(f), 0);
+  tuner.Update(f, 0, 90, 80, 5);
+  ASSERT_EQ(tuner.Choose(f), 1);
+  tuner.Update(f, 1, 100, 80, 1);
+
+  // expected: lpt 90 + 5, cdp 100 + 1
+  ASSERT_EQ(tuner.Choose(f), 0);
+  ASSERT_EQ(tuner.GetStats(f, 0).ntrials, 1);
+  ASSERT_EQ(tuner.GetStats(f, 2).ntrials, 0);
+}
+
+TEST_F(LBUtilTest, AutotuneBudgetTest) {
+  // lpt is better, but exceeds a 2ms budget once observed
+  PolicyAutotuner tuner({"lpt", "cdp"}, 1.0, 2.0, 0);
+  auto f = PolicyAutotuner::ComputeFeatures(std::vector<double>(64, 10), 8);
+
+  tuner.Update(f, tuner.Choose(f), 80, 80, 5);
+  tuner.Update(f, tuner.Choose(f), 100, 80, 1);
+  ASSERT_EQ(tuner.Choose(f), 1);
+}
+
+TEST_F(LBUtilTest, EvaluatePlacementTest) {
+  std::vector<double> costlist = {0.5, 1.5, 2.25, 0.75};
+  std::vector<int> ranklist = {0, 0, 1, 2};
+  lb::PlacementEval eval;
+
+  int rv = lb::LoadBalance::EvaluatePlacement(costlist, ranklist, 3, eval);
+  ASSERT_EQ(rv, 0);
+  ASSERT_DOUBLE_EQ(eval.makespan, 2.25);
+  ASSERT_DOUBLE_EQ(eval.load_min, 0.75);
+  ASSERT_DOUBLE_EQ(eval.load_avg, 5.0 / 3);
+  ASSERT_DOUBLE_EQ(eval.load_p50, 2.0);
+  ASSERT_EQ(eval.nblocks_min, 1);
+  ASSERT_EQ(eval.nblocks_max, 2);
+  ASSERT_DOUBLE_EQ(eval.loc_score, PolicyUtils::ComputeLocCost(ranklist));
+
+  // ComputePolicyCosts must not truncate fractional costs
+  std::vector<double> rank_times;
+  double avg, max;
+  PolicyUtils::ComputePolicyCosts(3, costlist, ranklist, rank_times, avg, max);
+  ASSERT_DOUBLE_EQ(max, eval.makespan);
+  ASSERT_DOUBLE_EQ(avg, eval.load_avg);
+
+  ranklist[3] = 3;
+  rv = lb::LoadBalance::EvaluatePlacement(costlist, ranklist, 3, eval);
+  ASSERT_EQ(rv, -1);
+
+  // no blocks: every rank is idle
+  costlist.clear();
+  ranklist.clear();
+  rv = lb::LoadBalance::EvaluatePlacement(costlist, ranklist, 3, eval);
+  ASSERT_EQ(rv, 0);
+  ASSERT_EQ(eval.nblocks, 0);
+  ASSERT_DOUBLE_EQ(eval.makespan, 0);
+  ASSERT_DOUBLE_EQ(eval.loc_score, 0);
+  ASSERT_DOUBLE_EQ(eval.imbalance, 1.0);
+}
+
+TEST_F(LBUtilTest, EvaluatePlacementThreadedTest) {
+  int nblocks = PlacementEvaluator::kMinBlocksPerThread * 4 + 7;
+  int nranks = 512;
+
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> cost_dist(1.0, 100.0);
+  std::uniform_int_distribution<int> rank_dist(0, nranks - 1);
+
+  std::vector<double> costlist(nblocks);
+  std::vector<int> ranklist(nblocks);
+  for (int bidx = 0; bidx < nblocks; bidx++) {
+    costlist[bidx] = cost_dist(gen);
+    ranklist[bidx] = rank_dist(gen);
+  }
+
+  lb::PlacementEval eval1, eval4;
+  ASSERT_EQ(PlacementEvaluator::Evaluate(costlist, ranklist, nranks, eval1, 1),
+            0);
+  ASSERT_EQ(PlacementEvaluator::Evaluate(costlist, ranklist, nranks, eval4, 4),
+            0);
+
+  ASSERT_NEAR(eval1.makespan, eval4.makespan, 1e-6);
+  ASSERT_NEAR(eval1.load_avg, eval4.load_avg, 1e-6);
+  ASSERT_NEAR(eval1.load_p90, eval4.load_p90, 1e-6);
+  ASSERT_EQ(eval1.nblocks_max, eval4.nblocks_max);
+  ASSERT_DOUBLE_EQ(eval1.loc_score, eval4.loc_score);
+  ASSERT_DOUBLE_EQ(eval1.loc_score, PolicyUtils::ComputeLocCost(ranklist));
+}
+
+TEST_F(LBUtilTest, LowerBoundTest) {
+  // three blocks on two ranks: one rank must take two
+  std::vector<double> costlist = {5, 5, 5};
+  EXPECT_DOUBLE_EQ(LowerBound::Simple(costlist, 2), 7.5);
+  EXPECT_DOUBLE_EQ(LowerBound::Any(costlist, 2), 10);
+
+  // with runs of 2, whichever run holds a 10 also holds a 1 or a 10
+  costlist = {1, 1, 10, 10, 1, 1};
+  EXPECT_DOUBLE_EQ(LowerBound::Simple(costlist, 3), 10);
+  EXPECT_DOUBLE_EQ(LowerBound::ContiguousFixedSize(costlist, 3), 11);
+
+  EXPECT_TRUE(LowerBound::Within(10.001, 10, 0.001));
+  EXPECT_FALSE(LowerBound::Within(10.02, 10, 0.001));
+
+  // bounds hold for real placements
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> dist(1, 100);
+  costlist.resize(203);
+  for (auto& c : costlist) c = dist(rng);
+
+  for (int nranks : {7, 16, 50}) {
+    std::vector<int> ranklist;
+    lb::PlacementEval eval;
+    for (const char* policy : {"lpt", "cdp"}) {
+      int rv = LoadBalancePolicies::AssignBlocksCached(policy, costlist,
+                                                       ranklist, nranks);
+      ASSERT_EQ(rv, 0);
+      PlacementEvaluator::Evaluate(costlist, ranklist, nranks, eval);
+      EXPECT_GE(eval.makespan, LowerBound::Any(costlist, nranks) - 1e-9);
+    }
+    // cdp was last. Its fixed-size runs are only used if blocks do not
+    // divide evenly
+    if (costlist.size() % nranks != 0) {
+      EXPECT_GE(eval.makespan,
+                LowerBound::ContiguousFixedSize(costlist, nranks) - 1e-9);
+    }
+  }
+}
+
+TEST_F(LBUtilTest, PolicyStateTest) {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> dist(1, 100);
+  std::vector<std::vector<double>> costlists(8, std::vector<double>(256));
+  for (auto& costlist : costlists) {
+    for (auto& c : costlist) c = dist(rng);
+  }
+
+  const int nranks = 16;
+  std::vector<const char*> policies = {"lpt", "cdp", "hybrid25"};
+
+  // reference placements, one call at a time
+  std::vector<std::vector<int>> expected;
+  {
+    PolicyState state;
+    for (auto const& costlist : costlists) {
+      for (auto policy : policies) {
+        std::vector<int> ranklist;
+        ASSERT_EQ(LoadBalancePolicies::AssignBlocksCached(
+                      policy, costlist, ranklist, nranks, 0, MPI_COMM_NULL,
+                      nullptr, &state),
+                  0);
+        expected.push_back(ranklist);
+      }
+    }
+  }
+
+  // the same calls from several threads at once, each with its own state,
+  // plus "auto" on the shared state
+  const int nthreads = 4;
+  std::vector<std::vector<std::vector<int>>> actual(nthreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < nthreads; t++) {
+    threads.emplace_back([&, t]() {
+      PolicyState state;
+      for (auto const& costlist : costlists) {
+        for (auto policy : policies) {
+          std::vector<int> ranklist;
+          LoadBalancePolicies::AssignBlocksCached(policy, costlist, ranklist,
+                                                  nranks, 0, MPI_COMM_NULL,
+                                                  nullptr, &state);
+          actual[t].push_back(ranklist);
+        }
+
+        std::vector<int> ranklist;
+        LoadBalancePolicies::AssignBlocksCached("auto", costlist, ranklist,
+                                                nranks);
+      }
+    });
+  }
+
+  for (auto& thread : threads) thread.join();
+  for (auto const& ranklists : actual) {
+    ASSERT_EQ(ranklists, expected);
+  }
+
+  // states do not share cache entries
+  PolicyState state_a, state_b;
+  lb::PlacementTelemetry telemetry;
+  std::vector<int> ranklist;
+  LoadBalancePolicies::AssignBlocksCached("lpt", costlists[0], ranklist,
+                                          nranks, 0, MPI_COMM_NULL,
+                                          &telemetry, &state_a);
+  LoadBalancePolicies::AssignBlocksCached("lpt", costlists[0], ranklist,
+                                          nranks, 0, MPI_COMM_NULL,
+                                          &telemetry, &state_a);
+  EXPECT_TRUE(telemetry.cache_hit);
+  LoadBalancePolicies::AssignBlocksCached("lpt", costlists[0], ranklist,
+                                          nranks, 0, MPI_COMM_NULL,
+                                          &telemetry, &state_b);
+  EXPECT_FALSE(telemetry.cache_hit);
+}
+
+TEST_F(LBUtilTest, SolverEarlyExitTest) {
+  // a perfectly balanced input: no iterations needed
+  std::vector<double> costlist(64, 1.0);
+  std::vector<int> ranklist(64);
+  for (int bidx = 0; bidx < 64; bidx++) {
+    ranklist[bidx] = bidx / 8;
+  }
+
+  SolverStats stats;
+  Deadline no_deadline(0);
+  Solver().AssignBlocksAnytime(costlist, ranklist, 8, 250, no_deadline,
+                               stats);
+  EXPECT_TRUE(stats.bound_hit);
+  EXPECT_EQ(stats.niters, 0);
+
+  // the fixed-iteration path returns the iterations it ran, not the cap
+  EXPECT_EQ(Solver().AssignBlocks(costlist, ranklist, 8, 250), 0);
+}
+
 }  // namespace amr
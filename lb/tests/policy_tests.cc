@@ -4,9 +4,12 @@
 
 #include "tools-common/logging.h"
 #include "lb-common/lb_policies.h"
+#include "lb-common/policy_utils.h"
+#include "lb-common/policy_wopts.h"
 #include "lb-common/solver.h"
 
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <vector>
 
 namespace amr {
@@ -30,6 +33,42 @@ class PolicyTest : public ::testing::Test {
                                                            nranks);
   }
 
+  static int AssignBlocksNodeHierarchical(std::vector<double> const& costlist,
+                                          std::vector<int>& ranklist,
+                                          int nranks,
+                                          PolicyOptsNodeHier const& opts,
+                                          std::vector<int> const& node_map) {
+    return LoadBalancePolicies::AssignBlocksNodeHierarchical(
+        costlist, ranklist, nranks, opts, node_map);
+  }
+
+  static int AssignBlocksRobust(std::vector<double> const& cost_means,
+                                std::vector<double> const& cost_vars,
+                                std::vector<int>& ranklist, int nranks,
+                                PolicyOptsRobust const& opts) {
+    return LoadBalancePolicies::AssignBlocksRobust(cost_means, cost_vars,
+                                                   ranklist, nranks, opts);
+  }
+
+  // ExhaustiveMakespan: optimal makespan, by trying every placement
+  static double ExhaustiveMakespan(std::vector<double> const& costlist,
+                                   int nranks) {
+    int nblocks = costlist.size();
+    int ncombos = 1;
+    for (int bidx = 0; bidx < nblocks; bidx++) ncombos *= nranks;
+
+    double opt = 1e30;
+    for (int combo = 0; combo < ncombos; combo++) {
+      std::vector<double> loads(nranks, 0);
+      for (int bidx = 0, c = combo; bidx < nblocks; bidx++, c /= nranks) {
+        loads[c % nranks] += costlist[bidx];
+      }
+      opt = std::min(opt, *std::max_element(loads.begin(), loads.end()));
+    }
+
+    return opt;
+  }
+
   testing::AssertionResult AssertAllRanksAssigned(
       std::vector<int> const& ranklist, int nranks) {
     std::vector<int> allocs(nranks, 0);
@@ -193,4 +232,252 @@ TEST_F(PolicyTest, IterTest3) {
   MLOG(MLOG_DBG0, "IterativeSolver. Avg Cost: %.0lf, Max Cost: %.0lf\n",
        avg_cost, max_cost);
 }
+
+TEST_F(PolicyTest, NodeHierTest1) {
+#include "lb_test1.h"
+  int nranks = 512;
+  std::vector<int> ranklist(costlist.size(), -1);
+
+  // interleaved node map: rank r lives on node r % nnodes
+  int nnodes = nranks / 16;
+  std::vector<int> node_map(nranks);
+  for (int rank = 0; rank < nranks; rank++) {
+    node_map[rank] = rank % nnodes;
+  }
+
+  PolicyOptsNodeHier opts{LoadBalancePolicy::kPolicyContigImproved};
+  int rv = AssignBlocksNodeHierarchical(costlist, ranklist, nranks, opts,
+                                        node_map);
+  ASSERT_EQ(rv, 0);
+
+  EXPECT_TRUE(AssertAllRanksAssigned(ranklist, nranks));
+
+  // each node must own exactly one contiguous range of blocks
+  std::vector<int> node_seen(nnodes, 0);
+  for (int bidx = 0; bidx < ranklist.size(); bidx++) {
+    int node = node_map[ranklist[bidx]];
+    if (bidx == 0 or node != node_map[ranklist[bidx - 1]]) {
+      node_seen[node]++;
+    }
+  }
+
+  for (int node = 0; node < nnodes; node++) {
+    EXPECT_EQ(node_seen[node], 1);
+  }
+
+  // node-aware placement should beat plain CDP on this node map
+  std::vector<int> ranklist_cdp(costlist.size(), -1);
+  rv = AssignBlocksContigImproved(costlist, ranklist_cdp, nranks);
+  ASSERT_EQ(rv, 0);
+
+  double loc_node = PolicyUtils::ComputeLocCost(ranklist, node_map);
+  double loc_cdp = PolicyUtils::ComputeLocCost(ranklist_cdp, node_map);
+  MLOG(MLOG_INFO, "Loc cost, node-hier: %.3lf, cdp: %.3lf", loc_node, loc_cdp);
+  EXPECT_LT(loc_node, loc_cdp);
+
+  // ... at nearly the same makespan: node ranges are cut greedily, so
+  // node-hier can trail CDP slightly
+  std::vector<double> rank_times;
+  double avg_node, max_node, avg_cdp, max_cdp;
+  PolicyUtils::ComputePolicyCosts(nranks, costlist, ranklist, rank_times,
+                                  avg_node, max_node);
+  PolicyUtils::ComputePolicyCosts(nranks, costlist, ranklist_cdp, rank_times,
+                                  avg_cdp, max_cdp);
+  MLOG(MLOG_INFO, "Makespan, node-hier: %.3lf, cdp: %.3lf", max_node, max_cdp);
+  EXPECT_LE(max_node, max_cdp * 1.02);
+}
+
+TEST_F(PolicyTest, NodeHierTest2) {
+  std::vector<double> costlist = {1, 2, 3, 2, 1, 4, 1, 1};
+  int nranks = 4;
+  std::vector<int> ranklist(costlist.size(), -1);
+  std::vector<int> node_map = {0, 1, 0, 1};
+
+  PolicyOptsNodeHier opts{LoadBalancePolicy::kPolicyLPT};
+  int rv = AssignBlocksNodeHierarchical(costlist, ranklist, nranks, opts,
+                                        node_map);
+  ASSERT_EQ(rv, 0);
+  EXPECT_TRUE(AssertAllRanksAssigned(ranklist, nranks));
+
+  // rank neighbors on different nodes are off-node, unlike with the
+  // rank-only model
+  EXPECT_DOUBLE_EQ(PolicyUtils::ComputeLocCost({0, 1}), 0.5);
+  EXPECT_DOUBLE_EQ(PolicyUtils::ComputeLocCost({0, 1}, node_map), 1.5);
+  EXPECT_DOUBLE_EQ(PolicyUtils::ComputeLocCost({0, 2}, node_map), 1.0);
+
+  // mismatched node map is rejected
+  node_map.pop_back();
+  rv = AssignBlocksNodeHierarchical(costlist, ranklist, nranks, opts,
+                                    node_map);
+  EXPECT_NE(rv, 0);
+}
+
+TEST_F(PolicyTest, RobustTest1) {
+  // equal means, but the first half of the blocks is much noisier
+  std::vector<double> means(8, 1.0);
+  std::vector<double> vars = {4, 4, 4, 4, 0, 0, 0, 0};
+  int nranks = 2;
+  std::vector<int> ranklist(means.size(), -1);
+
+  // the median of a normal is its mean: same as CDP on the means
+  PolicyOptsRobust opts{LoadBalancePolicy::kPolicyContigImproved, 0.5, 100};
+  int rv = AssignBlocksRobust(means, vars, ranklist, nranks, opts);
+  ASSERT_EQ(rv, 0);
+
+  std::vector<int> ranklist_cdp(means.size(), -1);
+  rv = AssignBlocksContigImproved(means, ranklist_cdp, nranks);
+  ASSERT_EQ(rv, 0);
+  ASSERT_EQ(ranklist, ranklist_cdp);
+
+  // at q90 the noisy rank sheds a block, and placement stays contiguous
+  opts.quantile = 0.9;
+  rv = AssignBlocksRobust(means, vars, ranklist, nranks, opts);
+  ASSERT_EQ(rv, 0);
+  EXPECT_TRUE(AssertAllRanksAssigned(ranklist, nranks));
+  EXPECT_TRUE(std::is_sorted(ranklist.begin(), ranklist.end()));
+  EXPECT_EQ(std::count(ranklist.begin(), ranklist.end(), 0), 3);
+
+  // the cached/MPI entry point uses the given variances too
+  std::vector<int> ranklist_cached;
+  rv = LoadBalancePolicies::AssignBlocksCached(
+      "robust", means, ranklist_cached, nranks, 0, MPI_COMM_NULL, nullptr,
+      nullptr, &vars);
+  ASSERT_EQ(rv, 0);
+  ASSERT_EQ(ranklist_cached, ranklist);
+
+  // LPT base: the noisy blocks get spread out
+  opts.base_policy = LoadBalancePolicy::kPolicyLPT;
+  rv = AssignBlocksRobust(means, vars, ranklist, nranks, opts);
+  ASSERT_EQ(rv, 0);
+  EXPECT_TRUE(AssertAllRanksAssigned(ranklist, nranks));
+
+  // mismatched variances are rejected
+  vars.pop_back();
+  rv = AssignBlocksRobust(means, vars, ranklist, nranks, opts);
+  EXPECT_NE(rv, 0);
+}
+
+TEST_F(PolicyTest, BnBTest1) {
+  // LPT gives 7 here, the optimum is 6
+  std::vector<double> costlist = {3, 3, 2, 2, 2};
+  int nranks = 2;
+  std::vector<int> ranklist;
+  std::vector<BnBProgress> progress;
+
+  PolicyOptsBnB opts{1000, 0};
+  int rv = LoadBalancePolicies::AssignBlocksBnB(costlist, ranklist, nranks,
+                                                opts, &progress);
+  ASSERT_EQ(rv, 0);
+  EXPECT_TRUE(AssertAllRanksAssigned(ranklist, nranks));
+
+  std::vector<double> rank_times;
+  double time_avg, time_max;
+  PolicyUtils::ComputePolicyCosts(nranks, costlist, ranklist, rank_times,
+                                  time_avg, time_max);
+  EXPECT_DOUBLE_EQ(time_max, 6);
+
+  ASSERT_FALSE(progress.empty());
+  EXPECT_DOUBLE_EQ(progress.back().makespan, 6);
+  EXPECT_DOUBLE_EQ(progress.back().lower_bound, 6);
+}
+
+TEST_F(PolicyTest, BnBTest2) {
+  // compare against exhaustive search
+  std::vector<double> costlist = {7.5, 6.1, 5.3, 5.2, 4.9,
+                                  3.3, 3.1, 2.2, 1.7, 1.2};
+  int nranks = 3;
+  int nblocks = costlist.size();
+
+  double opt = ExhaustiveMakespan(costlist, nranks);
+  std::vector<int> ranklist(nblocks, 0);
+
+  std::vector<BnBProgress> progress;
+  PolicyOptsBnB opts{1000, 0};
+  int rv = LoadBalancePolicies::AssignBlocksBnB(costlist, ranklist, nranks,
+                                                opts, &progress);
+  ASSERT_EQ(rv, 0);
+
+  std::vector<double> rank_times;
+  double time_avg, time_max;
+  PolicyUtils::ComputePolicyCosts(nranks, costlist, ranklist, rank_times,
+                                  time_avg, time_max);
+  EXPECT_NEAR(time_max, opt, 1e-9);
+
+  // the incumbent only improves, and never beats the lower bound
+  for (int i = 1; i < progress.size(); i++) {
+    EXPECT_LE(progress[i].makespan, progress[i - 1].makespan);
+    EXPECT_GE(progress[i].makespan, progress[i].lower_bound - 1e-9);
+  }
+  EXPECT_NEAR(progress.back().lower_bound, opt, 1e-9);
+
+  // via the policy map
+  std::vector<int> ranklist_map;
+  rv = LoadBalancePolicies::AssignBlocksCached("bnb", costlist, ranklist_map,
+                                               nranks);
+  ASSERT_EQ(rv, 0);
+  EXPECT_EQ(ranklist_map, ranklist);
+}
+
+TEST_F(PolicyTest, BnBGapTest) {
+  // with rel_gap > 0, optimality is not proven: the reported lower bound
+  // must stay below the optimum
+  std::vector<double> costlist = {7.5, 6.1, 5.3, 5.2, 4.9,
+                                  3.3, 3.1, 2.2, 1.7, 1.2};
+  int nranks = 3;
+  double opt = ExhaustiveMakespan(costlist, nranks);
+
+  for (double rel_gap : {0.01, 0.05, 0.2}) {
+    std::vector<int> ranklist;
+    std::vector<BnBProgress> progress;
+    PolicyOptsBnB opts{1000, rel_gap};
+    int rv = LoadBalancePolicies::AssignBlocksBnB(costlist, ranklist, nranks,
+                                                  opts, &progress);
+    ASSERT_EQ(rv, 0);
+    ASSERT_FALSE(progress.empty());
+
+    double makespan = progress.back().makespan;
+    double lower_bound = progress.back().lower_bound;
+    EXPECT_LE(lower_bound, opt + 1e-9);
+    EXPECT_GE(makespan, opt - 1e-9);
+    EXPECT_LE(makespan, lower_bound * (1 + rel_gap) + 1e-9);
+  }
+}
+
+TEST_F(PolicyTest, AnytimeSolverTest) {
+#include "lb_test4.h"
+  int nranks = 512;
+  std::vector<int> ranklist(costlist.size(), -1);
+
+  int rv = AssignBlocksContigImproved(costlist, ranklist, nranks);
+  ASSERT_EQ(rv, 0);
+
+  double avg_cost, max_cost_cdp, max_cost_anytime;
+  Solver::AnalyzePlacement(costlist, ranklist, nranks, avg_cost, max_cost_cdp);
+
+  // an already-expired budget must hand back the input placement
+  std::vector<int> ranklist_zero = ranklist;
+  SolverStats stats;
+  Deadline expired(1e-9);
+  while (not expired.Expired()) {
+  }
+
+  Solver().AssignBlocksAnytime(costlist, ranklist_zero, nranks, 0, expired,
+                               stats);
+  ASSERT_EQ(stats.niters, 0);
+  ASSERT_TRUE(stats.deadline_hit);
+  ASSERT_EQ(ranklist_zero, ranklist);
+
+  Deadline deadline(100);
+  Solver().AssignBlocksAnytime(costlist, ranklist, nranks, 250, deadline,
+                               stats);
+  Solver::AnalyzePlacement(costlist, ranklist, nranks, avg_cost,
+                           max_cost_anytime);
+
+  EXPECT_TRUE(AssertAllRanksAssigned(ranklist, nranks));
+  // the returned placement is the best one seen, never worse than input
+  EXPECT_LE(max_cost_anytime, max_cost_cdp);
+  EXPECT_DOUBLE_EQ(max_cost_anytime, stats.cost_final);
+  MLOG(MLOG_INFO, "Anytime: %d iters, %.2lf ms, max cost %.0lf -> %.0lf",
+       stats.niters, stats.elapsed_ms, stats.cost_initial, stats.cost_final);
+}
 }  // namespace amr
@@ -69,10 +69,26 @@ inline std::string fmtstr(int bufsz, const char *fmt, ...) {
     }                                                                          \
   } while (0);
 
+// Highest level compiled in. Calls above it are dead code, so hot-loop
+// DBG2/DBG3 logs cost nothing in release builds. Override with
+// -DMLOG_COMPILE_LEVEL=<level> (LB_LOG_COMPILE_LEVEL in CMake)
+#ifndef MLOG_COMPILE_LEVEL
+#ifdef NDEBUG
+#define MLOG_COMPILE_LEVEL MLOG_DBG1
+#else
+#define MLOG_COMPILE_LEVEL MLOG_DBG3
+#endif
+#endif
+
 #define MLOG(level, fmt, ...)                                                  \
-  MLOG_INNER(level, "[%10.10s:%3.3d] " fmt,                                    \
-             (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__), \
-             __LINE__, ##__VA_ARGS__)
+  do {                                                                         \
+    if ((level) <= MLOG_COMPILE_LEVEL) {                                       \
+      MLOG_INNER(                                                              \
+          level, "[%10.10s:%3.3d] " fmt,                                       \
+          (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__),    \
+          __LINE__, ##__VA_ARGS__)                                             \
+    }                                                                          \
+  } while (0);
 
 #define MLOGIF(cond, level, fmt, ...)                                          \
   if (cond) {                                                                  \
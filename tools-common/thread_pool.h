@@ -0,0 +1,102 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace amr {
+//
+// ThreadPool: fixed set of workers draining a FIFO of tasks.
+// Submit returns a future for one task; ParallelFor runs f(0..n-1) and
+// blocks until all are done. Tasks must not wait on other pool tasks.
+// The destructor finishes queued tasks before joining.
+//
+class ThreadPool {
+ public:
+  explicit ThreadPool(int nthreads) : shutdown_(false) {
+    if (nthreads < 1) nthreads = 1;
+    for (int i = 0; i < nthreads; i++) {
+      workers_.emplace_back([this]() { WorkerLoop(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool& other) = delete;
+
+  ThreadPool& operator=(const ThreadPool& other) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      shutdown_ = true;
+    }
+    cv_.notify_all();
+
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  int NumThreads() const { return workers_.size(); }
+
+  template <typename F>
+  std::future<void> Submit(F&& f) {
+    auto task = std::make_shared<std::packaged_task<void()>>(std::forward<F>(f));
+    std::future<void> fut = task->get_future();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.emplace([task]() { (*task)(); });
+    }
+    cv_.notify_one();
+
+    return fut;
+  }
+
+  template <typename F>
+  void ParallelFor(int n, F f) {
+    std::vector<std::future<void>> futs;
+    futs.reserve(n);
+    for (int i = 0; i < n; i++) {
+      futs.push_back(Submit([&f, i]() { f(i); }));
+    }
+
+    for (auto& fut : futs) {
+      fut.get();
+    }
+  }
+
+  // DefaultNumThreads: hardware threads, at least 1
+  static int DefaultNumThreads() {
+    int n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+  }
+
+ private:
+  void WorkerLoop() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return shutdown_ or not tasks_.empty(); });
+        if (tasks_.empty()) return;
+
+        task = std::move(tasks_.front());
+        tasks_.pop();
+      }
+
+      task();
+    }
+  }
+
+  bool shutdown_;
+  std::vector<std::thread> workers_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+}  // namespace amr
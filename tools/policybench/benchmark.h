@@ -46,19 +46,23 @@ public:
     // RunType hybrid3 = base;
     // hybrid3.policy = "hybrid";
     //
-    // RunType lpt = base;
-    // lpt.policy = "lpt";
-    //
-    // RunType cpp = base;
-    // cpp.policy = "cdp";
-    //
     // RunType cpp_iter = base;
     // cpp_iter.policy = "cdpi50";
     // int iter = 50;
 
     // std::vector<RunType> all_runs{base, cpp, cpp_iter, lpt, hybrid, hybrid2};
     // std::vector<RunType> all_runs{hybrid3, lpt};
-    std::vector<RunType> all_runs{base};
+    RunType lpt = base;
+    lpt.policy = "lpt";
+
+    RunType cpp = base;
+    cpp.policy = "cdp";
+
+    // small enough for BnB, which serves as the optimality reference
+    RunType bnb = base;
+    bnb.policy = "bnb";
+
+    std::vector<RunType> all_runs{base, lpt, cpp, bnb};
 
     for (auto &r : all_runs) {
       MLOG(MLOG_INFO, "[RUN] %s", r.ToString().c_str());
@@ -154,11 +158,50 @@ public:
 
     MLOG(MLOG_INFO, "Times: %s", SerializeVector(costs, 10).c_str());
 
+    ref_lb_ = 0;
+    ref_ranks_.clear();
+    for (auto &r : rvec) {
+      if (r.policy == "bnb") {
+        ComputeReference(r, costs);
+        break;
+      }
+    }
+
     for (auto &r : rvec) {
       DoRun(r, costs);
     }
   }
 
+  //
+  // Run BnB once on costs, log its incumbent/bound over time, and keep its
+  // lower bound, so that DoRun can report each policy's optimality gap.
+  // The placement is kept too, so that DoRun does not solve BnB again
+  //
+  void ComputeReference(const RunType &r, std::vector<double> const &costs) {
+    std::vector<int> ranks;
+    std::vector<BnBProgress> progress;
+    auto const policy = PolicyUtils::GetPolicy(r.policy.c_str());
+
+    int rv = LoadBalancePolicies::AssignBlocksBnB(costs, ranks, r.nranks,
+                                                  policy.bnb_opts, &progress);
+    if (rv or progress.empty()) {
+      MLOG(MLOG_WARN, "[BnB] Reference run failed, no gaps reported");
+      return;
+    }
+
+    for (auto const &p : progress) {
+      MLOG(MLOG_INFO,
+           "[BnB] %10.2lf ms: makespan %.2lf, bound %.2lf, gap %.2lf%% "
+           "(%ld nodes)",
+           p.elapsed_ms, p.makespan, p.lower_bound,
+           (p.makespan / p.lower_bound - 1) * 100,
+           static_cast<long>(p.nnodes));
+    }
+
+    ref_lb_ = progress.back().lower_bound;
+    ref_ranks_ = ranks;
+  }
+
   //
   // Invoke a run, add results to table_
   //
@@ -170,8 +213,12 @@ public:
     MLOG(MLOG_INFO, "%s", r.ToString().c_str());
 
     std::vector<int> ranks(costs.size());
-    LoadBalancePolicies::AssignBlocksCached(r.policy.c_str(), costs, ranks,
-                                            r.nranks);
+    if (r.policy == "bnb" and not ref_ranks_.empty()) {
+      ranks = ref_ranks_;
+    } else {
+      LoadBalancePolicies::AssignBlocksCached(r.policy.c_str(), costs, ranks,
+                                              r.nranks);
+    }
     std::vector<double> rank_times;
     PolicyUtils::ComputePolicyCosts(r.nranks, costs, ranks, rank_times,
                                     time_avg, time_max);
@@ -179,6 +226,11 @@ public:
          "[%-20s] Placement evaluated. Avg Cost: %.2f, Max Cost: %.2f",
          r.policy.c_str(), time_avg, time_max);
 
+    if (ref_lb_ > 0) {
+      MLOG(MLOG_INFO, "[%-20s] Gap to BnB lower bound: %.2f%%",
+           r.policy.c_str(), (time_max / ref_lb_ - 1) * 100);
+    }
+
     utils_.LogVector("Costs", costs);
     utils_.LogVector("Ranks", ranks);
     utils_.LogVector("Rank times", rank_times);
@@ -209,5 +261,7 @@ private:
   const BenchmarkOpts opts_;
   TabularData table_;
   BenchmarkUtils utils_;
+  double ref_lb_ = 0; // BnB lower bound for the current costs, 0 if none
+  std::vector<int> ref_ranks_; // BnB placement for the current costs
 };
 } // namespace amr
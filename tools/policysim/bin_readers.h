@@ -10,6 +10,7 @@
 
 #include "tools-common/logging.h"
 #include "reader_base.h"
+#include "trace_index.h"
 
 #define FAILIO_IFLT(x, y)                                                     \
   if (x < y) {                                                                \
@@ -17,15 +18,17 @@
     return -1;                                                                \
   }
 
-#define SAFE_READ(x)                 \
-  n = fread(x, sizeof(int), 1, fd_); \
-  FAILIO_IFLT(n, 1)
+#define SAFE_READ(x, cnt) FAILIO_IFLT(Read(x, cnt), 1)
 
 namespace amr {
-class PeekableReader : public ReaderBase {
+//
+// PeekableReader: timestep records of ints, (ts, sub_ts, payload...),
+// decoded from an mmap-ed trace
+//
+class PeekableReader : public MmapReaderBase {
  protected:
   explicit PeekableReader(std::string fpath)
-      : ReaderBase(std::move(fpath)),
+      : MmapReaderBase(std::move(fpath)),
         next_ts_(0),
         next_sub_ts_(0),
         peeked_(false) {}
@@ -40,7 +43,7 @@ class PeekableReader : public ReaderBase {
     }
 
     peeked_ = false;
-    return feof(fd_) ? 0 : 1;
+    return 1;
   }
 
   int PeakNext(int& ts, int& sub_ts) {
@@ -50,20 +53,16 @@ class PeekableReader : public ReaderBase {
     if (peeked_) {
       ts = next_ts_;
       sub_ts = next_sub_ts_;
-      return feof(fd_) ? 0 : 1;
+      return 1;
     }
 
-    size_t n;
-
-    n = fread(&next_ts_, sizeof(int), 1, fd_);
-    if (n == 0 && feof(fd_)) {
+    if (Eof()) {
       MLOG(MLOG_DBG0, "Reached end of file");
       return 0;
-    } else {
-      FAILIO_IFLT(n, 1);
     }
 
-    SAFE_READ(&next_sub_ts_);
+    SAFE_READ(&next_ts_, 1);
+    SAFE_READ(&next_sub_ts_, 1);
     peeked_ = true;
 
     ts = next_ts_;
@@ -72,7 +71,65 @@ class PeekableReader : public ReaderBase {
     return 1;
   }
 
+ public:
+  // SeekTimestep: position at the first record with sub_ts >= sub_ts,
+  // via the sidecar index. Returns 0, or -1 on error
+  int SeekTimestep(int sub_ts) {
+    std::vector<TraceIndex::Entry> entries;
+    int rv = LoadIndex(entries);
+    if (rv) return rv;
+
+    Seek(TraceIndex::Lookup(entries, sub_ts, Size()));
+    peeked_ = false;
+    return 0;
+  }
+
+  // SubTsEnd: one past the last sub_ts in the trace (0 if empty). May
+  // rewind the reader. Returns 0, or -1 on error
+  int SubTsEnd(int& sub_ts_end) {
+    std::vector<TraceIndex::Entry> entries;
+    int rv = LoadIndex(entries);
+    if (rv) return rv;
+
+    sub_ts_end = entries.empty() ? 0 : entries.back().sub_ts + 1;
+    return 0;
+  }
+
+ protected:
+  // SkipRecord: consume the peeked record, payload included
+  virtual int SkipRecord() = 0;
+
  private:
+  int LoadIndex(std::vector<TraceIndex::Entry>& entries) {
+    return TraceIndex::LoadOrBuild(
+        fpath_, entries,
+        [this](std::vector<TraceIndex::Entry>& e) { return BuildIndex(e); });
+  }
+
+  int BuildIndex(std::vector<TraceIndex::Entry>& entries) {
+    Seek(0);
+    peeked_ = false;
+
+    while (true) {
+      size_t offset = Tell();
+      int ts, sub_ts;
+      int rv = PeakNext(ts, sub_ts);
+      if (rv <= 0) {
+        Seek(0);
+        return rv;
+      }
+
+      if (entries.empty() or entries.back().sub_ts != sub_ts) {
+        entries.push_back({sub_ts, offset});
+      }
+
+      if (SkipRecord() != 1) {
+        Seek(0);
+        return -1;
+      }
+    }
+  }
+
   int next_ts_;
   int next_sub_ts_;
   bool peeked_;
@@ -111,32 +168,32 @@ class RefinementReader : public PeekableReader {
     return 1;
   }
 
+ protected:
+  int SkipRecord() override {
+    int ts, sub_ts;
+    return ReadTimestepInternal(ts, sub_ts, scratch_, scratch_);
+  }
+
  private:
   int ReadTimestepInternal(int ts, int sub_ts, std::vector<int>& refs,
                            std::vector<int>& derefs) {
-    size_t n;
-
     int nrefs, nderefs;
 
     int rv = ConsumePeek(ts, sub_ts);
     if (rv == 0) return 0;
 
-    SAFE_READ(&nrefs);
+    SAFE_READ(&nrefs, 1);
     refs.resize(nrefs);
+    SAFE_READ(refs.data(), nrefs);
 
-    for (int i = 0; i < nrefs; i++) {
-      SAFE_READ(&refs[i]);
-    }
-
-    SAFE_READ(&nderefs);
+    SAFE_READ(&nderefs, 1);
     derefs.resize(nderefs);
-
-    for (int i = 0; i < nderefs; i++) {
-      SAFE_READ(&derefs[i]);
-    }
+    SAFE_READ(derefs.data(), nderefs);
 
     return 1;
   }
+
+  std::vector<int> scratch_;
 };
 
 class AssignmentReader : public PeekableReader {
@@ -172,23 +229,27 @@ class AssignmentReader : public PeekableReader {
     return 1;
   }
 
+ protected:
+  int SkipRecord() override {
+    int ts, sub_ts;
+    return ReadTimestepInternal(ts, sub_ts, scratch_);
+  }
+
  private:
   int ReadTimestepInternal(int ts, int sub_ts, std::vector<int>& blocks) {
-    int n;
     int nblocks;
 
     int rv = ConsumePeek(ts, sub_ts);
     if (rv == 0) return 0;
 
-    SAFE_READ(&nblocks);
+    SAFE_READ(&nblocks, 1);
     blocks.resize(nblocks);
-
-    for (int i = 0; i < nblocks; i++) {
-      SAFE_READ(&blocks[i]);
-    }
+    SAFE_READ(blocks.data(), nblocks);
 
     return 1;
   }
+
+  std::vector<int> scratch_;
 };
 }  // namespace amr
 
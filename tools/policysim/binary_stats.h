@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "lb-common/writable_file.h"
+#include "tools-common/logging.h"
+
+namespace amr {
+//
+// Binary policysim stats: one file per policy holding, per timestep, all
+// that the text summ/det/ranksum files hold, so they can be regenerated
+// (see stats_convert.cc).
+//
+// Layout: magic[8], then per timestep: i32 ts, i32 ncosts, i32 nranklist,
+// i32 nranks, f64 avg_us, f64 max_us, f64 costs[ncosts],
+// i32 ranks[nranklist], f64 rank_times[nranks]
+//
+struct StatsRecord {
+  int ts;
+  double avg_us;
+  double max_us;
+  std::vector<double> costs;
+  std::vector<int> ranks;
+  std::vector<double> rank_times;
+};
+
+class BinaryStats {
+ public:
+  static const char* Magic() { return "AMRSTAT1"; }
+  static constexpr size_t kMagicBytes = 8;
+};
+
+//
+// BinaryStatsWriter: records are encoded into a large buffer, and full
+// buffers are written out by a background thread, so the simulation
+// thread never blocks on small writes
+//
+class BinaryStatsWriter {
+ public:
+  BinaryStatsWriter(pdlfs::Env* env, std::string const& fpath)
+      : fd_(env, fpath), queue_(kMaxBuffersQueued) {
+    buf_.reserve(kBufferBytes);
+    buf_.append(BinaryStats::Magic(), BinaryStats::kMagicBytes);
+    flusher_ = std::thread([this]() { FlushLoop(); });
+  }
+
+  BinaryStatsWriter(const BinaryStatsWriter& other) = delete;
+
+  ~BinaryStatsWriter() {
+    if (not buf_.empty()) queue_.Push(std::move(buf_));
+    queue_.Close();
+    flusher_.join();
+  }
+
+  void LogTimestep(int ts, double avg_us, double max_us,
+                   std::vector<double> const& costs,
+                   std::vector<int> const& ranks,
+                   std::vector<double> const& rank_times) {
+    int hdr[4] = {ts, static_cast<int>(costs.size()),
+                  static_cast<int>(ranks.size()),
+                  static_cast<int>(rank_times.size())};
+
+    AppendRaw(hdr, 4);
+    AppendRaw(&avg_us, 1);
+    AppendRaw(&max_us, 1);
+    AppendRaw(costs.data(), hdr[1]);
+    AppendRaw(ranks.data(), hdr[2]);
+    AppendRaw(rank_times.data(), hdr[3]);
+
+    if (buf_.size() >= kBufferBytes) {
+      queue_.Push(std::move(buf_));
+      buf_.clear();
+      buf_.reserve(kBufferBytes);
+    }
+  }
+
+ private:
+  template <typename T>
+  void AppendRaw(T const* data, int n) {
+    buf_.append(reinterpret_cast<const char*>(data), sizeof(T) * n);
+  }
+
+  void FlushLoop() {
+    std::string buf;
+    while (queue_.Pop(buf)) {
+      fd_.Append(buf);
+    }
+  }
+
+  static constexpr size_t kBufferBytes = 4 << 20;
+  static constexpr int kMaxBuffersQueued = 4;
+
+  WritableFile fd_;  // only touched by flusher_
+  std::string buf_;
+  BoundedQueue<std::string> queue_;
+  std::thread flusher_;
+};
+
+//
+// BinaryStatsReader: sequential reads. Returns: 1 read, 0 EOF, -1 error
+//
+class BinaryStatsReader {
+ public:
+  explicit BinaryStatsReader(std::string fpath)
+      : fpath_(std::move(fpath)), fd_(nullptr) {
+    fd_ = fopen(fpath_.c_str(), "rb");
+    if (fd_ == nullptr) {
+      MLOG(MLOG_ERRO, "Unable to open file: %s\n", fpath_.c_str());
+      ABORT("Unable to open file");
+    }
+
+    char magic[BinaryStats::kMagicBytes];
+    if (fread(magic, 1, sizeof(magic), fd_) != sizeof(magic) or
+        memcmp(magic, BinaryStats::Magic(), sizeof(magic)) != 0) {
+      MLOG(MLOG_ERRO, "Not a binary stats file: %s\n", fpath_.c_str());
+      ABORT("Not a binary stats file");
+    }
+  }
+
+  BinaryStatsReader(const BinaryStatsReader& other) = delete;
+
+  ~BinaryStatsReader() {
+    if (fd_ != nullptr) {
+      fclose(fd_);
+      fd_ = nullptr;
+    }
+  }
+
+  int ReadTimestep(StatsRecord& r) {
+    int hdr[4];  // ts, ncosts, nranklist, nranks
+    size_t nread = fread(hdr, sizeof(int), 4, fd_);
+    if (nread == 0 and feof(fd_)) return 0;
+    if (nread != 4 or hdr[1] < 0 or hdr[2] < 0 or hdr[3] < 0) {
+      return Corrupt();
+    }
+
+    r.ts = hdr[0];
+    r.costs.resize(hdr[1]);
+    r.ranks.resize(hdr[2]);
+    r.rank_times.resize(hdr[3]);
+
+    bool ok = ReadRaw(&r.avg_us, 1) and ReadRaw(&r.max_us, 1) and
+              ReadRaw(r.costs.data(), hdr[1]) and
+              ReadRaw(r.ranks.data(), hdr[2]) and
+              ReadRaw(r.rank_times.data(), hdr[3]);
+
+    return ok ? 1 : Corrupt();
+  }
+
+ private:
+  template <typename T>
+  bool ReadRaw(T* data, size_t n) {
+    return fread(data, sizeof(T), n, fd_) == n;
+  }
+
+  int Corrupt() const {
+    MLOG(MLOG_ERRO, "Error reading file: %s\n", fpath_.c_str());
+    return -1;
+  }
+
+  std::string const fpath_;
+  FILE* fd_;
+};
+}  // namespace amr
@@ -2,6 +2,12 @@
 // Created by Ankush J on 5/1/23.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <set>
+#include <thread>
+
 #include "block_alloc_sim.h"
 
 namespace amr {
@@ -9,10 +15,11 @@ void BlockSimulator::SetupAllPolicies() {
   policies_.clear();
 
   PolicyExecOpts policy_opts;
-  policy_opts.output_dir = options_.output_dir.c_str();
+  policy_opts.output_dir = stats_dir_.c_str();
   policy_opts.env = options_.env;
   policy_opts.nranks = options_.nranks;
   policy_opts.nblocks_init = options_.nblocks;
+  policy_opts.mesh_ndims = options_.ndims;
   // XXX: hardcoded for now
   policy_opts.trigger_interval = 1000;
   MLOG(MLOG_INFO, "Hardcoded trigger interval: %d\n",
@@ -73,6 +80,28 @@ void BlockSimulator::SetupAllPolicies() {
   //                       TriggerPolicy::kEveryNTimesteps);
   // SetupPolicy(policy_opts);
 
+  // nominal vs. robust placement on estimated costs, both scored against
+  // the actual costs of the timestep
+  policy_opts.SetPolicy("CDP/Extrapolated-Cost", "cdp",
+                        CostEstimationPolicy::kExtrapolatedCost,
+                        TriggerPolicy::kEveryNTimesteps);
+  SetupPolicy(policy_opts);
+
+  policy_opts.SetPolicy("Robust-CDP/Extrapolated-Cost", "robust",
+                        CostEstimationPolicy::kExtrapolatedCost,
+                        TriggerPolicy::kEveryNTimesteps);
+  SetupPolicy(policy_opts);
+
+  policy_opts.SetPolicy("CDP/Predicted-Cost", "cdp",
+                        CostEstimationPolicy::kPredictedCost,
+                        TriggerPolicy::kEveryNTimesteps);
+  SetupPolicy(policy_opts);
+
+  policy_opts.SetPolicy("CDP/Predicted-Cost/Cost-Benefit", "cdp",
+                        CostEstimationPolicy::kPredictedCost,
+                        TriggerPolicy::kCostBenefit);
+  SetupPolicy(policy_opts);
+
   policy_opts.SetPolicy("LPT/Actual-Cost", "lpt",
                         CostEstimationPolicy::kOracleCost,
                         TriggerPolicy::kEveryNTimesteps);
@@ -112,36 +141,355 @@ void BlockSimulator::Run() {
 
   Utils::EnsureDir(options_.env, options_.output_dir);
 
+  int sub_ts_beg = options_.sub_ts_beg;
+  if (options_.window_replay) {
+    sub_ts_beg = SetupWindow();
+    Utils::EnsureDir(options_.env, stats_dir_);
+  }
+
   SetupAllPolicies();
 
+  int npolicy_threads =
+      std::min(options_.policy_threads, static_cast<int>(policies_.size()));
+  if (npolicy_threads > 1) {
+    MLOG(MLOG_INFO, "[BlockSim] Running %d policies at once",
+         npolicy_threads);
+    policy_pool_.reset(new ThreadPool(npolicy_threads));
+  }
+
   /* Semantics: every sub_ts exists in the assignment log, but
    * refinement log is sparse. A sub_ts not present in the assignment log
    * indicates corruption.
    * The code below sets the ts for the current sub_ts
    */
-  int sub_ts;
-  for (sub_ts = 0; sub_ts < options_.nts; sub_ts++) {
-    int ts;
-    int rv = RunTimestep(ts, sub_ts);
-    if (rv == 0) break;
+  int nsimulated = 0;
+  if (sub_ts_beg > 0) {
+    nsimulated = StartWindow(sub_ts_beg);
+    sub_ts_beg++;
   }
 
-  LogSummary();
+  if (options_.prefetch_depth > 0) {
+    nsimulated += RunPrefetched(sub_ts_beg);
+  } else {
+    int sub_ts;
+    for (sub_ts = sub_ts_beg; sub_ts < sub_ts_end_; sub_ts++) {
+      int ts;
+      int rv = RunTimestep(ts, sub_ts);
+      if (rv == 0) break;
+    }
+    nsimulated += sub_ts - sub_ts_beg;
+  }
+
+  if (options_.window_replay) {
+    MergeWindows();
+  } else {
+    std::vector<std::pair<int, int>> ts_counts;
+    for (auto& policy : policies_) {
+      int ts_succeeded, ts_invoked;
+      policy.GetTimestepCount(ts_succeeded, ts_invoked);
+      ts_counts.emplace_back(ts_succeeded, ts_invoked);
+    }
+    LogSummary(ts_counts);
+  }
 
   MLOG(MLOG_INFO,
-       "Simulation finished. Sub-timesteps simulated: %d.", sub_ts);
+       "Simulation finished. Sub-timesteps simulated: %d.", nsimulated);
+}
+
+//
+// SetupWindow: window_replay splits [sub_ts_beg, nts) evenly over the
+// ranks of comm, and each rank replays its window. Policy state at the
+// start of a window is not carried over from the previous one, but
+// rebuilt on the fly: the rank starts warmup_ts early, from the observed
+// placement there (see StartWindow), and only logs the window itself. As
+// policies re-place on every mesh change, placements catch up with those
+// of a serial replay at the first refinement of the warmup, but only if
+// the warmup contains one: without a refinement in warmup_ts, the window
+// starts from the observed placement and may differ, and a warning is
+// logged. Cost histories (predictor, trigger) are only approximated by
+// the warmup. Window 0 starts where a serial replay would, and matches
+// it exactly.
+//
+// Each window logs to <output_dir>/window<rank>, and MergeWindows puts
+// the files back together. Returns the first sub_ts to replay
+//
+int BlockSimulator::SetupWindow() {
+  int rank, nranks;
+  MPI_Comm_rank(options_.comm, &rank);
+  MPI_Comm_size(options_.comm, &nranks);
+
+  if (sub_ts_end_ == INT_MAX) {
+    sub_ts_end_ = TraceEnd();
+    FAIL_IF(sub_ts_end_ < 0, "Unable to find the end of the trace");
+  }
+
+  int64_t nts = std::max(sub_ts_end_ - options_.sub_ts_beg, 0);
+  int win_beg = options_.sub_ts_beg + nts * rank / nranks;
+  int win_end = options_.sub_ts_beg + nts * (rank + 1) / nranks;
+
+  // numbered as in a serial replay, which logs from sub_ts_log_beg_ on
+  int log_beg = std::max(options_.nts_toskip, options_.sub_ts_beg);
+  stats_ts_beg_ = std::max(win_beg - log_beg, 0);
+  sub_ts_win_beg_ = win_beg;
+  sub_ts_log_beg_ = std::max(options_.nts_toskip, win_beg);
+  sub_ts_end_ = win_end;
+  stats_dir_ = WindowDir(rank);
+
+  int replay_beg = (rank == 0) ? options_.sub_ts_beg
+                               : std::max(win_beg - options_.warmup_ts,
+                                          options_.sub_ts_beg);
+  // starting where a serial replay does, there is nothing to catch up on
+  warmup_refined_ = (replay_beg == options_.sub_ts_beg);
+
+  MLOG(MLOG_INFO, "[BlockSim] Window %d/%d: sub_ts=[%d, %d), warmup from %d",
+       rank, nranks, win_beg, win_end, replay_beg);
+
+  return replay_beg;
+}
+
+//
+// MergeWindows: sums the summary stats of all windows on rank 0, and
+// concatenates the per-window stats files, in window order, into the
+// files a serial replay would have written
+//
+void BlockSimulator::MergeWindows() {
+  std::vector<double> totals;
+  CloseWindow(totals);
+
+  int rank, nranks;
+  MPI_Comm_rank(options_.comm, &rank);
+  MPI_Comm_size(options_.comm, &nranks);
+
+  std::vector<double> merged(totals.size());
+  MPI_Reduce(totals.data(), merged.data(), totals.size(), MPI_DOUBLE, MPI_SUM,
+             0, options_.comm);
+
+  // all windows are closed once everyone is past the reduce
+  MPI_Barrier(options_.comm);
+  if (rank != 0) return;
+
+  std::vector<std::pair<int, int>> ts_counts;
+  SetMergedTotals(merged, ts_counts);
+
+  // policies with the same id share their stats files
+  std::set<std::string> policy_ids;
+  for (auto& policy : policies_) {
+    policy_ids.insert(policy.PolicyId());
+  }
+
+  for (auto& policy_id : policy_ids) {
+    for (auto& suffix : PolicyStats::FileSuffixes(options_.binary_stats,
+                                                  options_.comm_model)) {
+      int rv = MergeStatsFiles(policy_id.c_str(), suffix.c_str(), nranks);
+      FAIL_IF(rv != 0, "Unable to merge window stats");
+    }
+  }
+
+  MLOG(MLOG_INFO, "[BlockSim] Merged stats of %d windows", nranks);
+  LogSummary(ts_counts);
+}
+
+//
+// CloseWindow: closes the stats files of this window, and returns its
+// totals: kNumWindowTotals per policy, the PolicyStats totals followed by
+// the (succeeded, invoked) LB counts of the window itself
+//
+void BlockSimulator::CloseWindow(std::vector<double>& totals) {
+  int npolicies = policies_.size();
+  totals.assign(npolicies * kNumWindowTotals, 0);
+
+  for (int pidx = 0; pidx < npolicies; pidx++) {
+    double* t = &totals[pidx * kNumWindowTotals];
+    stats_[pidx].GetTotals(t);
+
+    int ts_succeeded, ts_invoked;
+    policies_[pidx].GetTimestepCount(ts_succeeded, ts_invoked);
+    if (ts_counts_beg_.empty()) {
+      // nothing of the window was replayed: all counts are from the warmup
+      ts_succeeded = 0;
+      ts_invoked = 0;
+    } else {
+      ts_succeeded -= ts_counts_beg_[pidx].first;
+      ts_invoked -= ts_counts_beg_[pidx].second;
+    }
+    t[kNumWindowTotals - 2] = ts_succeeded;
+    t[kNumWindowTotals - 1] = ts_invoked;
+
+    stats_[pidx].Close();
+  }
+}
+
+//
+// SetMergedTotals: installs the sums of the totals of all windows (see
+// CloseWindow) as the stats of this one, and returns the LB counts
+//
+void BlockSimulator::SetMergedTotals(
+    std::vector<double> const& merged,
+    std::vector<std::pair<int, int>>& ts_counts) {
+  int npolicies = policies_.size();
+  ts_counts.clear();
+
+  for (int pidx = 0; pidx < npolicies; pidx++) {
+    double const* t = &merged[pidx * kNumWindowTotals];
+    stats_[pidx].SetTotals(t);
+    ts_counts.emplace_back(t[kNumWindowTotals - 2], t[kNumWindowTotals - 1]);
+  }
+}
+
+//
+// MergeStatsFiles: concatenates a stats file of all windows into
+// output_dir, and removes the window files. Binary stats files each start
+// with a magic, which is only kept for the first window
+//
+int BlockSimulator::MergeStatsFiles(const char* policy_id, const char* suffix,
+                                    int nwindows) {
+  WritableFile fd_out(options_.env,
+                      PolicyUtils::GetLogPath(options_.output_dir.c_str(),
+                                              policy_id, suffix));
+  std::vector<char> buf(1 << 20);
+
+  for (int widx = 0; widx < nwindows; widx++) {
+    std::string fpath =
+        PolicyUtils::GetLogPath(WindowDir(widx).c_str(), policy_id, suffix);
+    FILE* f = fopen(fpath.c_str(), "rb");
+    if (f == nullptr) {
+      MLOG(MLOG_ERRO, "Unable to open file: %s", fpath.c_str());
+      return -1;
+    }
+
+    if (options_.binary_stats and widx > 0) {
+      fseek(f, BinaryStats::kMagicBytes, SEEK_SET);
+    }
+
+    size_t nread;
+    while ((nread = fread(buf.data(), 1, buf.size(), f)) > 0) {
+      fd_out.Append(buf.data(), nread);
+    }
+
+    fclose(f);
+    options_.env->DeleteFile(fpath.c_str());
+  }
+
+  return 0;
+}
+
+int BlockSimulator::TraceEnd() {
+  int sub_ts_end = -1;
+  if (col_reader_) {
+    int sub_ts_first;
+    if (col_reader_->SubTsRange(sub_ts_first, sub_ts_end)) sub_ts_end++;
+    else sub_ts_end = 0;
+    return sub_ts_end;
+  }
+
+  int rv = assign_reader_->SubTsEnd(sub_ts_end);
+  return rv == 0 ? sub_ts_end : -1;
+}
+
+int BlockSimulator::SeekTimestep(int sub_ts) {
+  // the columnar trace is read by sub_ts anyway
+  if (col_reader_) return 0;
+
+  int rv = assign_reader_->SeekTimestep(sub_ts);
+  if (rv == 0) rv = ref_reader_->SeekTimestep(sub_ts);
+  if (rv == 0) rv = prof_reader_->SeekTimestep(sub_ts);
+  return rv;
+}
+
+//
+// StartWindow: seek all readers to sub_ts, and restart there: policies
+// start from the observed placement with empty histories (see
+// PolicyExecCtx::Bootstrap), and the block count comes from the trace.
+// This is not the state a full replay would have at sub_ts; the warmup
+// before a window rebuilds it (see SetupWindow). Returns the number of
+// timesteps simulated (0 or 1)
+//
+int BlockSimulator::StartWindow(int sub_ts) {
+  MLOG(MLOG_INFO, "[BlockSim] Replaying from sub_ts %d", sub_ts);
+
+  int rv = SeekTimestep(sub_ts);
+  FAIL_IF(rv < 0, "Error in SeekTimestep");
+
+  TimestepTrace trace;
+  if (sub_ts >= sub_ts_end_ or ReadTimestep(sub_ts, trace) == 0) {
+    MLOG(MLOG_WARN, "[BlockSim] sub_ts %d is past the trace", sub_ts);
+    return 0;
+  }
+
+  for (auto& policy : policies_) {
+    policy.Bootstrap(sub_ts, trace.assignments);
+  }
+  nblocks_next_expected_ = -1;
+
+  ReadTimestepInternal(trace.ts, trace.sub_ts, trace.refs, trace.derefs,
+                       trace.assignments, trace.times, trace.msgs);
+  return 1;
+}
+
+//
+// RunPrefetched: a reader thread decodes up to prefetch_depth timesteps
+// ahead while this thread runs the policies. The readers are only touched
+// by the reader thread, and the policies only by this one.
+//
+int BlockSimulator::RunPrefetched(int sub_ts_beg) {
+  MLOG(MLOG_INFO, "[BlockSim] Prefetching %d timesteps ahead",
+       options_.prefetch_depth);
+
+  BoundedQueue<TimestepTrace> queue(options_.prefetch_depth);
+
+  std::thread reader([this, &queue, sub_ts_beg]() {
+    for (int sub_ts = sub_ts_beg; sub_ts < sub_ts_end_; sub_ts++) {
+      TimestepTrace trace;
+      if (ReadTimestep(sub_ts, trace) == 0) break;
+      if (not queue.Push(std::move(trace))) break;
+    }
+    queue.Close();
+  });
+
+  int nsimulated = 0;
+  TimestepTrace trace;
+  while (queue.Pop(trace)) {
+    ReadTimestepInternal(trace.ts, trace.sub_ts, trace.refs, trace.derefs,
+                         trace.assignments, trace.times, trace.msgs);
+    nsimulated++;
+  }
+
+  reader.join();
+  return nsimulated;
 }
 
 int BlockSimulator::RunTimestep(int& ts, int sub_ts) {
+  TimestepTrace trace;
+  int rv = ReadTimestep(sub_ts, trace);
+  ts = trace.ts;
+  if (rv == 0) return 0;
+
+  ReadTimestepInternal(trace.ts, sub_ts, trace.refs, trace.derefs,
+                       trace.assignments, trace.times, trace.msgs);
+
+  return 1;
+}
+
+int BlockSimulator::ReadTimestep(int sub_ts, TimestepTrace& trace) {
   int rv;
+  int& ts = trace.ts;
+  trace.sub_ts = sub_ts;
 
-  std::vector<int> block_assignments;
-  std::vector<int> refs, derefs;
-  std::vector<int> times;
+  std::vector<int>& block_assignments = trace.assignments;
+  std::vector<int>& refs = trace.refs;
+  std::vector<int>& derefs = trace.derefs;
+  std::vector<int>& times = trace.times;
 
   MLOG(MLOG_DBG0, "========================================");
 
-  rv = assign_reader_.ReadTimestep(ts, sub_ts, block_assignments);
+  if (col_reader_) {
+    rv = col_reader_->ReadTimestep(sub_ts, trace);
+    FAIL_IF(rv < 0, "Error in ColRd/ReadTimestep");
+    if (rv == 0) return 0;
+    return ReadMsgs(sub_ts, trace.msgs);
+  }
+
+  rv = assign_reader_->ReadTimestep(ts, sub_ts, block_assignments);
   FAIL_IF(rv < 0, "Error in AssRd/ReadTimestep");
   MLOG(MLOG_DBG0,
        "[BlockSim] [AssRd] TS:%d_%d, rv: %d\nAssignments: %s", ts, sub_ts, rv,
@@ -150,7 +498,7 @@ int BlockSimulator::RunTimestep(int& ts, int sub_ts) {
   if (rv == 0) return 0;
 
   int ts_rr;
-  rv = ref_reader_.ReadTimestep(ts_rr, sub_ts, refs, derefs);
+  rv = ref_reader_->ReadTimestep(ts_rr, sub_ts, refs, derefs);
   FAIL_IF(rv < 0, "Error in RefRd/ReadTimestep");
   MLOG(MLOG_DBG0,
        "[BlockSim] [RefRd] TS:%d_%d, rv: %d\n\tRefs: %s\n\tDerefs: %s", ts,
@@ -160,8 +508,8 @@ int BlockSimulator::RunTimestep(int& ts, int sub_ts) {
   if (ts_rr != -1) assert(ts_rr == ts);
 
   // XXX: commented out on 20240129, stochsg/mat.bin follows different
-  // convention? rv = prof_reader_.ReadTimestep(sub_ts - 1, times);
-  rv = prof_reader_.ReadTimestep(sub_ts, times);
+  // convention? rv = prof_reader_->ReadTimestep(sub_ts - 1, times);
+  rv = prof_reader_->ReadTimestep(sub_ts, times);
   MLOG(MLOG_DBG0, "[BlockSim] [ProfSetReader] RV: %d, Times: %s",
        rv, SerializeVector(times, 10).c_str());
   if (times.size() != block_assignments.size()) {
@@ -171,7 +519,18 @@ int BlockSimulator::RunTimestep(int& ts, int sub_ts) {
     times.resize(block_assignments.size(), 1);
   }
 
-  ReadTimestepInternal(ts, sub_ts, refs, derefs, block_assignments, times);
+  return ReadMsgs(sub_ts, trace.msgs);
+}
+
+// ReadMsgs: the message trace of sub_ts, if the comm model is on. A
+// timestep without messages is priced as free
+int BlockSimulator::ReadMsgs(int sub_ts, std::vector<CommEdge>& msgs) {
+  if (not msg_reader_) return 1;
+
+  int rv = msg_reader_->ReadTimestep(sub_ts, msgs);
+  FAIL_IF(rv < 0, "Error in MsgRd/ReadTimestep");
+  MLOG(MLOG_DBG0, "[BlockSim] [MsgRd] TS:%d, rv: %d, msgs: %zu", sub_ts, rv,
+       msgs.size());
 
   return 1;
 }
@@ -180,7 +539,8 @@ int BlockSimulator::ReadTimestepInternal(int ts, int sub_ts,
                                          std::vector<int>& refs,
                                          std::vector<int>& derefs,
                                          std::vector<int>& assignments,
-                                         std::vector<int>& times) {
+                                         std::vector<int>& times,
+                                         std::vector<CommEdge> const& msgs) {
   MLOG(MLOG_DBG2, "----------------------------------------");
 
   if (nblocks_next_expected_ != -1 &&
@@ -191,56 +551,104 @@ int BlockSimulator::ReadTimestepInternal(int ts, int sub_ts,
   }
 
   nblocks_next_expected_ = PolicyExecCtx::GetNumBlocksNext(
-      assignments.size(), refs.size(), derefs.size());
+      assignments.size(), refs, derefs, options_.ndims);
 
   MLOG(MLOG_DBG0, "[BlockSim] TS:%d_%d, nblocks: %d->%d", ts,
        sub_ts, (int)assignments.size(), nblocks_next_expected_);
 
   std::vector<double> costs(times.begin(), times.end());
-  InvokePolicies(sub_ts, costs, assignments, refs, derefs);
+  InvokePolicies(sub_ts, costs, assignments, refs, derefs, msgs);
 
   return 0;
 }
 
+//
+// InvokePolicies: policies share nothing but the (read-only) trace, so with
+// a policy_pool_ they run concurrently, each logging to its own stats.
+// Each policy carries its own PolicyState, so concurrent runs do not
+// change placements. Note that exec_time is wall time, and placements
+// that compete for cores report higher times.
+//
 int BlockSimulator::InvokePolicies(int sub_ts,
                                    std::vector<double> const& cost_oracle,
                                    std::vector<int>& ranklist_actual,
                                    std::vector<int>& refs,
-                                   std::vector<int>& derefs) {
-  int rv = 0;
-
+                                   std::vector<int>& derefs,
+                                   std::vector<CommEdge> const& msgs) {
   int npolicies = policies_.size();
+  std::vector<int> rvs(npolicies, 0);
+
+  // a window's LB counts start where the window does, past its warmup
+  if (options_.window_replay and ts_counts_beg_.empty() and
+      sub_ts >= sub_ts_win_beg_) {
+    for (auto& policy : policies_) {
+      int ts_succeeded, ts_invoked;
+      policy.GetTimestepCount(ts_succeeded, ts_invoked);
+      ts_counts_beg_.emplace_back(ts_succeeded, ts_invoked);
+    }
+
+    if (not warmup_refined_) {
+      MLOG(MLOG_WARN,
+           "[BlockSim] No refinement in the warmup of the window at sub_ts "
+           "%d: placements may differ from a serial replay (see warmup_ts)",
+           sub_ts_win_beg_);
+    }
+  }
+
+  // a mesh change makes every policy re-place on the next timestep
+  if (sub_ts < sub_ts_win_beg_ and (not refs.empty() or not derefs.empty())) {
+    warmup_refined_ = true;
+  }
+
+  // as in the serial loop, no policy starts after one has failed
+  std::atomic<bool> failed(false);
+
+  auto invoke = [&](int pidx) {
+    if (failed.load()) return;
 
-  for (int pidx = 0; pidx < npolicies; ++pidx) {
     auto& policy = policies_[pidx];
     double exec_time = 0;
-    rv = policy.ExecuteTimestep(cost_oracle, ranklist_actual, refs, derefs,
-                                exec_time);
-    if (rv != 0) break;
+    rvs[pidx] = policy.ExecuteTimestep(cost_oracle, ranklist_actual, refs,
+                                       derefs, exec_time);
+    if (rvs[pidx] != 0) {
+      failed.store(true);
+      return;
+    }
 
-    if (sub_ts >= options_.nts_toskip) {
+    if (sub_ts >= sub_ts_log_beg_) {
       if (policy.IsActualPolicy()) {
-        stats_[pidx].LogTimestep(cost_oracle, ranklist_actual, exec_time);
+        stats_[pidx].LogTimestep(cost_oracle, ranklist_actual, exec_time,
+                                 msgs);
       } else {
-        stats_[pidx].LogTimestep(cost_oracle, policy.GetRanklist(), exec_time);
+        stats_[pidx].LogTimestep(cost_oracle, policy.GetRanklist(), exec_time,
+                                 msgs);
       }
     }
+  };
+
+  if (policy_pool_) {
+    policy_pool_->ParallelFor(npolicies, invoke);
+  } else {
+    for (int pidx = 0; pidx < npolicies; ++pidx) {
+      invoke(pidx);
+    }
   }
 
-  return rv;
+  for (int rv : rvs) {
+    if (rv != 0) return rv;
+  }
+
+  return 0;
 }
 
-void BlockSimulator::LogSummary() {
+void BlockSimulator::LogSummary(
+    std::vector<std::pair<int, int>> const& ts_counts) {
   TabularData table;
   int n = stats_.size();
 
   for (int i = 0; i < n; ++i) {
     auto& stat = stats_[i];
-    auto& policy = policies_[i];
-    int ts_succeeded, ts_invoked;
-
-    policy.GetTimestepCount(ts_succeeded, ts_invoked);
-    auto row = stat.GetTableRow(ts_succeeded, ts_invoked);
+    auto row = stat.GetTableRow(ts_counts[i].first, ts_counts[i].second);
 
     table.addRow(row);
   }
@@ -4,29 +4,51 @@
 
 #pragma once
 
+#include <mpi.h>
+
+#include <memory>
 #include <vector>
 
+#include "bounded_queue.h"
+#include "columnar_trace.h"
+
 #include "bin_readers.h"
+#include "comm_model.h"
 #include "lb-common/policy.h"
 #include "lb-common/trace_utils.h"
+#include "msg_trace.h"
 #include "policy_exec_ctx.h"
 #include "policy_stats.h"
 #include "prof_set_reader.h"
 #include "tools-common/logging.h"
+#include "tools-common/thread_pool.h"
 
 namespace amr {
 struct BlockSimulatorOpts {
   int nblocks;
   int nranks;
-  int nts;
+  int nts;  // replay sub_ts [sub_ts_beg, nts)
+  int sub_ts_beg;
   int nts_toskip;
+  int ndims;  // mesh dimensionality (1, 2 or 3)
   std::string prof_dir;
   std::string output_dir;
   pdlfs::Env *env;
   std::vector<int> events;
   const char *prof_time_combine_policy;
+  int prefetch_depth;  // timesteps decoded ahead of policies; 0 disables
+  std::string trace_path;  // columnar trace; if empty, the per-kind traces
+  int prof_read_concurrency;  // profile files read at once
+  bool binary_stats;  // per-policy stats as binary, for stats-convert
+  int policy_threads;  // policies run at once; 1 runs them in order
+  bool window_replay;  // split [sub_ts_beg, nts) into one window per rank
+  MPI_Comm comm;       // ranks for window_replay
+  int warmup_ts;       // unlogged timesteps replayed ahead of a window
+  bool comm_model;  // price the message trace of prof_dir per policy
+  CommModelOpts comm_opts;
 };
 
+
 #define FAIL_IF(cond, msg)                                                     \
   if (cond) {                                                                  \
     MLOG(MLOG_ERRO, msg);                                                      \
@@ -36,48 +58,121 @@ struct BlockSimulatorOpts {
 class BlockSimulator {
 public:
   explicit BlockSimulator(BlockSimulatorOpts &opts)
-      : options_(opts), ref_reader_(options_.prof_dir),
-        assign_reader_(options_.prof_dir),
-        prof_reader_(Utils::LocateTraceFiles(options_.env, options_.prof_dir,
-                                             options_.events),
-                     Utils::ParseProfTimeCombinePolicy(
-                         options_.prof_time_combine_policy)),
-        nblocks_next_expected_(-1), num_lb_(0) {}
+      : options_(opts),
+        nblocks_next_expected_(-1),
+        num_lb_(0),
+        sub_ts_end_(opts.nts),
+        sub_ts_win_beg_(opts.sub_ts_beg),
+        sub_ts_log_beg_(opts.nts_toskip),
+        stats_ts_beg_(0),
+        stats_dir_(opts.output_dir),
+        warmup_refined_(true) {
+    if (options_.comm_model) {
+      msg_reader_.reset(new MsgTraceReader(options_.env, options_.prof_dir));
+      comm_model_.reset(new CommModel(options_.comm_opts));
+    }
+
+    if (not options_.trace_path.empty()) {
+      col_reader_.reset(new ColumnarTraceReader(options_.trace_path));
+      return;
+    }
+
+    ref_reader_.reset(new RefinementReader(options_.prof_dir));
+    assign_reader_.reset(new AssignmentReader(options_.prof_dir));
+    prof_reader_.reset(new ProfSetReader(
+        Utils::LocateTraceFiles(options_.env, options_.prof_dir,
+                                options_.events),
+        Utils::ParseProfTimeCombinePolicy(options_.prof_time_combine_policy),
+        options_.prof_read_concurrency));
+  }
 
   void SetupAllPolicies();
 
   void SetupPolicy(PolicyExecOpts &opts) {
     policies_.emplace_back(opts);
-    stats_.emplace_back(opts);
+    stats_.emplace_back(opts, options_.binary_stats, stats_ts_beg_,
+                        comm_model_.get());
   }
 
   void Run();
 
   int RunTimestep(int &ts, int sub_ts);
 
+  // ReadTimestep: decode one sub-timestep; returns 0 at the end of the trace
+  int ReadTimestep(int sub_ts, TimestepTrace &trace);
+
   int InvokePolicies(int sub_ts, std::vector<double> const &cost_oracle,
                      std::vector<int> &ranklist_actual, std::vector<int> &refs,
-                     std::vector<int> &derefs);
+                     std::vector<int> &derefs,
+                     std::vector<CommEdge> const &msgs);
 
 private:
+  int SeekTimestep(int sub_ts);
+
+  int TraceEnd();
+
+  int SetupWindow();
+
+  void MergeWindows();
+
+  // per policy: PolicyStats totals, then the window's LB counts
+  static constexpr int kNumWindowTotals = PolicyStats::kNumTotals + 2;
+
+  void CloseWindow(std::vector<double> &totals);
+
+  void SetMergedTotals(std::vector<double> const &merged,
+                       std::vector<std::pair<int, int>> &ts_counts);
+
+  int MergeStatsFiles(const char *policy_id, const char *suffix,
+                      int nwindows);
+
+  std::string WindowDir(int widx) const {
+    return options_.output_dir + "/window" + std::to_string(widx);
+  }
+
+  int StartWindow(int sub_ts);
+
+  int RunPrefetched(int sub_ts_beg);
+
+  int ReadMsgs(int sub_ts, std::vector<CommEdge> &msgs);
+
   int ReadTimestepInternal(int ts, int sub_ts, std::vector<int> &refs,
                            std::vector<int> &derefs,
                            std::vector<int> &assignments,
-                           std::vector<int> &times);
+                           std::vector<int> &times,
+                           std::vector<CommEdge> const &msgs);
 
-  void LogSummary();
+  void LogSummary(std::vector<std::pair<int, int>> const &ts_counts);
 
   BlockSimulatorOpts const options_;
 
-  RefinementReader ref_reader_;
-  AssignmentReader assign_reader_;
-  ProfSetReader prof_reader_;
+  std::unique_ptr<RefinementReader> ref_reader_;
+  std::unique_ptr<AssignmentReader> assign_reader_;
+  std::unique_ptr<ProfSetReader> prof_reader_;
+  std::unique_ptr<ColumnarTraceReader> col_reader_;
+  std::unique_ptr<MsgTraceReader> msg_reader_;
+  std::unique_ptr<CommModel> comm_model_;
 
   std::vector<int> ranklist_;
   int nblocks_next_expected_;
   int num_lb_;
 
+  int sub_ts_end_;      // replay stops here
+  int sub_ts_win_beg_;  // window_replay: first sub_ts of this window
+  int sub_ts_log_beg_;  // stats are logged from here on
+  int stats_ts_beg_;    // stats numbering of sub_ts_log_beg_
+  std::string stats_dir_;
+  // per-policy (succeeded, invoked) LB counts at sub_ts_win_beg_, empty
+  // until the window's first timestep is replayed
+  std::vector<std::pair<int, int>> ts_counts_beg_;
+  // window_replay: placements have caught up with a serial replay's, as
+  // the warmup had a mesh change (or there was no warmup to begin with)
+  bool warmup_refined_;
+
   std::vector<PolicyExecCtx> policies_;
   std::vector<PolicyStats> stats_;
+  std::unique_ptr<ThreadPool> policy_pool_;
+
+  friend class MiscTest;
 };
 } // namespace amr
@@ -7,7 +7,13 @@
 amr::BlockSimulatorOpts options;
 
 void PrintHelp(int argc, char* argv[]) {
-  fprintf(stderr, "\n\tUsage: %s -p <profile_dir>\n", argv[0]);
+  fprintf(stderr, "\n\tUsage: %s -p <profile_dir> [-d <mesh_ndims>] "
+          "[-f <prefetch_depth>] [-j <prof_files_at_once>] "
+          "[-t <columnar_trace>] [-w <sub_ts_beg>,<sub_ts_end>] "
+          "[-P <policy_threads>] [-W <window_warmup_ts>] [-B] [-m]\n"
+          "\tUnder mpirun, each rank replays one window of the range\n"
+          "\t-m prices the message trace (msgs.<rank>.bin) per policy\n",
+          argv[0]);
   exit(-1);
 }
 
@@ -36,21 +42,50 @@ void ParseOptions(int argc, char* argv[]) {
   options.nranks = -1;
   options.nblocks = -1;
   options.nts_toskip = 0;
-
-  while ((c = getopt(argc, argv, "b:c:e:hn:p:r:s:")) != -1) {
+  options.sub_ts_beg = 0;
+  options.ndims = 2;
+  options.prefetch_depth = 2;
+  options.prof_read_concurrency = 4;
+  options.binary_stats = false;
+  options.policy_threads = amr::ThreadPool::DefaultNumThreads();
+  options.warmup_ts = 100;
+  options.comm_model = false;
+
+  while ((c = getopt(argc, argv, "BP:W:b:c:d:e:f:hj:mn:p:r:s:t:w:")) != -1) {
     switch (c) {
+      case 'B':
+        options.binary_stats = true;
+        break;
+      case 'P':
+        options.policy_threads = atoi(optarg);
+        break;
+      case 'W':
+        options.warmup_ts = atoi(optarg);
+        break;
       case 'b':
         options.nblocks = atoi(optarg);
         break;
       case 'c':
         options.prof_time_combine_policy = optarg;
         break;
+      case 'd':
+        options.ndims = atoi(optarg);
+        break;
       case 'e':
         ParseCsvStr(optarg, options.events);
         break;
+      case 'f':
+        options.prefetch_depth = atoi(optarg);
+        break;
       case 'h':
         PrintHelp(argc, argv);
         break;
+      case 'j':
+        options.prof_read_concurrency = atoi(optarg);
+        break;
+      case 'm':
+        options.comm_model = true;
+        break;
       case 'n':
         options.nts = atoi(optarg);
         break;
@@ -63,6 +98,15 @@ void ParseOptions(int argc, char* argv[]) {
       case 's':
         options.nts_toskip = atoi(optarg);
         break;
+      case 't':
+        options.trace_path = optarg;
+        break;
+      case 'w':
+        // window: <beg>,<end>
+        if (sscanf(optarg, "%d,%d", &options.sub_ts_beg, &options.nts) != 2) {
+          PrintHelp(argc, argv);
+        }
+        break;
     }
   }
 
@@ -84,6 +128,11 @@ void ParseOptions(int argc, char* argv[]) {
     PrintHelp(argc, argv);
   }
 
+  if (options.ndims < 1 or options.ndims > 3) {
+    MLOG(MLOG_ERRO, "mesh_ndims must be 1, 2 or 3!");
+    PrintHelp(argc, argv);
+  }
+
   if (options.nranks < 0) {
     MLOG(MLOG_ERRO, "No nranks_ specified!");
     PrintHelp(argc, argv);
@@ -92,9 +141,9 @@ void ParseOptions(int argc, char* argv[]) {
   options.output_dir = options.prof_dir + "/block_sim";
 
   MLOG(MLOG_INFO,
-       "[Initial Parameters] nranks_=%d, nblocks=%d, nts=%d\n"
+       "[Initial Parameters] nranks_=%d, nblocks=%d, sub_ts=[%d, %d)\n"
        "output_dir=%s",
-       options.nranks, options.nblocks, options.nts,
+       options.nranks, options.nblocks, options.sub_ts_beg, options.nts,
        options.output_dir.c_str());
 }
 
@@ -104,7 +153,16 @@ void Run() {
 }
 
 int main(int argc, char* argv[]) {
+  MPI_Init(&argc, &argv);
   ParseOptions(argc, argv);
+
+  int nranks;
+  MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+  options.window_replay = (nranks > 1);
+  options.comm = MPI_COMM_WORLD;
+
   Run();
+
+  MPI_Finalize();
   return 0;
 }
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace amr {
+//
+// BoundedQueue: single-lock FIFO between a producer and a consumer thread.
+// Push blocks while the queue holds capacity items, Pop blocks while it is
+// empty. Close wakes both sides: Push then drops its item, and Pop drains
+// what is left before failing.
+//
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(int capacity)
+      : capacity_(capacity > 0 ? capacity : 1), closed_(false) {}
+
+  bool Push(T&& item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_not_full_.wait(lock,
+                      [this] { return closed_ or items_.size() < capacity_; });
+    if (closed_) return false;
+
+    items_.push_back(std::move(item));
+    cv_not_empty_.notify_one();
+    return true;
+  }
+
+  bool Pop(T& item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_not_empty_.wait(lock, [this] { return closed_ or not items_.empty(); });
+    if (items_.empty()) return false;
+
+    item = std::move(items_.front());
+    items_.pop_front();
+    cv_not_full_.notify_one();
+    return true;
+  }
+
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    cv_not_full_.notify_all();
+    cv_not_empty_.notify_all();
+  }
+
+ private:
+  const size_t capacity_;
+  bool closed_;
+  std::deque<T> items_;
+  std::mutex mutex_;
+  std::condition_variable cv_not_full_;
+  std::condition_variable cv_not_empty_;
+};
+}  // namespace amr
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "reader_base.h"
+#include "tools-common/logging.h"
+
+namespace amr {
+// CommEdge: one message of the trace, from a block to a neighbor block
+struct CommEdge {
+  int block_id;
+  int nbr_id;
+  int bytes;
+};
+
+// TimestepTrace: everything read from the traces for one sub-timestep.
+// msgs are only read for the comm model (see msg_trace.h), and are not
+// part of the columnar trace
+struct TimestepTrace {
+  int ts;
+  int sub_ts;
+  std::vector<int> refs;
+  std::vector<int> derefs;
+  std::vector<int> assignments;
+  std::vector<int> times;
+  std::vector<CommEdge> msgs;
+};
+
+//
+// Columnar trace: refinements, assignments and profile times of a run in
+// one file, one record per sub-timestep, plus an index to seek by sub_ts.
+//
+// Layout (little-endian):
+// - header: magic[8], u32 version, u32 reserved, u64 nts, u64 index_off
+// - records: varints ts, sub_ts, nblocks, nrefs, nderefs, then columns
+//   refs, derefs, assignments and times. Each column is zigzag varints of
+//   the delta from the previous value (0 for the first), so sorted block
+//   ids and runs of ranks take a byte each
+// - index at index_off: nts x {i32 sub_ts, i32 ts, u64 record_off},
+//   sorted by sub_ts
+//
+// Times are integer microseconds, so varints are lossless and smaller
+// than float32 for all realistic costs.
+//
+class ColumnarTrace {
+ public:
+  static constexpr size_t kMagicBytes = 8;
+  static constexpr uint32_t kVersion = 1;
+  static constexpr size_t kHeaderBytes = 32;
+  static constexpr size_t kIndexEntryBytes = 16;
+
+  static const char* Magic() { return "AMRTRC\0\0"; }
+
+  struct IndexEntry {
+    int32_t sub_ts;
+    int32_t ts;
+    uint64_t offset;
+  };
+
+  static void PutVarint(std::string& buf, uint64_t v) {
+    while (v >= 0x80) {
+      buf.push_back(static_cast<char>(v | 0x80));
+      v >>= 7;
+    }
+    buf.push_back(static_cast<char>(v));
+  }
+
+  // GetVarint: false if the varint runs past end
+  static bool GetVarint(const char*& p, const char* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 and p < end; shift += 7) {
+      uint8_t byte = *p++;
+      v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+  }
+
+  static uint64_t ZigZag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+  }
+
+  static int64_t UnZigZag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+  }
+
+  static void PutColumn(std::string& buf, std::vector<int> const& v) {
+    int64_t prev = 0;
+    for (int x : v) {
+      PutVarint(buf, ZigZag(x - prev));
+      prev = x;
+    }
+  }
+
+  static bool GetColumn(const char*& p, const char* end, int n,
+                        std::vector<int>& v) {
+    v.resize(n);
+    int64_t prev = 0;
+    for (int i = 0; i < n; i++) {
+      uint64_t delta;
+      if (not GetVarint(p, end, delta)) return false;
+      prev += UnZigZag(delta);
+      v[i] = static_cast<int>(prev);
+    }
+    return true;
+  }
+};
+
+//
+// ColumnarTraceWriter: appends records in sub_ts order; Close writes the
+// index and patches the header. Returns follow the readers: 0 ok, -1 error
+//
+class ColumnarTraceWriter {
+ public:
+  explicit ColumnarTraceWriter(std::string fpath)
+      : fpath_(std::move(fpath)), fd_(nullptr), offset_(0) {
+    fd_ = fopen(fpath_.c_str(), "wb");
+    if (fd_ == nullptr) {
+      MLOG(MLOG_ERRO, "Unable to open file: %s\n", fpath_.c_str());
+      ABORT("Unable to open file");
+    }
+
+    // placeholder, patched by Close
+    std::string header(ColumnarTrace::kHeaderBytes, '\0');
+    WriteBytes(header);
+  }
+
+  ColumnarTraceWriter(const ColumnarTraceWriter& other) = delete;
+
+  ~ColumnarTraceWriter() { Close(); }
+
+  int Append(TimestepTrace const& trace) {
+    if (fd_ == nullptr) return -1;
+
+    if (not index_.empty() and trace.sub_ts <= index_.back().sub_ts) {
+      MLOG(MLOG_ERRO, "[ColumnarTrace] sub_ts out of order: %d after %d",
+           trace.sub_ts, index_.back().sub_ts);
+      return -1;
+    }
+
+    index_.push_back({trace.sub_ts, trace.ts, offset_});
+
+    buf_.clear();
+    ColumnarTrace::PutVarint(buf_, ColumnarTrace::ZigZag(trace.ts));
+    ColumnarTrace::PutVarint(buf_, ColumnarTrace::ZigZag(trace.sub_ts));
+    ColumnarTrace::PutVarint(buf_, trace.assignments.size());
+    ColumnarTrace::PutVarint(buf_, trace.refs.size());
+    ColumnarTrace::PutVarint(buf_, trace.derefs.size());
+    ColumnarTrace::PutColumn(buf_, trace.refs);
+    ColumnarTrace::PutColumn(buf_, trace.derefs);
+    ColumnarTrace::PutColumn(buf_, trace.assignments);
+
+    // times are sized to the assignments
+    std::vector<int> const& times = trace.times;
+    if (times.size() == trace.assignments.size()) {
+      ColumnarTrace::PutColumn(buf_, times);
+    } else {
+      std::vector<int> times_fit(times);
+      times_fit.resize(trace.assignments.size(), 1);
+      ColumnarTrace::PutColumn(buf_, times_fit);
+    }
+
+    return WriteBytes(buf_);
+  }
+
+  int Close() {
+    if (fd_ == nullptr) return 0;
+
+    uint64_t index_off = offset_;
+    buf_.clear();
+    for (auto const& e : index_) {
+      AppendRaw(buf_, e.sub_ts);
+      AppendRaw(buf_, e.ts);
+      AppendRaw(buf_, e.offset);
+    }
+    int rv = WriteBytes(buf_);
+
+    buf_.assign(ColumnarTrace::Magic(), ColumnarTrace::kMagicBytes);
+    AppendRaw(buf_, ColumnarTrace::kVersion);
+    AppendRaw(buf_, uint32_t(0));
+    AppendRaw(buf_, static_cast<uint64_t>(index_.size()));
+    AppendRaw(buf_, index_off);
+    if (rv == 0 and fseek(fd_, 0, SEEK_SET) == 0) {
+      rv = fwrite(buf_.data(), 1, buf_.size(), fd_) == buf_.size() ? 0 : -1;
+    } else {
+      rv = -1;
+    }
+
+    if (fclose(fd_) != 0) rv = -1;
+    fd_ = nullptr;
+
+    if (rv) MLOG(MLOG_ERRO, "Error writing file: %s\n", fpath_.c_str());
+    return rv;
+  }
+
+  uint64_t BytesWritten() const { return offset_; }
+
+ private:
+  template <typename T>
+  static void AppendRaw(std::string& buf, T v) {
+    buf.append(reinterpret_cast<const char*>(&v), sizeof(T));
+  }
+
+  int WriteBytes(std::string const& bytes) {
+    if (fwrite(bytes.data(), 1, bytes.size(), fd_) != bytes.size()) {
+      MLOG(MLOG_ERRO, "Error writing file: %s\n", fpath_.c_str());
+      return -1;
+    }
+    offset_ += bytes.size();
+    return 0;
+  }
+
+  std::string const fpath_;
+  FILE* fd_;
+  uint64_t offset_;
+  std::string buf_;
+  std::vector<ColumnarTrace::IndexEntry> index_;
+};
+
+//
+// ColumnarTraceReader: random access to the records of a columnar trace,
+// by sub_ts. Returns: 1 read, 0 sub_ts not in the trace, -1 corrupt
+//
+class ColumnarTraceReader : public MmapReaderBase {
+ public:
+  explicit ColumnarTraceReader(std::string fpath)
+      : MmapReaderBase(std::move(fpath)), nts_(0), index_(nullptr) {
+    const char* data = Data();
+    uint64_t index_off = 0;
+
+    bool valid = Size() >= ColumnarTrace::kHeaderBytes and
+                 memcmp(data, ColumnarTrace::Magic(),
+                        ColumnarTrace::kMagicBytes) == 0;
+    if (valid) {
+      uint32_t version;
+      memcpy(&version, data + 8, sizeof(version));
+      memcpy(&nts_, data + 16, sizeof(nts_));
+      memcpy(&index_off, data + 24, sizeof(index_off));
+      valid = version == ColumnarTrace::kVersion and index_off <= Size() and
+              (Size() - index_off) / ColumnarTrace::kIndexEntryBytes >= nts_;
+    }
+
+    if (not valid) {
+      MLOG(MLOG_ERRO, "Not a columnar trace: %s\n", fpath_.c_str());
+      ABORT("Not a columnar trace");
+    }
+
+    index_ = data + index_off;
+  }
+
+  int NumTimesteps() const { return nts_; }
+
+  // SubTsRange: first and last sub_ts in the trace; false if empty
+  bool SubTsRange(int& sub_ts_beg, int& sub_ts_end) const {
+    if (nts_ == 0) return false;
+    sub_ts_beg = GetIndexEntry(0).sub_ts;
+    sub_ts_end = GetIndexEntry(nts_ - 1).sub_ts;
+    return true;
+  }
+
+  int ReadTimestep(int sub_ts, TimestepTrace& trace) const {
+    // binary search over the index
+    uint64_t lo = 0, hi = nts_;
+    while (lo < hi) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      if (GetIndexEntry(mid).sub_ts < sub_ts) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+
+    if (lo == nts_) return 0;
+    auto entry = GetIndexEntry(lo);
+    if (entry.sub_ts != sub_ts) return 0;
+
+    return DecodeRecord(entry.offset, trace);
+  }
+
+ private:
+  ColumnarTrace::IndexEntry GetIndexEntry(uint64_t i) const {
+    ColumnarTrace::IndexEntry e;
+    const char* p = index_ + i * ColumnarTrace::kIndexEntryBytes;
+    memcpy(&e.sub_ts, p, 4);
+    memcpy(&e.ts, p + 4, 4);
+    memcpy(&e.offset, p + 8, 8);
+    return e;
+  }
+
+  int DecodeRecord(uint64_t offset, TimestepTrace& trace) const {
+    const char* p = Data() + offset;
+    const char* end = index_;
+    if (p >= end) return Corrupt(offset);
+
+    uint64_t hdr[5];
+    for (auto& v : hdr) {
+      if (not ColumnarTrace::GetVarint(p, end, v)) return Corrupt(offset);
+    }
+
+    // each element takes at least a byte
+    uint64_t nelems = 2 * hdr[2] + hdr[3] + hdr[4];
+    if (hdr[2] > INT_MAX or nelems > static_cast<uint64_t>(end - p)) {
+      return Corrupt(offset);
+    }
+
+    trace.ts = ColumnarTrace::UnZigZag(hdr[0]);
+    trace.sub_ts = ColumnarTrace::UnZigZag(hdr[1]);
+    int nblocks = hdr[2];
+
+    bool ok = ColumnarTrace::GetColumn(p, end, hdr[3], trace.refs) and
+              ColumnarTrace::GetColumn(p, end, hdr[4], trace.derefs) and
+              ColumnarTrace::GetColumn(p, end, nblocks, trace.assignments) and
+              ColumnarTrace::GetColumn(p, end, nblocks, trace.times);
+
+    return ok ? 1 : Corrupt(offset);
+  }
+
+  int Corrupt(uint64_t offset) const {
+    MLOG(MLOG_ERRO, "[ColumnarTrace] Corrupt record at %lu: %s\n",
+         static_cast<unsigned long>(offset), fpath_.c_str());
+    return -1;
+  }
+
+  uint64_t nts_;
+  const char* index_;
+};
+}  // namespace amr
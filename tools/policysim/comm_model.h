@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "columnar_trace.h"
+#include "lb-common/constants.h"
+
+namespace amr {
+//
+// CommModelOpts: alpha-beta parameters, for messages between ranks on the
+// same node and on different nodes. Bandwidths are in GB/s
+//
+struct CommModelOpts {
+  int ranks_per_node;
+  double intra_alpha_us;
+  double intra_gbps;
+  double inter_alpha_us;
+  double inter_gbps;
+
+  CommModelOpts()
+      : ranks_per_node(Constants::kRanksPerNode),
+        intra_alpha_us(0.5),
+        intra_gbps(10.0),
+        inter_alpha_us(2.0),
+        inter_gbps(12.5) {}
+};
+
+// CommCost: the communication of one timestep under a placement
+struct CommCost {
+  int64_t off_rank_bytes;
+  int64_t off_node_bytes;
+  std::vector<double> rank_times;  // us, per sending rank
+  double max_time_us;
+};
+
+//
+// CommModel: prices the message trace of a timestep under a placement.
+// Messages between blocks on the same rank are free; every other message
+// costs its sender alpha + bytes / bandwidth, with the intra- or
+// inter-node parameters. Ranks send concurrently, so the timestep's
+// communication time is that of the slowest rank.
+//
+class CommModel {
+ public:
+  explicit CommModel(CommModelOpts const& opts)
+      : ranks_per_node_(std::max(opts.ranks_per_node, 1)),
+        intra_alpha_us_(opts.intra_alpha_us),
+        intra_us_per_byte_(1e-3 / opts.intra_gbps),
+        inter_alpha_us_(opts.inter_alpha_us),
+        inter_us_per_byte_(1e-3 / opts.inter_gbps) {}
+
+  //
+  // Compute: msgs refer to blocks by their index in ranklist. Messages of
+  // blocks outside ranklist (a trace that disagrees with the placement)
+  // are ignored
+  //
+  void Compute(std::vector<CommEdge> const& msgs,
+               std::vector<int> const& ranklist, int nranks,
+               CommCost& cost) const {
+    cost.off_rank_bytes = 0;
+    cost.off_node_bytes = 0;
+    cost.rank_times.assign(nranks, 0);
+    cost.max_time_us = 0;
+
+    int nblocks = ranklist.size();
+
+    for (auto const& m : msgs) {
+      if (m.block_id < 0 or m.block_id >= nblocks or m.nbr_id < 0 or
+          m.nbr_id >= nblocks) {
+        continue;
+      }
+
+      int src = ranklist[m.block_id];
+      int dest = ranklist[m.nbr_id];
+      if (src == dest or src < 0 or src >= nranks) continue;
+
+      cost.off_rank_bytes += m.bytes;
+
+      double time_us;
+      if (src / ranks_per_node_ == dest / ranks_per_node_) {
+        time_us = intra_alpha_us_ + m.bytes * intra_us_per_byte_;
+      } else {
+        cost.off_node_bytes += m.bytes;
+        time_us = inter_alpha_us_ + m.bytes * inter_us_per_byte_;
+      }
+
+      cost.rank_times[src] += time_us;
+    }
+
+    for (auto t : cost.rank_times) {
+      cost.max_time_us = std::max(cost.max_time_us, t);
+    }
+  }
+
+ private:
+  const int ranks_per_node_;
+  const double intra_alpha_us_;
+  const double intra_us_per_byte_;
+  const double inter_alpha_us_;
+  const double inter_us_per_byte_;
+};
+}  // namespace amr
@@ -43,6 +43,9 @@ public:
     cache_[nblocks] = std::make_pair(ts, cost);
   }
 
+  // Clear: drop all cached costs, keeping the request counts
+  void Clear() { cache_.clear(); }
+
   void LogStats() const {
     if (req_cnt_ == 0)
       return;
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "lb-common/policy_utils.h"
+
+namespace amr {
+//
+// CostPredictor: per-block cost forecasts that follow blocks through
+// refinement. Each block keeps a Holt-style level and trend, and an EWMA
+// of its squared forecast error. On refinement, children inherit their
+// parent's state; on derefinement, the merged block gets the mean of
+// its children's state (same rules as PolicyUtils::ExtrapolateCosts).
+//
+// Usage per timestep: Predict()/Variances() for the current block list,
+// then Observe() its actual costs, then Remap() with the timestep's
+// refs/derefs to move to the next block list.
+//
+class CostPredictor {
+ public:
+  explicit CostPredictor(int ndims = 2, double alpha = 0.3, double beta = 0.1)
+      : ndims_(ndims), alpha_(alpha), beta_(beta) {}
+
+  bool Empty() const { return level_.empty(); }
+
+  int NumBlocks() const { return level_.size(); }
+
+  void Observe(std::vector<double> const& costs) {
+    int nblocks = costs.size();
+
+    if (level_.size() != nblocks) {
+      // first observation, or the block list went out of sync: restart
+      level_ = costs;
+      trend_.assign(nblocks, 0);
+      var_.assign(nblocks, 0);
+      return;
+    }
+
+    for (int bidx = 0; bidx < nblocks; bidx++) {
+      double forecast = level_[bidx] + trend_[bidx];
+      double err = costs[bidx] - forecast;
+      double level = alpha_ * costs[bidx] + (1 - alpha_) * forecast;
+
+      trend_[bidx] = beta_ * (level - level_[bidx]) + (1 - beta_) * trend_[bidx];
+      level_[bidx] = level;
+      var_[bidx] = (1 - alpha_) * (var_[bidx] + alpha_ * err * err);
+    }
+  }
+
+  void Remap(std::vector<int> const& refs, std::vector<int> const& derefs) {
+    if (Empty() or (refs.empty() and derefs.empty())) return;
+
+    std::vector<double> remapped;
+    PolicyUtils::ExtrapolateCosts(ndims_, level_, refs, derefs, remapped);
+    level_.swap(remapped);
+    PolicyUtils::ExtrapolateCosts(ndims_, trend_, refs, derefs, remapped);
+    trend_.swap(remapped);
+    PolicyUtils::ExtrapolateCosts(ndims_, var_, refs, derefs, remapped);
+    var_.swap(remapped);
+  }
+
+  // Predict: one-step forecast for the current block list
+  void Predict(std::vector<double>& costs) const {
+    costs.resize(level_.size());
+    for (int bidx = 0; bidx < level_.size(); bidx++) {
+      costs[bidx] = std::max(level_[bidx] + trend_[bidx], 0.0);
+    }
+  }
+
+  // Variances: expected squared error of Predict, per block
+  void Variances(std::vector<double>& vars) const { vars = var_; }
+
+ private:
+  int ndims_;
+  double alpha_;  // level smoothing
+  double beta_;   // trend smoothing
+
+  std::vector<double> level_;
+  std::vector<double> trend_;
+  std::vector<double> var_;
+};
+}  // namespace amr
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "reader_base.h"
+#include "tools-common/logging.h"
+#include "tools-common/thread_pool.h"
+#include "trace_index.h"
+
+namespace amr {
+//
+// CSVRowParser: rows of ncols comma-separated integers, parsed from an
+// mmap-ed file. The file is consumed in batches; each batch is split into
+// newline-aligned chunks that are parsed on the pool, and rows are handed
+// out in file order. Blank lines are skipped; malformed lines are
+// skipped with a warning.
+//
+class CSVRowParser : public MmapReaderBase {
+ public:
+  CSVRowParser(std::string fpath, int ncols, ThreadPool* pool)
+      : MmapReaderBase(std::move(fpath)),
+        ncols_(ncols),
+        pool_(pool),
+        cursor_(0),
+        chunk_idx_(0),
+        row_idx_(0),
+        nbad_(0) {}
+
+  // SkipLine: skip the rest of the current line (e.g. a header)
+  void SkipLine() {
+    if (cursor_ >= Size()) return;
+
+    const char* data = Data();
+    const char* nl = static_cast<const char*>(
+        memchr(data + cursor_, '\n', Size() - cursor_));
+    cursor_ = nl ? nl - data + 1 : Size();
+  }
+
+  // Next: the next row, or nullptr at the end of the file
+  const int* Next() {
+    while (chunk_idx_ == chunks_.size() or
+           row_idx_ == chunks_[chunk_idx_].size()) {
+      if (chunk_idx_ < chunks_.size()) {
+        chunk_idx_++;
+        row_idx_ = 0;
+        continue;
+      }
+
+      if (cursor_ >= Size()) return nullptr;
+      ParseBatch();
+    }
+
+    const int* row = chunks_[chunk_idx_].data() + row_idx_;
+    row_idx_ += ncols_;
+    return row;
+  }
+
+  // ParseInt: optional sign and decimal digits, with surrounding blanks
+  static bool ParseInt(const char*& p, const char* end, int& v) {
+    while (p < end and (*p == ' ' or *p == '\t')) p++;
+
+    bool neg = (p < end and *p == '-');
+    if (p < end and (*p == '-' or *p == '+')) p++;
+
+    if (p == end or *p < '0' or *p > '9') return false;
+
+    long long x = 0;
+    while (p < end and *p >= '0' and *p <= '9') {
+      x = x * 10 + (*p++ - '0');
+    }
+
+    while (p < end and (*p == ' ' or *p == '\t' or *p == '\r')) p++;
+
+    v = static_cast<int>(neg ? -x : x);
+    return true;
+  }
+
+  // ParseLine: one line, without its newline, into row[0..ncols).
+  // Returns 1 for a row, 0 for a blank line, -1 if malformed
+  static int ParseLine(const char* p, const char* eol, int ncols, int* row) {
+    while (p < eol and (*p == ' ' or *p == '\t' or *p == '\r')) p++;
+    if (p == eol) return 0;
+
+    for (int col = 0; col < ncols; col++) {
+      if (not ParseInt(p, eol, row[col])) return -1;
+      if (col < ncols - 1 and (p == eol or *p++ != ',')) return -1;
+    }
+
+    return p == eol ? 1 : -1;
+  }
+
+  // ParseLines: parse all lines in [beg, end) into rows
+  static void ParseLines(const char* beg, const char* end, int ncols,
+                         std::vector<int>& rows, int& nbad) {
+    const char* line = beg;
+
+    while (line < end) {
+      const char* eol =
+          static_cast<const char*>(memchr(line, '\n', end - line));
+      if (eol == nullptr) eol = end;
+
+      size_t nrows_prev = rows.size();
+      rows.resize(nrows_prev + ncols);
+      int rv = ParseLine(line, eol, ncols, rows.data() + nrows_prev);
+      if (rv != 1) rows.resize(nrows_prev);
+      if (rv < 0) nbad++;
+
+      line = eol + 1;
+    }
+  }
+
+  //
+  // BuildIndex: offset of the first row of each run of equal values in
+  // column key_col, in file order. Lines that are not rows (the header)
+  // are skipped
+  //
+  int BuildIndex(int key_col, std::vector<TraceIndex::Entry>& entries) {
+    const char* data = Data();
+    const char* end = data + Size();
+    const char* line = data;
+    std::vector<int> row(ncols_);
+
+    while (line < end) {
+      const char* eol =
+          static_cast<const char*>(memchr(line, '\n', end - line));
+      if (eol == nullptr) eol = end;
+
+      if (ParseLine(line, eol, ncols_, row.data()) == 1 and
+          (entries.empty() or entries.back().sub_ts != row[key_col])) {
+        entries.push_back({row[key_col], static_cast<uint64_t>(line - data)});
+      }
+
+      line = eol + 1;
+    }
+
+    return 0;
+  }
+
+  // SeekTo: continue parsing from a line starting at offset
+  void SeekTo(size_t offset) {
+    cursor_ = std::min(offset, Size());
+    chunks_.clear();
+    chunk_idx_ = 0;
+    row_idx_ = 0;
+  }
+
+ private:
+  void ParseBatch() {
+    int nchunks = pool_ ? pool_->NumThreads() : 1;
+    const char* data = Data();
+
+    // chunk boundaries, advanced to just past a newline
+    std::vector<size_t> bounds(nchunks + 1);
+    bounds[0] = cursor_;
+    for (int i = 1; i <= nchunks; i++) {
+      size_t b = std::min(bounds[i - 1] + kChunkBytes, Size());
+      const char* nl =
+          static_cast<const char*>(memchr(data + b, '\n', Size() - b));
+      bounds[i] = (b == Size() or nl == nullptr) ? Size() : nl - data + 1;
+    }
+
+    chunks_.resize(nchunks);
+    std::vector<int> nbad(nchunks, 0);
+
+    auto parse = [&](int i) {
+      chunks_[i].clear();
+      ParseLines(data + bounds[i], data + bounds[i + 1], ncols_, chunks_[i],
+                 nbad[i]);
+    };
+
+    if (pool_) {
+      pool_->ParallelFor(nchunks, parse);
+    } else {
+      parse(0);
+    }
+
+    int nbad_batch = 0;
+    for (int n : nbad) nbad_batch += n;
+    if (nbad_batch) {
+      nbad_ += nbad_batch;
+      MLOG(MLOG_WARN, "[CSVRowParser] Skipped %ld malformed lines so far: %s",
+           static_cast<long>(nbad_), fpath_.c_str());
+    }
+
+    cursor_ = bounds[nchunks];
+    chunk_idx_ = 0;
+    row_idx_ = 0;
+  }
+
+  static constexpr size_t kChunkBytes = 4 << 20;
+
+  const int ncols_;
+  ThreadPool* const pool_;
+  size_t cursor_;  // start of the next batch
+
+  std::vector<std::vector<int>> chunks_;  // rows of the current batch
+  size_t chunk_idx_;
+  size_t row_idx_;
+  int64_t nbad_;
+};
+}  // namespace amr
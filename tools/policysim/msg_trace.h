@@ -0,0 +1,228 @@
+#pragma once
+
+#include <pdlfs-common/env.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "columnar_trace.h"
+#include "tools-common/logging.h"
+
+namespace amr {
+//
+// MsgLogReader: one msgs.<rank>.bin file of the amr-tau-plugin (see
+// MsgLog in amr_outputs.h). Per timestep: i32 ts, i32 channel_bytes,
+// channel records, i32 send_bytes, send records.
+//
+// A channel record {ptr[8], i32 block_id, rank, nbr_id, nbr_rank, tag,
+// i8 is_flux} is logged once, when the channel is set up, and a send
+// record {ptr[8], i32 buf_sz, recv_rank, tag, u64 timestamp} per message.
+// Sends are matched to channels by their buffer ptr, so channels are
+// tracked from the start of the file even if those timesteps are skipped.
+//
+class MsgLogReader {
+ public:
+  explicit MsgLogReader(std::string fpath)
+      : fpath_(std::move(fpath)),
+        fd_(nullptr),
+        has_rec_(false),
+        rec_ts_(-1),
+        nunmatched_(0) {
+    fd_ = fopen(fpath_.c_str(), "rb");
+    if (fd_ == nullptr) {
+      MLOG(MLOG_ERRO, "Unable to open file: %s\n", fpath_.c_str());
+      ABORT("Unable to open file");
+    }
+  }
+
+  MsgLogReader(const MsgLogReader& other) = delete;
+
+  ~MsgLogReader() {
+    if (fd_ != nullptr) {
+      fclose(fd_);
+      fd_ = nullptr;
+    }
+  }
+
+  //
+  // ReadTimestep: appends the messages sent in sub_ts to msgs. Earlier
+  // timesteps are skipped. Returns: 1 read, 0 no record for sub_ts, -1 error
+  //
+  int ReadTimestep(int sub_ts, std::vector<CommEdge>& msgs) {
+    while (true) {
+      if (not has_rec_) {
+        int rv = ReadRecord();
+        if (rv <= 0) return rv;
+      }
+
+      if (rec_ts_ > sub_ts) return 0;
+
+      ApplyChannels();
+      has_rec_ = false;
+
+      if (rec_ts_ == sub_ts) {
+        AppendSends(msgs);
+        return 1;
+      }
+    }
+  }
+
+  // sends that matched no channel, and were dropped
+  int64_t NumUnmatched() const { return nunmatched_; }
+
+  static constexpr size_t kChannelBytes = 8 + 5 * sizeof(int) + 1;
+  static constexpr size_t kSendBytes = 16 + 3 * sizeof(int);
+
+ private:
+  // ReadRecord: returns 1 read, 0 EOF, -1 error
+  int ReadRecord() {
+    int ts;
+    size_t nread = fread(&ts, sizeof(int), 1, fd_);
+    if (nread == 0 and feof(fd_)) return 0;
+
+    bool ok = nread == 1 and ReadBuf(chan_buf_, kChannelBytes) and
+              ReadBuf(send_buf_, kSendBytes);
+    if (not ok) {
+      MLOG(MLOG_ERRO, "Error reading file: %s\n", fpath_.c_str());
+      return -1;
+    }
+
+    rec_ts_ = ts;
+    has_rec_ = true;
+    return 1;
+  }
+
+  // ReadBuf: an i32 byte count, then that many bytes of recsz records
+  bool ReadBuf(std::vector<char>& buf, size_t recsz) {
+    int nbytes;
+    if (fread(&nbytes, sizeof(int), 1, fd_) != 1) return false;
+    if (nbytes < 0 or nbytes % recsz != 0) return false;
+
+    buf.resize(nbytes);
+    return fread(buf.data(), 1, nbytes, fd_) == static_cast<size_t>(nbytes);
+  }
+
+  void ApplyChannels() {
+    for (size_t off = 0; off < chan_buf_.size(); off += kChannelBytes) {
+      const char* rec = chan_buf_.data() + off;
+      uint64_t ptr;
+      int ints[5];  // block_id, rank, nbr_id, nbr_rank, tag
+      memcpy(&ptr, rec, 8);
+      memcpy(ints, rec + 8, sizeof(ints));
+      channels_[ptr] = std::make_pair(ints[0], ints[2]);
+    }
+  }
+
+  void AppendSends(std::vector<CommEdge>& msgs) {
+    for (size_t off = 0; off < send_buf_.size(); off += kSendBytes) {
+      const char* rec = send_buf_.data() + off;
+      uint64_t ptr;
+      int buf_sz;
+      memcpy(&ptr, rec, 8);
+      memcpy(&buf_sz, rec + 8, sizeof(int));
+
+      auto it = channels_.find(ptr);
+      if (it == channels_.end()) {
+        nunmatched_++;
+        continue;
+      }
+
+      msgs.push_back({it->second.first, it->second.second, buf_sz});
+    }
+  }
+
+  std::string const fpath_;
+  FILE* fd_;
+
+  // ptr -> (block_id, nbr_id)
+  std::unordered_map<uint64_t, std::pair<int, int>> channels_;
+
+  // the last record read; consumed once has_rec_ is cleared
+  bool has_rec_;
+  int rec_ts_;
+  std::vector<char> chan_buf_;
+  std::vector<char> send_buf_;
+
+  int64_t nunmatched_;
+};
+
+//
+// MsgTraceReader: the message trace of all ranks, from msgs.<rank>.bin
+// files in <prof_dir>/msgs (the plugin's layout) or in prof_dir itself.
+// Timesteps are tracer timesteps, which match the sub_ts of the other
+// traces. Files are read sequentially, so a replay that starts late
+// scans all earlier records once.
+//
+class MsgTraceReader {
+ public:
+  MsgTraceReader(pdlfs::Env* env, std::string const& prof_dir) {
+    std::vector<std::string> fpaths = LocateMsgFiles(env, prof_dir + "/msgs");
+    if (fpaths.empty()) fpaths = LocateMsgFiles(env, prof_dir);
+    if (fpaths.empty()) {
+      ABORT("no msgs.<rank>.bin files found!");
+    }
+
+    MLOG(MLOG_INFO, "[MsgTraceReader] Reading %zu message logs",
+         fpaths.size());
+    for (auto& fpath : fpaths) {
+      readers_.emplace_back(new MsgLogReader(fpath));
+    }
+  }
+
+  ~MsgTraceReader() {
+    int64_t nunmatched = 0;
+    for (auto& reader : readers_) nunmatched += reader->NumUnmatched();
+    if (nunmatched) {
+      MLOG(MLOG_WARN, "[MsgTraceReader] %ld sends matched no channel",
+           static_cast<long>(nunmatched));
+    }
+  }
+
+  // ReadTimestep: returns 1 if any rank logged sub_ts, 0 if none, -1 error
+  int ReadTimestep(int sub_ts, std::vector<CommEdge>& msgs) {
+    msgs.clear();
+    int nfound = 0;
+
+    for (auto& reader : readers_) {
+      int rv = reader->ReadTimestep(sub_ts, msgs);
+      if (rv < 0) return rv;
+      nfound += rv;
+    }
+
+    return nfound > 0 ? 1 : 0;
+  }
+
+  // LocateMsgFiles: msgs.<rank>.bin files in dir, in rank order
+  static std::vector<std::string> LocateMsgFiles(pdlfs::Env* env,
+                                                 std::string const& dir) {
+    std::vector<std::string> all_files;
+    env->GetChildren(dir.c_str(), &all_files);
+
+    const std::regex regex_obj(R"(msgs\.(\d+)\.bin)");
+    std::vector<std::pair<int, std::string>> matches;
+    for (auto& f : all_files) {
+      std::smatch match_obj;
+      if (std::regex_match(f, match_obj, regex_obj)) {
+        matches.emplace_back(std::stoi(match_obj[1].str()), dir + "/" + f);
+      }
+    }
+
+    std::sort(matches.begin(), matches.end());
+
+    std::vector<std::string> fpaths;
+    for (auto& m : matches) fpaths.push_back(m.second);
+    return fpaths;
+  }
+
+ private:
+  std::vector<std::unique_ptr<MsgLogReader>> readers_;
+};
+}  // namespace amr
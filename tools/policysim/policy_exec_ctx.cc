@@ -7,6 +7,15 @@
 #include "lb-common/policy.h"
 #include "lb-common/policy_wopts.h"
 
+namespace {
+amr::lb::LBTriggerOpts GetTriggerOpts(amr::PolicyExecOpts const& opts) {
+  amr::lb::LBTriggerOpts trigger_opts;
+  trigger_opts.migration_cost = opts.migration_cost;
+  trigger_opts.horizon = opts.trigger_horizon;
+  return trigger_opts;
+}
+}  // namespace
+
 namespace amr {
 
 PolicyExecCtx::PolicyExecCtx(PolicyExecOpts& opts)
@@ -18,7 +27,11 @@ PolicyExecCtx::PolicyExecCtx(PolicyExecOpts& opts)
       ts_lb_invoked_(0),
       ts_lb_succeeded_(0),
       ts_since_last_lb_(0),
-      cost_cache_(opts_.cache_ttl) {
+      cost_cache_(opts_.cache_ttl),
+      lb_trigger_(GetTriggerOpts(opts_)),
+      policy_state_(new PolicyState()) {
+  lb_state_.predictor = CostPredictor(opts_.mesh_ndims, opts_.cost_ewma_alpha,
+                                      opts_.cost_trend_beta);
   Bootstrap();
 }
 
@@ -42,6 +55,27 @@ void PolicyExecCtx::Bootstrap() {
        opts_.nblocks_init, lb_state_.ranklist.size());
 }
 
+void PolicyExecCtx::Bootstrap(int ts, std::vector<int> const& ranklist) {
+  ts_ = ts;
+  lb_state_.ranklist = ranklist;
+  lb_state_.costlist_prev = std::vector<double>(ranklist.size(), 1.0);
+  lb_state_.refs.clear();
+  lb_state_.derefs.clear();
+
+  // history from before ts is unknown: start it over rather than carry
+  // over whatever was observed elsewhere in the trace
+  lb_state_.predictor = CostPredictor(opts_.mesh_ndims, opts_.cost_ewma_alpha,
+                                      opts_.cost_trend_beta);
+  cost_cache_.Clear();
+  lb_trigger_.Reset();
+  policy_state_.reset(new PolicyState());
+  ts_since_last_lb_ = 0;
+
+  MLOG(MLOG_DBG2,
+       "[PolicyExecCtx] Bootstrapping at ts %d. Num Blocks: %zu", ts,
+       ranklist.size());
+}
+
 int PolicyExecCtx::ExecuteTimestep(std::vector<double> const& costlist_oracle,
                                    std::vector<int> const& ranklist_actual,
                                    std::vector<int>& refs,
@@ -51,10 +85,20 @@ int PolicyExecCtx::ExecuteTimestep(std::vector<double> const& costlist_oracle,
 
   assert(lb_state_.costlist_prev.size() == lb_state_.ranklist.size());
 
+  std::vector<double> costlist_lb;
   bool trigger_lb = ComputeLBTrigger(opts_.trigger_policy, lb_state_);
-  if (trigger_lb) {
-    std::vector<double> costlist_lb;
+
+  if (not trigger_lb and
+      opts_.trigger_policy == TriggerPolicy::kCostBenefit) {
     ComputeCosts(ts_, costlist_oracle, costlist_lb);
+    trigger_lb = lb_trigger_.ShouldTrigger(costlist_lb, lb_state_.ranklist,
+                                           opts_.nranks);
+  }
+
+  if (trigger_lb) {
+    if (costlist_lb.empty()) {
+      ComputeCosts(ts_, costlist_oracle, costlist_lb);
+    }
     rv = TriggerLB(costlist_lb, exec_time);
     if (rv) {
       MLOG(MLOG_WARN, "[PolicyExecCtx] TriggerLB failed!");
@@ -74,6 +118,10 @@ int PolicyExecCtx::ExecuteTimestep(std::vector<double> const& costlist_oracle,
          lb_state_.ranklist.size());
   }
 
+  // predictor moves on to the next block list along with the state
+  lb_state_.predictor.Observe(costlist_oracle);
+  lb_state_.predictor.Remap(refs, derefs);
+
   lb_state_.costlist_prev = costlist_oracle;
   lb_state_.refs = refs;
   lb_state_.derefs = derefs;
@@ -89,16 +137,52 @@ int PolicyExecCtx::TriggerLB(const std::vector<double>& costlist,
 
   ts_lb_invoked_++;
 
+  // robust policies get variances from the cost history, the cache
+  // keys on costs alone, so they bypass it
+  std::vector<double> cost_vars;
+  bool robust = (policy_.policy == LoadBalancePolicy::kPolicyRobust);
+  if (robust and lb_state_.predictor.NumBlocks() == costlist.size()) {
+    lb_state_.predictor.Variances(cost_vars);
+  } else {
+    cost_vars.assign(costlist.size(), 0);
+  }
+
   uint64_t lb_beg = pdlfs::Env::NowMicros();
-  rv = LoadBalancePolicies::AssignBlocksCached(opts_.policy_id, costlist,
-                                               ranklist_lb, opts_.nranks);
+  rv = LoadBalancePolicies::AssignBlocksCached(
+      opts_.policy_id, costlist, ranklist_lb, opts_.nranks, 0, MPI_COMM_NULL,
+      &lb_state_.telemetry, policy_state_.get(), &cost_vars);
   uint64_t lb_end = pdlfs::Env::NowMicros();
 
   if (rv) return rv;
 
+  // MLOG_DBG0 logs via VLOG(0): skip formatting the phases if it is off
+  if (VLOG_IS_ON(0)) {
+    auto const& t = lb_state_.telemetry;
+    std::string phases;
+    for (auto const& kv : t.phase_ms) {
+      phases += kv.first + ": " + std::to_string(kv.second) + " ms, ";
+    }
+    MLOG(MLOG_DBG0,
+         "[PolicyExecCtx] LB %s: %.2lf ms (%s%d iters, %zu B, cache hit: %d), "
+         "imbalance: %.3lf",
+         t.policy.c_str(), t.total_ms, phases.c_str(), t.niters,
+         t.mem_hwm_bytes, t.cache_hit, t.eval.imbalance);
+  }
+
   ts_lb_succeeded_++;
   exec_time = (lb_end - lb_beg);
 
+  // migrations are only well-defined if the block list did not change
+  int nblocks_moved = -1;
+  if (lb_state_.ranklist.size() == ranklist_lb.size()) {
+    nblocks_moved = 0;
+    for (int bidx = 0; bidx < ranklist_lb.size(); bidx++) {
+      nblocks_moved += (ranklist_lb[bidx] != lb_state_.ranklist[bidx]);
+    }
+  }
+  lb_trigger_.RecordPlacement(costlist, ranklist_lb, opts_.nranks, exec_time,
+                              nblocks_moved);
+
   lb_state_.ranklist = ranklist_lb;
 
   assert(lb_state_.ranklist.size() == costlist.size());
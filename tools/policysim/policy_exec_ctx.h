@@ -6,10 +6,15 @@
 
 #include <pdlfs-common/env.h>
 
+#include <memory>
+
 #include "tools-common/logging.h"
 #include "cost_cache.h"
+#include "cost_predictor.h"
 #include "lb-common/policy_utils.h"
 #include "lb-common/policy_wopts.h"
+#include "amr_lb.h"
+#include "policy_state.h"
 
 namespace amr {
 
@@ -18,6 +23,9 @@ struct LoadBalanceState {
   std::vector<int> ranklist;
   std::vector<int> refs;
   std::vector<int> derefs;
+  // per-block cost history, remapped to the current block list
+  CostPredictor predictor;
+  lb::PlacementTelemetry telemetry;  // of the last LB invocation
 };
 
 class PolicyStats;
@@ -26,19 +34,30 @@ class PolicyExecCtx {
  public:
   PolicyExecCtx(PolicyExecOpts& opts);
 
+  // Bootstrap: restart at timestep ts from an observed placement, for
+  // replays that start mid-trace. Cost history, cached costs and
+  // placements, and the trigger's history all start empty
+  void Bootstrap(int ts, std::vector<int> const& ranklist);
+
   int ExecuteTimestep(std::vector<double> const& costlist_oracle,
                       std::vector<int> const& ranklist_actual,
                       std::vector<int>& refs, std::vector<int>& derefs,
                       double& exec_time);
 
-  static int GetNumBlocksNext(int nblocks, int nrefs, int nderefs) {
-    // int nblocks_next = nblocks + (nrefs * 7) - (nderefs * 7 / 8);
-    int nblocks_next = nblocks + (nrefs * 3) - (nderefs * 3 / 4);
-    return nblocks_next;
+  static int GetNumBlocksNext(int nblocks, int nrefs, int nderefs,
+                              int ndims = 2) {
+    return PolicyUtils::GetNumBlocksNext(ndims, nblocks, nrefs, nderefs);
+  }
+
+  static int GetNumBlocksNext(int nblocks, std::vector<int> const& refs,
+                              std::vector<int> const& derefs, int ndims = 2) {
+    return PolicyUtils::GetNumBlocksNext(ndims, nblocks, refs, derefs);
   }
 
   std::string Name() const { return policy_.name; }
 
+  const char* PolicyId() const { return opts_.policy_id; }
+
   bool IsActualPolicy() const {
     return policy_.policy == LoadBalancePolicy::kPolicyActual;
   }
@@ -60,9 +79,15 @@ class PolicyExecCtx {
  private:
   void Bootstrap();
 
+  //
+  // ComputeLBTrigger: mesh changes always trigger, as new blocks need ranks.
+  // kCostBenefit leaves all other timesteps to lb_trigger_
+  //
   bool ComputeLBTrigger(TriggerPolicy tp, LoadBalanceState& state) {
     bool ref_trig = !state.refs.empty() || !state.derefs.empty();
-    bool trig_intvl =
+    if (tp == TriggerPolicy::kCostBenefit) return ref_trig;
+
+    int trig_intvl =
         (tp == TriggerPolicy::kEveryTimestep) ? 1 : opts_.trigger_interval;
     bool ts_trig = (ts_ % trig_intvl == 0);
 
@@ -72,15 +97,15 @@ class PolicyExecCtx {
   void ComputeCosts(int ts, std::vector<double> const& costlist_oracle,
                     std::vector<double>& costlist_new) {
     int nblocks_cur =
-        GetNumBlocksNext(lb_state_.costlist_prev.size(), lb_state_.refs.size(),
-                         lb_state_.derefs.size());
+        GetNumBlocksNext(lb_state_.costlist_prev.size(), lb_state_.refs,
+                         lb_state_.derefs, opts_.mesh_ndims);
 
     if (use_cost_cache_ and cost_cache_.Get(ts, nblocks_cur, costlist_new)) {
       return;
     }
 
-    ComputeCostsInternal(opts_.cost_policy, lb_state_, costlist_oracle,
-                         costlist_new);
+    ComputeCostsInternal(opts_.cost_policy, opts_.mesh_ndims, lb_state_,
+                         costlist_oracle, costlist_new);
 
     if (use_cost_cache_) {
       cost_cache_.Put(ts, costlist_oracle);
@@ -89,12 +114,12 @@ class PolicyExecCtx {
     assert(costlist_new.size() == nblocks_cur);
   }
 
-  static void ComputeCostsInternal(CostEstimationPolicy cep,
+  static void ComputeCostsInternal(CostEstimationPolicy cep, int ndims,
                                    LoadBalanceState& state,
                                    std::vector<double> const& costlist_oracle,
                                    std::vector<double>& costlist_new) {
-    int nblocks_cur = GetNumBlocksNext(state.costlist_prev.size(),
-                                       state.refs.size(), state.derefs.size());
+    int nblocks_cur = GetNumBlocksNext(state.costlist_prev.size(), state.refs,
+                                       state.derefs, ndims);
 
     switch (cep) {
       case CostEstimationPolicy::kOracleCost:
@@ -103,11 +128,20 @@ class PolicyExecCtx {
       case CostEstimationPolicy::kUnitCost:
         costlist_new = std::vector<double>(nblocks_cur, 1.0);
         break;
+      case CostEstimationPolicy::kPredictedCost:
+        if (state.predictor.NumBlocks() == nblocks_cur) {
+          state.predictor.Predict(costlist_new);
+        } else {
+          // no history yet: extrapolate
+          PolicyUtils::ExtrapolateCosts(ndims, state.costlist_prev, state.refs,
+                                        state.derefs, costlist_new);
+        }
+        break;
       case CostEstimationPolicy::kExtrapolatedCost:
       case CostEstimationPolicy::kCachedExtrapolatedCost:
         // If both refs and derefs are empty, these should be the same
-        PolicyUtils::ExtrapolateCosts2D(state.costlist_prev, state.refs,
-                                        state.derefs, costlist_new);
+        PolicyUtils::ExtrapolateCosts(ndims, state.costlist_prev, state.refs,
+                                      state.derefs, costlist_new);
         break;
       default:
         ABORT("Not implemented!");
@@ -122,6 +156,11 @@ class PolicyExecCtx {
 
   LoadBalanceState lb_state_;
   CostCache cost_cache_;
+  lb::LBTrigger lb_trigger_;
+  // cache and autotuner of this policy alone, so policies can run at once.
+  // Policies that share a policy_id but estimate costs differently (the
+  // cdp variants) thus no longer reuse each other's cached placements
+  std::unique_ptr<PolicyState> policy_state_;
 
   int ts_;
   int ts_lb_invoked_;
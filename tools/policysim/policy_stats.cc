@@ -1,8 +1,11 @@
+#include <algorithm>
+
 #include "policy_stats.h"
 
 namespace amr {
 void PolicyStats::LogTimestep(std::vector<double> const& cost_actual,
-                              std::vector<int> const& rank_list, double exec_time_ts) {
+                              std::vector<int> const& rank_list, double exec_time_ts,
+                              std::vector<CommEdge> const& msgs) {
   exec_time_us_ += exec_time_ts;
 
   auto nranks = opts_.nranks;
@@ -18,10 +21,33 @@ void PolicyStats::LogTimestep(std::vector<double> const& cost_actual,
   total_cost_max_ += rtmax;
   locality_score_sum_ += PolicyUtils::ComputeLocCost(rank_list);
 
-  WriteSummary(fd_summ_, rtavg, rtmax);
-  WriteDetailed(fd_det_, cost_actual, rank_list);
-  WriteRankSums(fd_ranksum_, rank_times);
+  if (comm_model_) {
+    CommCost comm;
+    comm_model_->Compute(msgs, rank_list, nranks, comm);
+
+    double e2e_us = 0;
+    for (int r = 0; r < nranks; r++) {
+      e2e_us = std::max(e2e_us, rank_times[r] + comm.rank_times[r]);
+    }
+
+    off_rank_bytes_ += comm.off_rank_bytes;
+    off_node_bytes_ += comm.off_node_bytes;
+    comm_time_us_ += comm.max_time_us;
+    e2e_time_us_ += e2e_us;
+
+    WriteComm(*fd_comm_, ts_, comm, e2e_us);
+  }
+
+  if (fd_bin_) {
+    fd_bin_->LogTimestep(ts_, rtavg, rtmax, cost_actual, rank_list,
+                         rank_times);
+  } else {
+    WriteSummary(*fd_summ_, ts_, rtavg, rtmax);
+    WriteDetailed(*fd_det_, cost_actual, rank_list);
+    WriteRankSums(*fd_ranksum_, ts_, rank_times);
+  }
 
   ts_++;
+  nts_++;
 }
 }  // namespace amr
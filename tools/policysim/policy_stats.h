@@ -6,6 +6,10 @@
 
 #include <pdlfs-common/env.h>
 
+#include <memory>
+
+#include "binary_stats.h"
+#include "comm_model.h"
 #include "lb-common/policy_utils.h"
 #include "lb-common/tabular_data.h"
 #include "lb-common/writable_file.h"
@@ -49,6 +53,17 @@ class PolicyRow : public TableRow {
           }) {}
   // clang-format on
 
+  // AddComm: comm model columns, only with a message trace
+  void AddComm(double off_rank_bytes, double off_node_bytes,
+               double comm_time_us, double e2e_time_us) {
+    header.insert(header.end(),
+                  {"Off-Rank", "Off-Node", "Comm Time", "E2E Time"});
+    data.insert(data.end(), {FormatProp(off_rank_bytes / 1e9, "GB"),
+                             FormatProp(off_node_bytes / 1e9, "GB"),
+                             FormatProp(comm_time_us / 1e6, "s"),
+                             FormatProp(e2e_time_us / 1e6, "s")});
+  }
+
   std::vector<std::string> GetHeader() const override { return header; }
 
   std::vector<std::string> GetData() const override { return data; }
@@ -60,28 +75,112 @@ class PolicyRow : public TableRow {
   }
 };
 
+//
+// PolicyStats: per-timestep stats go to summ/det/ranksum text files, or,
+// with binary set, to one buffered binary file (see binary_stats.h) that
+// stats-convert turns back into the text files. ts_beg numbers the first
+// logged timestep, for replays that only cover part of a run.
+//
+// With a comm model, each timestep's message trace is also priced under
+// the policy's placement, and logged to a comm file: the end-to-end time
+// of a timestep is that of the rank slowest at compute plus communication
+//
 class PolicyStats {
  public:
-  PolicyStats(PolicyExecOpts& opts)
+  PolicyStats(PolicyExecOpts& opts, bool binary = false, int ts_beg = 0,
+              CommModel const* comm_model = nullptr)
       : opts_(opts),
-        ts_(0),
+        comm_model_(comm_model),
+        ts_(ts_beg),
+        nts_(0),
         excess_cost_(0),
         total_cost_avg_(0),
         total_cost_max_(0),
         locality_score_sum_(0),
         exec_time_us_(0),
-        fd_summ_(opts.env, LOG_PATH("summ")),
-        fd_det_(opts.env, LOG_PATH("det")),
-        fd_ranksum_(opts.env, LOG_PATH("ranksum")) {}
+        off_rank_bytes_(0),
+        off_node_bytes_(0),
+        comm_time_us_(0),
+        e2e_time_us_(0) {
+    if (comm_model_) {
+      fd_comm_.reset(new WritableFile(opts.env, LOG_PATH("comm")));
+    }
+
+    if (binary) {
+      fd_bin_.reset(new BinaryStatsWriter(opts.env, LOG_PATH("statsbin")));
+    } else {
+      fd_summ_.reset(new WritableFile(opts.env, LOG_PATH("summ")));
+      fd_det_.reset(new WritableFile(opts.env, LOG_PATH("det")));
+      fd_ranksum_.reset(new WritableFile(opts.env, LOG_PATH("ranksum")));
+    }
+  }
 
+  // msgs: the message trace of the timestep, ignored without a comm model
   void LogTimestep(std::vector<double> const& cost_actual,
-                   std::vector<int> const& rank_list, double exec_time_ts);
+                   std::vector<int> const& rank_list, double exec_time_ts,
+                   std::vector<CommEdge> const& msgs);
 
   std::shared_ptr<TableRow> GetTableRow(int ts_succeeded, int ts_invoked) {
-    return std::make_shared<PolicyRow>(
+    auto row = std::make_shared<PolicyRow>(
         opts_.policy_id, opts_.policy_name, opts_.cost_policy,
         opts_.trigger_policy, ts_succeeded, ts_invoked, excess_cost_,
-        total_cost_avg_, total_cost_max_, locality_score_sum_ / ts_, exec_time_us_);
+        total_cost_avg_, total_cost_max_, locality_score_sum_ / nts_, exec_time_us_);
+    if (comm_model_) {
+      row->AddComm(off_rank_bytes_, off_node_bytes_, comm_time_us_,
+                   e2e_time_us_);
+    }
+    return row;
+  }
+
+  // Totals: the sums behind GetTableRow, so that the stats of several
+  // replay windows can be added up (see BlockSimulator::MergeWindows)
+  static constexpr int kNumTotals = 10;
+
+  void GetTotals(double* totals) const {
+    totals[0] = nts_;
+    totals[1] = excess_cost_;
+    totals[2] = total_cost_avg_;
+    totals[3] = total_cost_max_;
+    totals[4] = locality_score_sum_;
+    totals[5] = exec_time_us_;
+    totals[6] = off_rank_bytes_;
+    totals[7] = off_node_bytes_;
+    totals[8] = comm_time_us_;
+    totals[9] = e2e_time_us_;
+  }
+
+  void SetTotals(double const* totals) {
+    nts_ = totals[0];
+    excess_cost_ = totals[1];
+    total_cost_avg_ = totals[2];
+    total_cost_max_ = totals[3];
+    locality_score_sum_ = totals[4];
+    exec_time_us_ = totals[5];
+    off_rank_bytes_ = totals[6];
+    off_node_bytes_ = totals[7];
+    comm_time_us_ = totals[8];
+    e2e_time_us_ = totals[9];
+  }
+
+  // Close: flush and close the stats files; nothing is logged after
+  void Close() {
+    fd_summ_.reset();
+    fd_det_.reset();
+    fd_ranksum_.reset();
+    fd_bin_.reset();
+    fd_comm_.reset();
+  }
+
+  // Suffixes of the stats files, binary or not, with a comm model or not
+  static std::vector<std::string> FileSuffixes(bool binary, bool comm) {
+    std::vector<std::string> suffixes;
+    if (binary) {
+      suffixes = {"statsbin"};
+    } else {
+      suffixes = {"summ", "det", "ranksum"};
+    }
+    if (comm) suffixes.push_back("comm");
+    return suffixes;
   }
 
   static std::string FormatProp(double prop, const char* suffix) {
@@ -90,15 +189,30 @@ class PolicyStats {
     return {buf};
   }
 
- private:
-  void WriteSummary(WritableFile& fd, double avg, double max) const {
-    if (ts_ == 0) {
+  // Text formats, also used by stats-convert
+  static void WriteSummary(WritableFile& fd, int ts, double avg, double max) {
+    if (ts == 0) {
       const char* header = "ts,avg_us,max_us\n";
       fd.Append(header);
     }
 
     char buf[1024];
-    int buf_len = snprintf(buf, 1024, " %d,%.0lf,%.0lf\n", ts_, avg, max);
+    int buf_len = snprintf(buf, 1024, " %d,%.0lf,%.0lf\n", ts, avg, max);
+    fd.Append(std::string(buf, buf_len));
+  }
+
+  static void WriteComm(WritableFile& fd, int ts, CommCost const& cost,
+                        double e2e_us) {
+    if (ts == 0) {
+      const char* header = "ts,off_rank_bytes,off_node_bytes,comm_us,e2e_us\n";
+      fd.Append(header);
+    }
+
+    char buf[1024];
+    int buf_len = snprintf(buf, 1024, " %d,%ld,%ld,%.0lf,%.0lf\n", ts,
+                           static_cast<long>(cost.off_rank_bytes),
+                           static_cast<long>(cost.off_node_bytes),
+                           cost.max_time_us, e2e_us);
     fd.Append(std::string(buf, buf_len));
   }
 
@@ -119,18 +233,22 @@ class PolicyStats {
     fd.Append(ss.str());
   }
 
-  void WriteRankSums(WritableFile& fd, std::vector<double>& rank_times) const {
+  static void WriteRankSums(WritableFile& fd, int ts,
+                            std::vector<double> const& rank_times) {
     int nranks = rank_times.size();
-    if (ts_ == 0) {
+    if (ts == 0) {
       fd.Append(reinterpret_cast<const char*>(&nranks), sizeof(int));
     }
     fd.Append(reinterpret_cast<const char*>(rank_times.data()),
               sizeof(double) * nranks);
   }
 
+ private:
   const PolicyExecOpts opts_;
+  CommModel const* const comm_model_;
 
   int ts_;
+  int nts_;  // timesteps logged
 
   // cost is assumed to be us
   double excess_cost_;
@@ -141,8 +259,16 @@ class PolicyStats {
 
   double exec_time_us_;
 
-  WritableFile fd_summ_;
-  WritableFile fd_det_;
-  WritableFile fd_ranksum_;
+  // comm model totals
+  double off_rank_bytes_;
+  double off_node_bytes_;
+  double comm_time_us_;
+  double e2e_time_us_;
+
+  std::unique_ptr<WritableFile> fd_summ_;
+  std::unique_ptr<WritableFile> fd_det_;
+  std::unique_ptr<WritableFile> fd_ranksum_;
+  std::unique_ptr<BinaryStatsWriter> fd_bin_;
+  std::unique_ptr<WritableFile> fd_comm_;
 };
 }  // namespace amr
@@ -6,8 +6,18 @@
 #include <gtest/gtest.h>
 #include <pdlfs-common/env.h>
 
+#include <fstream>
+#include <sstream>
+#include <thread>
+
 #include "bin_readers.h"
+#include "binary_stats.h"
+#include "bounded_queue.h"
+#include "columnar_trace.h"
+#include "comm_model.h"
 #include "block_alloc_sim.h"
+#include "cost_predictor.h"
+#include "msg_trace.h"
 #include "tools-common/distributions.h"
 #include "prof_set_reader.h"
 
@@ -30,6 +40,48 @@ class MiscTest : public ::testing::Test {
     LBPolicyWithOpts policy = amr::PolicyUtils::GenHybrid(policy_str);
     return policy;
   }
+
+  static const LBPolicyWithOpts GenCDPI(const std::string& policy_str) {
+    LBPolicyWithOpts policy = amr::PolicyUtils::GenCDPI(policy_str);
+    return policy;
+  }
+
+  static std::string ReadFile(std::string const& fpath) {
+    std::ifstream f(fpath, std::ios::binary);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+  }
+
+  // SetupWindow without MPI: sim logs window widx, from win_beg on
+  static std::string SetupTestWindow(BlockSimulator& sim, int widx,
+                                     int win_beg) {
+    sim.sub_ts_win_beg_ = win_beg;
+    sim.sub_ts_log_beg_ = win_beg;
+    sim.stats_dir_ = sim.WindowDir(widx);
+    sim.warmup_refined_ = (win_beg == 0);
+    Utils::EnsureDir(sim.options_.env, sim.stats_dir_);
+    return sim.stats_dir_;
+  }
+
+  static void CloseWindow(BlockSimulator& sim, std::vector<double>& totals) {
+    sim.CloseWindow(totals);
+  }
+
+  static void SetMergedTotals(BlockSimulator& sim,
+                              std::vector<double> const& merged,
+                              std::vector<std::pair<int, int>>& ts_counts) {
+    sim.SetMergedTotals(merged, ts_counts);
+  }
+
+  static void GetTotals(BlockSimulator& sim, int pidx, double* totals) {
+    sim.stats_[pidx].GetTotals(totals);
+  }
+
+  static int MergeStatsFiles(BlockSimulator& sim, const char* policy_id,
+                             const char* suffix, int nwindows) {
+    return sim.MergeStatsFiles(policy_id, suffix, nwindows);
+  }
 };
 
 TEST_F(MiscTest, PolicyOptsHybridTest) {
@@ -47,6 +99,33 @@ TEST_F(MiscTest, PolicyOptsHybridTest) {
   policy_wopts = GenHybrid(policy_str);
   ASSERT_EQ(policy_wopts.hcf_opts.lpt_frac, 99 / 100.0);
   ASSERT_EQ(policy_wopts.hcf_opts.alt_solncnt_max, 10);
+  ASSERT_EQ(policy_wopts.hcf_opts.deadline_ms, 0);
+
+  policy_str = "hybrid25dl5";
+  policy_wopts = GenHybrid(policy_str);
+  ASSERT_EQ(policy_wopts.hcf_opts.lpt_frac, 25 / 100.0);
+  ASSERT_EQ(policy_wopts.hcf_opts.deadline_ms, 5);
+
+  policy_str = "hybrid99alt10dl20";
+  policy_wopts = GenHybrid(policy_str);
+  ASSERT_EQ(policy_wopts.hcf_opts.alt_solncnt_max, 10);
+  ASSERT_EQ(policy_wopts.hcf_opts.deadline_ms, 20);
+}
+
+TEST_F(MiscTest, PolicyOptsCDPITest) {
+  auto policy_wopts = GenCDPI("cdpi100dl5");
+  ASSERT_EQ(policy_wopts.policy, LoadBalancePolicy::kPolicyCppIter);
+  ASSERT_EQ(policy_wopts.cdp_opts.niters, 100);
+  ASSERT_EQ(policy_wopts.cdp_opts.deadline_ms, 5);
+
+  policy_wopts = GenCDPI("cdpidl10");
+  ASSERT_EQ(policy_wopts.cdp_opts.niters, 0);
+  ASSERT_EQ(policy_wopts.cdp_opts.deadline_ms, 10);
+
+  // fixed-iteration names still resolve through kPolicyMap
+  policy_wopts = PolicyUtils::GetPolicy("cdpi50");
+  ASSERT_EQ(policy_wopts.cdp_opts.niters, 50);
+  ASSERT_EQ(policy_wopts.cdp_opts.deadline_ms, 0);
 }
 
 TEST_F(MiscTest, OutputFileTest) {
@@ -93,6 +172,449 @@ TEST_F(MiscTest, AssignReaderTest) {
   } while (rv);
 }
 
+TEST_F(MiscTest, MmapReaderTest) {
+  char dir_tmpl[] = "/tmp/policysim-readers-XXXXXX";
+  std::string dir = mkdtemp(dir_tmpl);
+
+  // ts 0/sub_ts 0: refs {3, 5}, derefs {}; ts 2/sub_ts 2: refs {}, derefs
+  // {1, 2, 3, 4}. Assignments for sub_ts 0 and 1
+  std::vector<int> ref_data = {0, 0, 2, 3, 5, 0, 2, 2, 0, 4, 1, 2, 3, 4};
+  std::vector<int> assign_data = {0, 0, 3, 0, 1, 1, 1, 1, 2, 1, 2};
+
+  FILE* f = fopen((dir + "/refinements.bin").c_str(), "wb");
+  fwrite(ref_data.data(), sizeof(int), ref_data.size(), f);
+  fclose(f);
+  f = fopen((dir + "/assignments.bin").c_str(), "wb");
+  fwrite(assign_data.data(), sizeof(int), assign_data.size(), f);
+  fclose(f);
+
+  int ts;
+  std::vector<int> refs, derefs, blocks;
+  RefinementReader ref_reader(dir);
+
+  ASSERT_EQ(ref_reader.ReadTimestep(ts, 0, refs, derefs), 1);
+  ASSERT_EQ(ts, 0);
+  ASSERT_EQ(refs, std::vector<int>({3, 5}));
+  ASSERT_TRUE(derefs.empty());
+
+  // no record for sub_ts 1
+  ASSERT_EQ(ref_reader.ReadTimestep(ts, 1, refs, derefs), 1);
+  ASSERT_EQ(ts, -1);
+  ASSERT_TRUE(refs.empty());
+
+  ASSERT_EQ(ref_reader.ReadTimestep(ts, 2, refs, derefs), 1);
+  ASSERT_EQ(ts, 2);
+  ASSERT_TRUE(refs.empty());
+  ASSERT_EQ(derefs, std::vector<int>({1, 2, 3, 4}));
+  ASSERT_EQ(ref_reader.ReadTimestep(ts, 3, refs, derefs), 0);
+
+  AssignmentReader assign_reader(dir);
+  ASSERT_EQ(assign_reader.ReadTimestep(ts, 0, blocks), 1);
+  ASSERT_EQ(blocks, std::vector<int>({0, 1, 1}));
+  ASSERT_EQ(assign_reader.ReadTimestep(ts, 1, blocks), 1);
+  ASSERT_EQ(blocks, std::vector<int>({1, 2}));
+  ASSERT_EQ(assign_reader.ReadTimestep(ts, 2, blocks), 0);
+
+  unlink((dir + "/refinements.bin").c_str());
+  unlink((dir + "/assignments.bin").c_str());
+  rmdir(dir.c_str());
+}
+
+TEST_F(MiscTest, TraceIndexTest) {
+  char dir_tmpl[] = "/tmp/policysim-index-XXXXXX";
+  std::string dir = mkdtemp(dir_tmpl);
+
+  // same records as MmapReaderTest, plus a CSV profile with sub_ts 0..4
+  std::vector<int> ref_data = {0, 0, 2, 3, 5, 0, 2, 2, 0, 4, 1, 2, 3, 4};
+  std::vector<int> assign_data = {0, 0, 3, 0, 1, 1, 1, 1, 2, 1, 2};
+
+  FILE* f = fopen((dir + "/refinements.bin").c_str(), "wb");
+  fwrite(ref_data.data(), sizeof(int), ref_data.size(), f);
+  fclose(f);
+  f = fopen((dir + "/assignments.bin").c_str(), "wb");
+  fwrite(assign_data.data(), sizeof(int), assign_data.size(), f);
+  fclose(f);
+
+  std::string csv_path = dir + "/prof.merged.evt0.csv";
+  f = fopen(csv_path.c_str(), "w");
+  fprintf(f, "ts,sub_ts,rank,bid,time_us\n");
+  for (int sub_ts = 0; sub_ts < 5; sub_ts++) {
+    for (int bid = 0; bid < 4 + sub_ts; bid++) {
+      fprintf(f, "%d,%d,0,%d,%d\n", sub_ts, sub_ts, bid, 10 * sub_ts + bid);
+    }
+  }
+  fclose(f);
+
+  int ts;
+  std::vector<int> refs, derefs, blocks;
+
+  // sub_ts 1 has no refinement record: the next one is sub_ts 2
+  RefinementReader ref_reader(dir);
+  ASSERT_EQ(ref_reader.SeekTimestep(1), 0);
+  ASSERT_EQ(ref_reader.ReadTimestep(ts, 1, refs, derefs), 1);
+  ASSERT_EQ(ts, -1);
+  ASSERT_EQ(ref_reader.ReadTimestep(ts, 2, refs, derefs), 1);
+  ASSERT_EQ(derefs, std::vector<int>({1, 2, 3, 4}));
+
+  // the sidecar is reused, and seeking back works
+  ASSERT_EQ(access((dir + "/refinements.bin.idx").c_str(), F_OK), 0);
+  RefinementReader ref_reader2(dir);
+  ASSERT_EQ(ref_reader2.SeekTimestep(0), 0);
+  ASSERT_EQ(ref_reader2.ReadTimestep(ts, 0, refs, derefs), 1);
+  ASSERT_EQ(refs, std::vector<int>({3, 5}));
+
+  // an index pointing past the trace is rebuilt, not trusted
+  f = fopen((dir + "/refinements.bin.idx").c_str(), "r+b");
+  uint64_t bad_offset = 1 << 20;
+  fseek(f, 32 + sizeof(int32_t), SEEK_SET);  // header, then sub_ts
+  fwrite(&bad_offset, sizeof(bad_offset), 1, f);
+  fclose(f);
+  RefinementReader ref_reader3(dir);
+  ASSERT_EQ(ref_reader3.SeekTimestep(0), 0);
+  ASSERT_EQ(ref_reader3.ReadTimestep(ts, 0, refs, derefs), 1);
+  ASSERT_EQ(refs, std::vector<int>({3, 5}));
+
+  AssignmentReader assign_reader(dir);
+  ASSERT_EQ(assign_reader.SeekTimestep(1), 0);
+  ASSERT_EQ(assign_reader.ReadTimestep(ts, 1, blocks), 1);
+  ASSERT_EQ(blocks, std::vector<int>({1, 2}));
+  ASSERT_EQ(assign_reader.SeekTimestep(2), 0);
+  ASSERT_EQ(assign_reader.ReadTimestep(ts, 2, blocks), 0);
+
+  // the trace ends after the last indexed sub_ts
+  int sub_ts_end;
+  ASSERT_EQ(assign_reader.SubTsEnd(sub_ts_end), 0);
+  ASSERT_EQ(sub_ts_end, 2);
+  ASSERT_EQ(ref_reader.SubTsEnd(sub_ts_end), 0);
+  ASSERT_EQ(sub_ts_end, 3);
+
+  // a seek matches a replay from the start, with either parser
+  for (int nthreads : {0, 2}) {
+    CSVProfileReader full_reader(csv_path.c_str(),
+                                 ProfTimeCombinePolicy::kAdd, nthreads);
+    CSVProfileReader seek_reader(csv_path.c_str(),
+                                 ProfTimeCombinePolicy::kAdd, nthreads);
+    ASSERT_EQ(seek_reader.SeekTimestep(3), 0);
+
+    for (int sub_ts = 0; sub_ts < 6; sub_ts++) {
+      std::vector<int> times_full, times_seek;
+      int nlines_full = 0, nlines_seek = 0;
+      int rv_full = full_reader.ReadTimestep(sub_ts, times_full, nlines_full);
+      if (sub_ts < 3) continue;
+
+      int rv_seek = seek_reader.ReadTimestep(sub_ts, times_seek, nlines_seek);
+      ASSERT_EQ(rv_full, rv_seek);
+      ASSERT_EQ(times_full, times_seek);
+    }
+  }
+
+  for (auto fname : {"/refinements.bin", "/assignments.bin",
+                     "/prof.merged.evt0.csv"}) {
+    unlink((dir + fname).c_str());
+    unlink((dir + fname + ".idx").c_str());
+  }
+  rmdir(dir.c_str());
+}
+
+TEST_F(MiscTest, ColumnarTraceTest) {
+  char fpath_tmpl[] = "/tmp/policysim-trace-XXXXXX";
+  int fd = mkstemp(fpath_tmpl);
+  close(fd);
+  std::string fpath = fpath_tmpl;
+
+  std::vector<TimestepTrace> traces(3);
+  traces[0] = {0, 0, {3, 5}, {}, {0, 0, 1, 1}, {120, 80, 1 << 30, 0}};
+  traces[1] = {0, 1, {}, {}, {0, 1, 1, 2, 3, 3, 3}, {5, 6, 7, 8, 9, 10, 11}};
+  traces[2] = {2, 4, {}, {4, 5, 6, 7}, {3, 2, 1, 0}, {-1, 100000, 7, 7}};
+
+  {
+    ColumnarTraceWriter writer(fpath);
+    for (auto& trace : traces) {
+      ASSERT_EQ(writer.Append(trace), 0);
+    }
+    ASSERT_EQ(writer.Append(traces[0]), -1);  // out of order
+    ASSERT_EQ(writer.Close(), 0);
+  }
+
+  ColumnarTraceReader reader(fpath);
+  ASSERT_EQ(reader.NumTimesteps(), 3);
+
+  int sub_ts_beg, sub_ts_end;
+  ASSERT_TRUE(reader.SubTsRange(sub_ts_beg, sub_ts_end));
+  ASSERT_EQ(sub_ts_beg, 0);
+  ASSERT_EQ(sub_ts_end, 4);
+
+  // read out of order, straight from the index
+  TimestepTrace trace;
+  for (int i : {2, 0, 1}) {
+    ASSERT_EQ(reader.ReadTimestep(traces[i].sub_ts, trace), 1);
+    ASSERT_EQ(trace.ts, traces[i].ts);
+    ASSERT_EQ(trace.sub_ts, traces[i].sub_ts);
+    ASSERT_EQ(trace.refs, traces[i].refs);
+    ASSERT_EQ(trace.derefs, traces[i].derefs);
+    ASSERT_EQ(trace.assignments, traces[i].assignments);
+    ASSERT_EQ(trace.times, traces[i].times);
+  }
+
+  ASSERT_EQ(reader.ReadTimestep(3, trace), 0);
+  ASSERT_EQ(reader.ReadTimestep(5, trace), 0);
+
+  unlink(fpath.c_str());
+}
+
+TEST_F(MiscTest, BinaryStatsTest) {
+  char fpath_tmpl[] = "/tmp/policysim-stats-XXXXXX";
+  int fd = mkstemp(fpath_tmpl);
+  close(fd);
+  std::string fpath = fpath_tmpl;
+
+  // enough timesteps to fill several write buffers
+  const int nts = 200, nblocks = 4096, nranks = 512;
+  auto gen = [](int ts, StatsRecord& r) {
+    r.ts = ts;
+    r.avg_us = ts * 1.5;
+    r.max_us = ts * 2.5;
+    r.costs.resize(nblocks + ts % 3);
+    r.ranks.resize(nblocks);
+    r.rank_times.resize(nranks);
+    for (int i = 0; i < r.costs.size(); i++) r.costs[i] = i * 0.5 + ts;
+    for (int i = 0; i < nblocks; i++) r.ranks[i] = (i + ts) % nranks;
+    for (int i = 0; i < nranks; i++) r.rank_times[i] = i + ts * 0.25;
+  };
+
+  {
+    BinaryStatsWriter writer(pdlfs::Env::Default(), fpath);
+    StatsRecord r;
+    for (int ts = 0; ts < nts; ts++) {
+      gen(ts, r);
+      writer.LogTimestep(r.ts, r.avg_us, r.max_us, r.costs, r.ranks,
+                         r.rank_times);
+    }
+  }
+
+  BinaryStatsReader reader(fpath);
+  StatsRecord r, r_expected;
+  for (int ts = 0; ts < nts; ts++) {
+    gen(ts, r_expected);
+    ASSERT_EQ(reader.ReadTimestep(r), 1);
+    ASSERT_EQ(r.ts, r_expected.ts);
+    ASSERT_EQ(r.avg_us, r_expected.avg_us);
+    ASSERT_EQ(r.max_us, r_expected.max_us);
+    ASSERT_EQ(r.costs, r_expected.costs);
+    ASSERT_EQ(r.ranks, r_expected.ranks);
+    ASSERT_EQ(r.rank_times, r_expected.rank_times);
+  }
+  ASSERT_EQ(reader.ReadTimestep(r), 0);
+
+  unlink(fpath.c_str());
+}
+
+TEST_F(MiscTest, MsgTraceTest) {
+  char dir_tmpl[] = "/tmp/policysim-msgs-XXXXXX";
+  std::string dir = mkdtemp(dir_tmpl);
+  std::string msgs_dir = dir + "/msgs";
+  mkdir(msgs_dir.c_str(), 0755);
+
+  // channels are {ptr, block_id, nbr_id}, sends are {ptr, buf_sz}
+  using Channel = std::vector<int>;
+  using Send = std::vector<int>;
+  auto write_ts = [](FILE* f, int ts, std::vector<Channel> const& channels,
+                     std::vector<Send> const& sends) {
+    std::string buf;
+    for (auto& c : channels) {
+      uint64_t ptr = c[0];
+      int ints[5] = {c[1], 0, c[2], 0, 0};
+      buf.append(reinterpret_cast<const char*>(&ptr), 8);
+      buf.append(reinterpret_cast<const char*>(ints), sizeof(ints));
+      buf.push_back(0);
+    }
+    int nbytes = buf.size();
+    fwrite(&ts, sizeof(int), 1, f);
+    fwrite(&nbytes, sizeof(int), 1, f);
+    fwrite(buf.data(), 1, nbytes, f);
+
+    buf.clear();
+    for (auto& m : sends) {
+      uint64_t ptr = m[0], timestamp = 0;
+      int ints[3] = {m[1], 0, 0};
+      buf.append(reinterpret_cast<const char*>(&ptr), 8);
+      buf.append(reinterpret_cast<const char*>(ints), sizeof(ints));
+      buf.append(reinterpret_cast<const char*>(&timestamp), 8);
+    }
+    nbytes = buf.size();
+    fwrite(&nbytes, sizeof(int), 1, f);
+    fwrite(buf.data(), 1, nbytes, f);
+  };
+
+  FILE* f = fopen((msgs_dir + "/msgs.0.bin").c_str(), "wb");
+  write_ts(f, 0, {{0x10, 0, 1}, {0x20, 1, 2}}, {{0x10, 100}, {0x20, 200}});
+  write_ts(f, 2, {}, {{0x10, 50}, {0x99, 7}});
+  fclose(f);
+
+  f = fopen((msgs_dir + "/msgs.1.bin").c_str(), "wb");
+  write_ts(f, 1, {{0x30, 2, 0}}, {{0x30, 300}});
+  write_ts(f, 2, {}, {{0x30, 30}});
+  fclose(f);
+
+  auto as_tuples = [](std::vector<CommEdge> const& msgs) {
+    std::vector<std::vector<int>> tuples;
+    for (auto& m : msgs) tuples.push_back({m.block_id, m.nbr_id, m.bytes});
+    return tuples;
+  };
+
+  // channels of skipped timesteps still match later sends
+  std::vector<CommEdge> msgs;
+  MsgTraceReader reader(pdlfs::Env::Default(), dir);
+  ASSERT_EQ(reader.ReadTimestep(1, msgs), 1);
+  ASSERT_EQ(as_tuples(msgs), std::vector<std::vector<int>>({{2, 0, 300}}));
+  ASSERT_EQ(reader.ReadTimestep(2, msgs), 1);
+  ASSERT_EQ(as_tuples(msgs),
+            std::vector<std::vector<int>>({{0, 1, 50}, {2, 0, 30}}));
+  ASSERT_EQ(reader.ReadTimestep(3, msgs), 0);
+  ASSERT_TRUE(msgs.empty());
+
+  // two ranks per node: block 0 -> 1 stays on node 0, block 2 -> 0 does not
+  CommModelOpts opts;
+  opts.ranks_per_node = 2;
+  opts.intra_alpha_us = 1;
+  opts.intra_gbps = 1;
+  opts.inter_alpha_us = 2;
+  opts.inter_gbps = 0.1;
+  CommModel model(opts);
+
+  std::vector<CommEdge> msgs_ts2 = {{0, 1, 50}, {2, 0, 30}};
+  CommCost cost;
+  model.Compute(msgs_ts2, {0, 1, 2}, 4, cost);
+  ASSERT_EQ(cost.off_rank_bytes, 80);
+  ASSERT_EQ(cost.off_node_bytes, 30);
+  AssertApproxEqual(cost.rank_times, {1.05, 0, 2.3, 0});
+  ASSERT_NEAR(cost.max_time_us, 2.3, 0.0001);
+
+  // blocks on the same rank, or outside the placement, cost nothing
+  msgs_ts2.push_back({5, 0, 1000});
+  model.Compute(msgs_ts2, {0, 0, 2}, 4, cost);
+  ASSERT_EQ(cost.off_rank_bytes, 30);
+  AssertApproxEqual(cost.rank_times, {0, 0, 2.3, 0});
+
+  unlink((msgs_dir + "/msgs.0.bin").c_str());
+  unlink((msgs_dir + "/msgs.1.bin").c_str());
+  rmdir(msgs_dir.c_str());
+  rmdir(dir.c_str());
+}
+
+TEST_F(MiscTest, WindowMergeTest) {
+  char dir_tmpl[] = "/tmp/policysim-windows-XXXXXX";
+  ASSERT_NE(mkdtemp(dir_tmpl), nullptr);
+  std::string dir = dir_tmpl;
+
+  // the simulator only needs a trace to open; timesteps are fed directly
+  std::string trace_path = dir + "/trace.bin";
+  {
+    ColumnarTraceWriter writer(trace_path);
+    ASSERT_EQ(writer.Append({0, 0, {}, {}, {0, 1}, {1, 1}}), 0);
+    ASSERT_EQ(writer.Close(), 0);
+  }
+
+  BlockSimulatorOpts opts{};
+  opts.nranks = 4;
+  opts.nblocks = 8;
+  opts.ndims = 2;
+  opts.output_dir = dir;
+  opts.env = pdlfs::Env::Default();
+  opts.trace_path = trace_path;
+  opts.window_replay = true;
+
+  std::vector<double> costs = {1, 2, 3, 4, 4, 3, 2, 1};
+  std::vector<int> ranklist = {0, 0, 1, 1, 2, 2, 3, 3};
+  std::vector<int> refs, derefs;
+
+  // window 0 replays sub_ts [0, 3); window 1 replays [5, 7), after an
+  // unlogged warmup timestep at 4
+  std::unique_ptr<BlockSimulator> sims[2];
+  std::vector<double> totals[2];
+  std::string det[2];
+
+  for (int widx = 0; widx < 2; widx++) {
+    sims[widx].reset(new BlockSimulator(opts));
+    BlockSimulator& sim = *sims[widx];
+    std::string wdir = SetupTestWindow(sim, widx, widx == 0 ? 0 : 5);
+
+    PolicyExecOpts policy_opts;
+    policy_opts.output_dir = wdir.c_str();
+    policy_opts.env = opts.env;
+    policy_opts.nranks = opts.nranks;
+    policy_opts.nblocks_init = opts.nblocks;
+    policy_opts.SetPolicy("LPT/Actual-Cost", "lpt",
+                          CostEstimationPolicy::kOracleCost,
+                          TriggerPolicy::kEveryTimestep);
+    sim.SetupPolicy(policy_opts);
+
+    int sub_ts_beg = (widx == 0) ? 0 : 4;
+    int sub_ts_end = (widx == 0) ? 3 : 7;
+    for (int sub_ts = sub_ts_beg; sub_ts < sub_ts_end; sub_ts++) {
+      ASSERT_EQ(sim.InvokePolicies(sub_ts, costs, ranklist, refs, derefs, {}),
+                0);
+    }
+
+    CloseWindow(sim, totals[widx]);
+    det[widx] = ReadFile(PolicyUtils::GetLogPath(wdir.c_str(), "lpt", "det"));
+  }
+
+  // what MPI_Reduce(MPI_SUM) does across windows
+  std::vector<double> merged(totals[0].size());
+  for (int i = 0; i < merged.size(); i++) {
+    merged[i] = totals[0][i] + totals[1][i];
+  }
+
+  std::vector<std::pair<int, int>> ts_counts;
+  SetMergedTotals(*sims[0], merged, ts_counts);
+
+  // LB counts only cover the windows themselves, not the warmup
+  ASSERT_EQ(ts_counts.size(), 1);
+  ASSERT_EQ(ts_counts[0].second, 5);
+
+  double t[PolicyStats::kNumTotals];
+  GetTotals(*sims[0], 0, t);
+  ASSERT_EQ(t[0], 5);
+  ASSERT_DOUBLE_EQ(t[3], totals[0][3] + totals[1][3]);
+
+  for (auto& suffix : PolicyStats::FileSuffixes(false, false)) {
+    ASSERT_EQ(MergeStatsFiles(*sims[0], "lpt", suffix.c_str(), 2), 0);
+  }
+
+  // window files are concatenated in window order, and removed
+  std::string det_path = PolicyUtils::GetLogPath(dir.c_str(), "lpt", "det");
+  ASSERT_FALSE(det[0].empty());
+  ASSERT_EQ(ReadFile(det_path), det[0] + det[1]);
+  ASSERT_FALSE(opts.env->FileExists(
+      PolicyUtils::GetLogPath((dir + "/window1").c_str(), "lpt", "det")
+          .c_str()));
+
+  // binary stats keep only the first window's magic
+  opts.binary_stats = true;
+  BlockSimulator sim_bin(opts);
+  for (int widx = 0; widx < 2; widx++) {
+    std::string fpath = PolicyUtils::GetLogPath(
+        (dir + "/window" + std::to_string(widx)).c_str(), "x", "statsbin");
+    std::ofstream f(fpath, std::ios::binary);
+    f << std::string(BinaryStats::kMagicBytes, 'M') << widx;
+  }
+  ASSERT_EQ(MergeStatsFiles(sim_bin, "x", "statsbin", 2), 0);
+
+  std::string bin_path = PolicyUtils::GetLogPath(dir.c_str(), "x", "statsbin");
+  ASSERT_EQ(ReadFile(bin_path),
+            std::string(BinaryStats::kMagicBytes, 'M') + "01");
+
+  for (auto& suffix : PolicyStats::FileSuffixes(false, false)) {
+    unlink(PolicyUtils::GetLogPath(dir.c_str(), "lpt", suffix.c_str()).c_str());
+  }
+  unlink(bin_path.c_str());
+  unlink(trace_path.c_str());
+  rmdir((dir + "/window0").c_str());
+  rmdir((dir + "/window1").c_str());
+  rmdir(dir.c_str());
+}
+
 TEST_F(MiscTest, BlockAllocSimTest) {
   BlockSimulatorOpts opts{};
   opts.nranks = 512;
@@ -105,6 +627,29 @@ TEST_F(MiscTest, BlockAllocSimTest) {
   sim.Run();
 }
 
+TEST_F(MiscTest, BoundedQueueTest) {
+  BoundedQueue<int> queue(2);
+  const int nitems = 1000;
+
+  std::thread producer([&queue]() {
+    for (int i = 0; i < nitems; i++) {
+      ASSERT_TRUE(queue.Push(int(i)));
+    }
+    queue.Close();
+  });
+
+  int item, nexpected = 0;
+  while (queue.Pop(item)) {
+    ASSERT_EQ(item, nexpected++);
+  }
+  producer.join();
+  ASSERT_EQ(nexpected, nitems);
+
+  // a closed queue rejects pushes, and stays drained
+  ASSERT_FALSE(queue.Push(0));
+  ASSERT_FALSE(queue.Pop(item));
+}
+
 TEST_F(MiscTest, prof_reader_test) {
   int rv;
 
@@ -145,6 +690,86 @@ TEST_F(MiscTest, prof_reader_test) {
        SerializeVector(times, 10).c_str());
 }
 
+TEST_F(MiscTest, ParallelCSVReaderTest) {
+  char fpath_tmpl[] = "/tmp/policysim-prof-XXXXXX.csv";
+  int fd = mkstemps(fpath_tmpl, 4);
+  close(fd);
+  std::string fpath = fpath_tmpl;
+
+  // enough rows for several parse chunks; sub_ts 3 is missing, and rows
+  // within a sub_ts are out of bid order
+  FILE* f = fopen(fpath.c_str(), "w");
+  fprintf(f, "ts,sub_ts,rank,bid,time_us\n");
+  const int nts = 8, nblocks = 40000;
+  for (int sub_ts = 0; sub_ts < nts; sub_ts++) {
+    if (sub_ts == 3) continue;
+    for (int i = 0; i < nblocks; i++) {
+      int bid = (i * 7919) % nblocks;
+      fprintf(f, "%d,%d,%d,%d,%d%s\n", sub_ts / 2, sub_ts, bid % 16, bid,
+              (bid * 31 + sub_ts) % 1000, i % 1000 ? "" : "\r");
+    }
+    fprintf(f, "\n");
+  }
+  fclose(f);
+
+  for (auto policy : {ProfTimeCombinePolicy::kAdd,
+                      ProfTimeCombinePolicy::kUseFirst}) {
+    CSVProfileReader ref_reader(fpath.c_str(), policy, 0);
+    CSVProfileReader fast_reader(fpath.c_str(), policy, 4);
+
+    for (int ts = 0; ts <= nts; ts++) {
+      std::vector<int> times_ref, times_fast;
+      int nlines_ref = 0, nlines_fast = 0;
+      int rv_ref = ref_reader.ReadTimestep(ts, times_ref, nlines_ref);
+      int rv_fast = fast_reader.ReadTimestep(ts, times_fast, nlines_fast);
+
+      ASSERT_EQ(rv_ref, rv_fast);
+      ASSERT_EQ(nlines_ref, nlines_fast);
+      ASSERT_EQ(times_ref, times_fast);
+    }
+  }
+
+  unlink(fpath.c_str());
+}
+
+TEST_F(MiscTest, ConcurrentProfSetReaderTest) {
+  char dir_tmpl[] = "/tmp/policysim-profset-XXXXXX";
+  std::string dir = mkdtemp(dir_tmpl);
+
+  // three event files with overlapping blocks and different sub_ts ranges
+  const int nfiles = 3, nts = 6;
+  std::vector<std::string> fpaths;
+  for (int fidx = 0; fidx < nfiles; fidx++) {
+    fpaths.push_back(dir + "/prof.merged.evt" + std::to_string(fidx) + ".csv");
+    FILE* f = fopen(fpaths.back().c_str(), "w");
+    fprintf(f, "ts,sub_ts,rank,bid,time_us\n");
+    for (int sub_ts = 0; sub_ts < nts - fidx; sub_ts++) {
+      int nblocks = 50 + 10 * fidx + sub_ts;
+      for (int bid = 0; bid < nblocks; bid++) {
+        fprintf(f, "%d,%d,0,%d,%d\n", sub_ts, sub_ts, bid,
+                (bid + 1) * (fidx + 1) + sub_ts);
+      }
+    }
+    fclose(f);
+  }
+
+  ProfSetReader seq_reader(fpaths, ProfTimeCombinePolicy::kAdd, 1);
+  ProfSetReader conc_reader(fpaths, ProfTimeCombinePolicy::kAdd, nfiles);
+
+  for (int sub_ts = 0; sub_ts <= nts; sub_ts++) {
+    std::vector<int> times_seq, times_conc;
+    int rv_seq = seq_reader.ReadTimestep(sub_ts, times_seq);
+    int rv_conc = conc_reader.ReadTimestep(sub_ts, times_conc);
+    ASSERT_EQ(rv_seq, rv_conc);
+    ASSERT_EQ(times_seq, times_conc);
+  }
+
+  for (auto& fpath : fpaths) {
+    unlink(fpath.c_str());
+  }
+  rmdir(dir.c_str());
+}
+
 TEST_F(MiscTest, prof_set_reader_test) {
   std::vector<std::string> all_profs = {
       "/Users/schwifty/Repos/amr-data/20230424-prof-tags/ref-mini/"
@@ -207,6 +832,67 @@ TEST_F(MiscTest, ExtrapolateCosts3) {
   AssertApproxEqual(costs_cur, {1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 5.5});
 }
 
+TEST_F(MiscTest, ExtrapolateCosts4) {
+  // 1D, unsorted lists, two-level refine and two-level deref
+  std::vector<double> costs_prev = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  std::vector<int> refs = {1, 0, 1};
+  std::vector<int> derefs = {5, 2, 3, 4, 2, 5, 3, 4};
+  std::vector<double> costs_cur;
+
+  PolicyUtils::ExtrapolateCosts(1, costs_prev, refs, derefs, costs_cur);
+  AssertApproxEqual(costs_cur, {1.0, 1.0, 2.0, 2.0, 2.0, 2.0, 4.5});
+  ASSERT_EQ(PolicyUtils::GetNumBlocksNext(1, 6, refs, derefs), 7);
+
+  // inputs are left untouched
+  ASSERT_EQ(refs, std::vector<int>({1, 0, 1}));
+}
+
+TEST_F(MiscTest, ExtrapolateCosts5) {
+  // 2D: one ref and one single-level deref, same as the fast count
+  std::vector<double> costs_prev = {1.0, 2.0, 2.0, 4.0, 4.0, 3.0};
+  std::vector<int> refs = {5};
+  std::vector<int> derefs = {1, 2, 3, 4};
+  std::vector<double> costs_cur;
+
+  PolicyUtils::ExtrapolateCosts2D(costs_prev, refs, derefs, costs_cur);
+  AssertApproxEqual(costs_cur, {1.0, 3.0, 3.0, 3.0, 3.0, 3.0});
+  ASSERT_EQ(PolicyExecCtx::GetNumBlocksNext(6, 1, 4, 2), 6);
+  ASSERT_EQ(PolicyExecCtx::GetNumBlocksNext(6, refs, derefs, 2), 6);
+  ASSERT_EQ(PolicyExecCtx::GetNumBlocksNext(64, 1, 8, 3), 64);
+}
+
+TEST_F(MiscTest, CostPredictorTest) {
+  CostPredictor predictor(1, 0.5, 0.5);
+  ASSERT_TRUE(predictor.Empty());
+
+  // block 0 grows linearly, block 1 is flat
+  for (int ts = 0; ts < 20; ts++) {
+    predictor.Observe({10.0 + ts, 5.0});
+  }
+
+  std::vector<double> costs;
+  predictor.Predict(costs);
+  ASSERT_EQ(costs.size(), 2);
+  ASSERT_NEAR(costs[0], 30.0, 0.5);  // trend is followed, not lagged
+  ASSERT_NEAR(costs[1], 5.0, 0.01);
+
+  // refine the growing block: both children carry its state
+  predictor.Remap({0}, {});
+  predictor.Predict(costs);
+  ASSERT_EQ(costs.size(), 3);
+  ASSERT_NEAR(costs[0], costs[1], 1e-9);
+  ASSERT_NEAR(costs[2], 5.0, 0.01);
+
+  // derefine the two children back into one
+  predictor.Remap({}, {0, 1});
+  ASSERT_EQ(predictor.NumBlocks(), 2);
+
+  std::vector<double> vars;
+  predictor.Variances(vars);
+  ASSERT_EQ(vars.size(), 2);
+  ASSERT_NEAR(vars[1], 0.0, 1e-9);
+}
+
 TEST_F(MiscTest, BinProfReaderTest) {
   BinProfileReader bpreader("/Users/schwifty/CRAP/tmp.bin",
                             ProfTimeCombinePolicy::kAdd);
@@ -7,6 +7,7 @@
 #include "lb-common/policy.h"
 #include "tools-common/common.h"
 #include "tools-common/logging.h"
+#include "trace_index.h"
 
 namespace amr {
 class ProfileReader {
@@ -39,6 +40,10 @@ public:
   virtual int ReadTimestep(int ts_to_read, std::vector<int> &times,
                            int &nlines_read) = 0;
 
+  // Position the reader so the next timestep read is ts_to_read,
+  // via a sidecar index (see trace_index.h). Returns 0, or -1 on error
+  virtual int SeekTimestep(int ts_to_read) = 0;
+
 protected:
   void SafeCloseFile() {
     if (fd_) {
@@ -166,7 +171,47 @@ public:
     return 0;
   }
 
+  int SeekTimestep(int ts_to_read) override {
+    ReadHeader();
+
+    std::vector<TraceIndex::Entry> entries;
+    int rv = TraceIndex::LoadOrBuild(
+        csv_path_, entries,
+        [this](std::vector<TraceIndex::Entry> &e) { return BuildIndex(e); });
+    if (rv)
+      return rv;
+
+    fseek(fd_, 0, SEEK_END);
+    long eof_off = ftell(fd_);
+    fseek(fd_, TraceIndex::Lookup(entries, ts_to_read, eof_off), SEEK_SET);
+    eof_ = false;
+    return 0;
+  }
+
 private:
+  // BuildIndex: scan the records after the header, then rewind to them
+  int BuildIndex(std::vector<TraceIndex::Entry> &entries) {
+    long beg = sizeof(int);
+    fseek(fd_, beg, SEEK_SET);
+
+    while (true) {
+      long offset = ftell(fd_);
+      int hdr[2];  // ts, nblocks
+      if (fread(hdr, sizeof(int), 2, fd_) != 2)
+        break;
+
+      entries.push_back({hdr[0], static_cast<uint64_t>(offset)});
+      if (hdr[1] < 0 or fseek(fd_, hdr[1] * sizeof(int), SEEK_CUR) != 0) {
+        MLOG(MLOG_ERRO, "[ProfReader] Bad record at %ld: %s", offset,
+             csv_path_.c_str());
+        return -1;
+      }
+    }
+
+    fseek(fd_, beg, SEEK_SET);
+    return 0;
+  }
+
   void ReadHeader() {
     if (fd_)
       return;
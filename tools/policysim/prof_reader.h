@@ -1,18 +1,39 @@
 #include "prof_base.h"
 
+#include "csv_parser.h"
 #include "tools-common/common.h"
+#include "tools-common/thread_pool.h"
+#include <cstdint>
 #include <cstdio>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace amr {
+/* Rows are parsed from an mmap-ed file on nthreads threads
+ * (see CSVRowParser); nthreads = 0 falls back to fscanf.
+ * Both produce identical timesteps. Readers of several files
+ * can instead share one parse pool, owned by the caller.
+ */
 class CSVProfileReader : public ProfileReader {
 public:
   explicit CSVProfileReader(const char *prof_csv_path,
-                            ProfTimeCombinePolicy combine_policy)
+                            ProfTimeCombinePolicy combine_policy,
+                            int nthreads = ThreadPool::DefaultNumThreads())
       : ProfileReader(prof_csv_path, combine_policy), ts_(-1), eof_(false),
         prev_ts_(-1), prev_sub_ts_(-1), prev_bid_(-1), prev_time_(-1),
-        first_read_(true), prev_set_(false) {
+        first_read_(true), prev_set_(false),
+        own_pool_(nthreads > 0 ? new ThreadPool(nthreads) : nullptr),
+        pool_(own_pool_.get()) {
+    Reset();
+  }
+
+  // pool may be shared with other readers, and must outlive this one
+  CSVProfileReader(const char *prof_csv_path,
+                   ProfTimeCombinePolicy combine_policy, ThreadPool *pool)
+      : ProfileReader(prof_csv_path, combine_policy), ts_(-1), eof_(false),
+        prev_ts_(-1), prev_sub_ts_(-1), prev_bid_(-1), prev_time_(-1),
+        first_read_(true), prev_set_(false), pool_(pool) {
     Reset();
   }
 
@@ -40,9 +61,13 @@ public:
     MLOG(MLOG_DBG2, "[ProfReader] Reset: %s", csv_path_.c_str());
     SafeCloseFile();
 
-    fd_ = fopen(csv_path_.c_str(), "r");
+    if (pool_) {
+      parser_.reset(new CSVRowParser(csv_path_, 5, pool_));
+    } else {
+      fd_ = fopen(csv_path_.c_str(), "r");
+    }
 
-    if (fd_ == nullptr) {
+    if (fd_ == nullptr and parser_ == nullptr) {
       MLOG(MLOG_ERRO, "[ProfReader] Unable to open: %s", csv_path_.c_str());
       ABORT("Unable to open specified CSV");
     }
@@ -52,6 +77,35 @@ public:
     prev_ts_ = prev_bid_ = prev_time_ = -1;
   }
 
+  int SeekTimestep(int ts_to_read) override {
+    std::vector<TraceIndex::Entry> entries;
+    int rv = TraceIndex::LoadOrBuild(
+        csv_path_, entries, [this](std::vector<TraceIndex::Entry> &e) {
+          CSVRowParser parser(csv_path_, 5, nullptr);
+          return parser.BuildIndex(1, e);  // by sub_ts
+        });
+    if (rv)
+      return rv;
+
+    uint64_t eof_off = UINT64_MAX;
+    uint64_t offset = TraceIndex::Lookup(entries, ts_to_read, eof_off);
+
+    if (parser_) {
+      parser_->SeekTo(offset);
+    } else if (offset == eof_off) {
+      fseek(fd_, 0, SEEK_END);
+    } else {
+      fseek(fd_, offset, SEEK_SET);
+    }
+
+    // the index points past the header
+    ts_ = ts_to_read;
+    eof_ = false;
+    first_read_ = false;
+    prev_set_ = false;
+    return 0;
+  }
+
 private:
   void ReadLine(char *buf, int max_sz) const {
     char *ret = fgets(buf, max_sz, fd_);
@@ -64,10 +118,34 @@ private:
   }
 
   void ReadHeader() {
+    if (parser_) {
+      parser_->SkipLine();
+      return;
+    }
+
     char header[1024];
     ReadLine(header, 1024);
   }
 
+  // ReadRow: false at EOF
+  bool ReadRow(int &ts, int &sub_ts, int &rank, int &bid, int &time_us) {
+    if (parser_) {
+      const int *row = parser_->Next();
+      if (row == nullptr)
+        return false;
+
+      ts = row[0];
+      sub_ts = row[1];
+      rank = row[2];
+      bid = row[3];
+      time_us = row[4];
+      return true;
+    }
+
+    return fscanf(fd_, "%d,%d,%d,%d,%d", &ts, &sub_ts, &rank, &bid,
+                  &time_us) != EOF;
+  }
+
 public:
   /* Caller must zero the vector if needed!!
    * Returns: Number of blocks in current ts
@@ -79,7 +157,7 @@ public:
       return -1;
 
     // Initialization hack
-    if (fd_ == nullptr)
+    if (fd_ == nullptr and parser_ == nullptr)
       Reset();
 
     if (first_read_) {
@@ -111,9 +189,7 @@ public:
     }
 
     while (true) {
-      int nread;
-      if ((nread = fscanf(fd_, "%d,%d,%d,%d,%d", &ts, &sub_ts, &rank, &bid,
-                          &time_us)) == EOF) {
+      if (not ReadRow(ts, sub_ts, rank, bid, time_us)) {
         eof_ = true;
         break;
       }
@@ -151,5 +227,9 @@ public:
 
   bool first_read_;
   bool prev_set_;
+
+  std::unique_ptr<ThreadPool> own_pool_;  // set if not given a pool
+  ThreadPool *const pool_;
+  std::unique_ptr<CSVRowParser> parser_;
 };
 } // namespace amr
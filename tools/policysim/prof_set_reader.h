@@ -1,23 +1,46 @@
 #pragma once
 
+#include <algorithm>
+#include <memory>
+
 #include "lb-common/policy.h"
 #include "prof_base.h"
 #include "prof_reader.h"
 #include "lb-common/trace_utils.h"
+#include "tools-common/thread_pool.h"
 
 namespace amr {
+//
+// ProfSetReader: combines the times of a set of profile files. With
+// nconcurrent > 1, up to nconcurrent files are read at once into
+// per-file buffers, which are then merged in file order under the
+// combine policy. All CSV files are parsed on one shared pool with a
+// thread per hardware thread, so concurrent reads queue their parse
+// chunks there instead of each starting threads of their own.
+//
 class ProfSetReader {
  public:
   explicit ProfSetReader(const std::vector<std::string>& fpaths,
-                         ProfTimeCombinePolicy combine_policy)
-      : nblocks_prev_(0) {
+                         ProfTimeCombinePolicy combine_policy,
+                         int nconcurrent = 1)
+      : combine_policy_(combine_policy), nblocks_prev_(0) {
     MLOG(MLOG_INFO, "[ProfSetReader] Combine Policy: %s",
          Utils::GetProfTimeCombinePolicyStr(combine_policy).c_str());
 
+    nconcurrent = std::min<int>(nconcurrent, fpaths.size());
+    if (nconcurrent > 1) {
+      MLOG(MLOG_INFO, "[ProfSetReader] Reading %d of %zu files at a time",
+           nconcurrent, fpaths.size());
+      pool_.reset(new ThreadPool(nconcurrent));
+    }
+
     for (auto& fpath : fpaths) {
       if (fpath.size() >= 4 and fpath.substr(fpath.size() - 4) == ".csv") {
-        all_readers_.emplace_back(
-            new CSVProfileReader(fpath.c_str(), combine_policy));
+        if (not parse_pool_) {
+          parse_pool_.reset(new ThreadPool(ThreadPool::DefaultNumThreads()));
+        }
+        all_readers_.emplace_back(new CSVProfileReader(
+            fpath.c_str(), combine_policy, parse_pool_.get()));
       } else {
         all_readers_.emplace_back(
             new BinProfileReader(fpath.c_str(), combine_policy));
@@ -53,15 +76,28 @@ class ProfSetReader {
     return nblocks;
   }
 
+  int SeekTimestep(int timestep) {
+    for (auto& reader : all_readers_) {
+      int rv = reader->SeekTimestep(timestep);
+      if (rv) return rv;
+    }
+
+    return 0;
+  }
+
   int ReadTimestep(int timestep, std::vector<int>& times) {
     std::fill(times.begin(), times.end(), 0);
 
     int nblocks = 0;
 
-    for (auto& reader : all_readers_) {
-      int nlines_read = 0;
-      int rnblocks = reader->ReadTimestep(timestep, times, nlines_read);
-      nblocks = std::max(nblocks, rnblocks);
+    if (pool_) {
+      nblocks = ReadTimestepConcurrent(timestep, times);
+    } else {
+      for (auto& reader : all_readers_) {
+        int nlines_read = 0;
+        int rnblocks = reader->ReadTimestep(timestep, times, nlines_read);
+        nblocks = std::max(nblocks, rnblocks);
+      }
     }
 
     MLOG(MLOG_DBG0, "Blocks read: %d", nblocks);
@@ -78,7 +114,54 @@ class ProfSetReader {
   }
 
  private:
+  int ReadTimestepConcurrent(int timestep, std::vector<int>& times) {
+    int nreaders = all_readers_.size();
+    bufs_.resize(nreaders);
+    std::vector<int> rnblocks(nreaders, 0);
+
+    pool_->ParallelFor(nreaders, [&](int i) {
+      int nlines_read = 0;
+      bufs_[i].assign(times.size(), 0);
+      rnblocks[i] = all_readers_[i]->ReadTimestep(timestep, bufs_[i],
+                                                  nlines_read);
+    });
+
+    int nblocks = 0;
+    for (int i = 0; i < nreaders; i++) {
+      nblocks = std::max(nblocks, rnblocks[i]);
+      MergeTimes(times, bufs_[i]);
+    }
+
+    return nblocks;
+  }
+
+  // MergeTimes: fold one file's times into times, as if it were read next.
+  // A buffer can't tell a zero time from a block missing in that file, so
+  // zeros are skipped. This only differs from a sequential read under
+  // kUseLast, where a later file's genuine zero would overwrite the time
+  void MergeTimes(std::vector<int>& times, std::vector<int> const& src) const {
+    if (times.size() < src.size()) {
+      times.resize(src.size(), 0);
+    }
+
+    for (size_t bid = 0; bid < src.size(); bid++) {
+      if (src[bid] == 0) continue;
+
+      if (combine_policy_ == ProfTimeCombinePolicy::kAdd) {
+        times[bid] += src[bid];
+      } else if (combine_policy_ == ProfTimeCombinePolicy::kUseFirst) {
+        if (times[bid] == 0) times[bid] = src[bid];
+      } else if (combine_policy_ == ProfTimeCombinePolicy::kUseLast) {
+        times[bid] = src[bid];
+      }
+    }
+  }
+
   std::vector<ProfileReader*> all_readers_;
+  const ProfTimeCombinePolicy combine_policy_;
+  std::unique_ptr<ThreadPool> parse_pool_;  // shared by the CSV readers
+  std::unique_ptr<ThreadPool> pool_;
+  std::vector<std::vector<int>> bufs_;  // per-file times, for pool_
   int nblocks_prev_;
 };
 }  // namespace amr
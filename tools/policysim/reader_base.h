@@ -4,6 +4,13 @@
 
 #pragma once
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
 #include <utility>
 
 #include "tools-common/logging.h"
@@ -42,4 +49,148 @@ class ReaderBase {
   std::string const fpath_;
   FILE* fd_;
 };
+
+//
+// MmapReaderBase: ReaderBase over a read-only mapping of the whole file.
+// Records are decoded straight from the mapping. The kernel is told the
+// access is sequential, the window ahead of the cursor is prefetched with
+// MADV_WILLNEED, and windows behind it are dropped with MADV_DONTNEED
+//
+class MmapReaderBase {
+ public:
+  explicit MmapReaderBase(std::string fpath)
+      : fpath_(std::move(fpath)),
+        fd_(-1),
+        data_(nullptr),
+        size_(0),
+        pos_(0),
+        advised_(0),
+        released_(0),
+        page_size_(sysconf(_SC_PAGESIZE)) {
+    fd_ = open(fpath_.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+      MLOG(MLOG_ERRO, "Unable to open file: %s\n", fpath_.c_str());
+      ABORT("Unable to open file");
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+      MLOG(MLOG_ERRO, "Unable to stat file: %s\n", fpath_.c_str());
+      ABORT("Unable to stat file");
+    }
+
+    size_ = st.st_size;
+    if (size_ == 0) return;  // nothing to map
+
+    void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (addr == MAP_FAILED) {
+      MLOG(MLOG_ERRO, "Unable to mmap file: %s\n", fpath_.c_str());
+      ABORT("Unable to mmap file");
+    }
+
+    data_ = static_cast<const char*>(addr);
+    madvise(addr, size_, MADV_SEQUENTIAL);
+    Prefetch();
+  }
+
+  MmapReaderBase(const MmapReaderBase& other) = delete;
+
+  MmapReaderBase& operator=(MmapReaderBase&& other) = delete;
+
+  MmapReaderBase(MmapReaderBase&& other) noexcept
+      : fpath_(other.fpath_),
+        fd_(other.fd_),
+        data_(other.data_),
+        size_(other.size_),
+        pos_(other.pos_),
+        advised_(other.advised_),
+        released_(other.released_),
+        page_size_(other.page_size_) {
+    other.fd_ = -1;
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+
+  ~MmapReaderBase() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char*>(data_), size_);
+      data_ = nullptr;
+    }
+
+    if (fd_ >= 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+
+ protected:
+  bool Eof() const { return pos_ >= size_; }
+
+  // Read: copy n ints at the cursor into dst. False on a short read
+  bool Read(int* dst, size_t n) {
+    size_t nbytes = n * sizeof(int);
+    if (size_ - pos_ < nbytes) {
+      pos_ = size_;
+      return false;
+    }
+
+    std::memcpy(dst, data_ + pos_, nbytes);
+    pos_ += nbytes;
+
+    // past the tail of the file there is nothing to prefetch, but
+    // consumed windows are still dropped
+    if (advised_ < size_ and pos_ + kPrefetchBytes / 2 > advised_) {
+      Prefetch();
+    } else if (pos_ >= released_ + kPrefetchBytes) {
+      Release();
+    }
+    return true;
+  }
+
+  size_t Tell() const { return pos_; }
+
+  void Seek(size_t pos) {
+    pos_ = std::min(pos, size_);
+    // only windows consumed from here on are dropped
+    released_ = pos_ / kPrefetchBytes * kPrefetchBytes;
+    if (data_ != nullptr) Prefetch();
+  }
+
+  // Data/Size: the whole mapping, for readers that seek on their own
+  const char* Data() const { return data_; }
+  size_t Size() const { return size_; }
+
+  std::string const fpath_;
+
+ private:
+  // Prefetch: WILLNEED the next window, DONTNEED whole windows consumed
+  void Prefetch() {
+    size_t beg = pos_ / page_size_ * page_size_;
+    size_t end = std::min(beg + kPrefetchBytes, size_);
+    madvise(const_cast<char*>(data_) + beg, end - beg, MADV_WILLNEED);
+    advised_ = end;
+
+    Release();
+  }
+
+  // Release: DONTNEED the whole windows behind the cursor not dropped yet
+  void Release() {
+    size_t done = pos_ / kPrefetchBytes * kPrefetchBytes;
+    if (done > released_) {
+      madvise(const_cast<char*>(data_) + released_, done - released_,
+              MADV_DONTNEED);
+      released_ = done;
+    }
+  }
+
+  static constexpr size_t kPrefetchBytes = 8 << 20;
+
+  int fd_;
+  const char* data_;
+  size_t size_;
+  size_t pos_;
+  size_t advised_;   // end of the range last prefetched
+  size_t released_;  // windows in [released_, pos_) are not dropped yet
+  const size_t page_size_;
+};
 }  // namespace amr
@@ -0,0 +1,57 @@
+//
+// stats-convert: turns binary policysim stats (policysim -B) back into
+// the summ/det/ranksum text files policysim writes by default
+//
+
+#include <pdlfs-common/env.h>
+
+#include "binary_stats.h"
+#include "policy_stats.h"
+
+namespace {
+const std::string kSuffix = ".statsbin";
+
+int Convert(pdlfs::Env* env, std::string const& fpath) {
+  if (fpath.size() <= kSuffix.size() or
+      fpath.compare(fpath.size() - kSuffix.size(), kSuffix.size(), kSuffix)) {
+    MLOG(MLOG_ERRO, "[StatsConvert] Expected a %s file: %s", kSuffix.c_str(),
+         fpath.c_str());
+    return -1;
+  }
+
+  std::string base = fpath.substr(0, fpath.size() - kSuffix.size());
+
+  amr::BinaryStatsReader reader(fpath);
+  amr::WritableFile fd_summ(env, base + ".summ");
+  amr::WritableFile fd_det(env, base + ".det");
+  amr::WritableFile fd_ranksum(env, base + ".ranksum");
+
+  amr::StatsRecord r;
+  int rv, nts = 0;
+  while ((rv = reader.ReadTimestep(r)) == 1) {
+    amr::PolicyStats::WriteSummary(fd_summ, r.ts, r.avg_us, r.max_us);
+    amr::PolicyStats::WriteDetailed(fd_det, r.costs, r.ranks);
+    amr::PolicyStats::WriteRankSums(fd_ranksum, r.ts, r.rank_times);
+    nts++;
+  }
+
+  MLOG(MLOG_INFO, "[StatsConvert] %s: %d timesteps", fpath.c_str(), nts);
+  return rv;
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "\n\tUsage: %s <policy.statsbin>...\n", argv[0]);
+    return -1;
+  }
+
+  pdlfs::Env* env = pdlfs::Env::Default();
+
+  int rv = 0;
+  for (int i = 1; i < argc; i++) {
+    if (Convert(env, argv[i]) != 0) rv = -1;
+  }
+
+  return rv;
+}
@@ -0,0 +1,124 @@
+//
+// trace-convert: packs the refinement, assignment and profile traces of a
+// profile dir into one columnar trace (see columnar_trace.h)
+//
+
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include <climits>
+
+#include "block_alloc_sim.h"
+
+amr::BlockSimulatorOpts options;
+std::string out_path;
+
+void PrintHelp(int argc, char* argv[]) {
+  fprintf(stderr,
+          "\n\tUsage: %s -p <profile_dir> [-o <out_path>] [-e <events>] "
+          "[-c <combine_policy>] [-n <nts>]\n",
+          argv[0]);
+  exit(-1);
+}
+
+void ParseCsvStr(const char* str, std::vector<int>& vals) {
+  vals.clear();
+  int num, nb;
+
+  while (sscanf(str, "%d%n", &num, &nb) >= 1) {
+    vals.push_back(num);
+    str += nb;
+    if (str[0] != ',') break;
+    str += 1;
+  }
+}
+
+void ParseOptions(int argc, char* argv[]) {
+  extern char* optarg;
+  int c;
+
+  options.prof_dir = "";
+  options.prof_time_combine_policy = "add";
+  options.nts = INT_MAX;
+  options.prof_read_concurrency = 4;
+
+  while ((c = getopt(argc, argv, "c:e:hn:o:p:")) != -1) {
+    switch (c) {
+      case 'c':
+        options.prof_time_combine_policy = optarg;
+        break;
+      case 'e':
+        ParseCsvStr(optarg, options.events);
+        break;
+      case 'h':
+        PrintHelp(argc, argv);
+        break;
+      case 'n':
+        options.nts = atoi(optarg);
+        break;
+      case 'o':
+        out_path = optarg;
+        break;
+      case 'p':
+        options.prof_dir = optarg;
+        break;
+    }
+  }
+
+  options.env = pdlfs::Env::Default();
+
+  if (options.prof_dir.empty()) {
+    MLOG(MLOG_ERRO, "No profile_dir specified!");
+    PrintHelp(argc, argv);
+  }
+
+  if (!options.env->FileExists(options.prof_dir.c_str())) {
+    MLOG(MLOG_ERRO, "Directory does not exist!!!");
+    PrintHelp(argc, argv);
+  }
+
+  if (out_path.empty()) {
+    out_path = options.prof_dir + "/trace.amrt";
+  }
+}
+
+uint64_t FileSize(std::string const& fpath) {
+  struct stat st;
+  return stat(fpath.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+int Run() {
+  amr::BlockSimulator sim(options);
+  amr::ColumnarTraceWriter writer(out_path);
+
+  int sub_ts;
+  for (sub_ts = 0; sub_ts < options.nts; sub_ts++) {
+    amr::TimestepTrace trace;
+    if (sim.ReadTimestep(sub_ts, trace) == 0) break;
+    if (writer.Append(trace) != 0) return -1;
+  }
+
+  int rv = writer.Close();
+  if (rv) return rv;
+
+  uint64_t bytes_in = FileSize(options.prof_dir + "/refinements.bin") +
+                      FileSize(options.prof_dir + "/assignments.bin");
+  for (auto& fpath : amr::Utils::LocateTraceFiles(
+           options.env, options.prof_dir, options.events)) {
+    bytes_in += FileSize(fpath);
+  }
+  uint64_t bytes_out = FileSize(out_path);
+
+  MLOG(MLOG_INFO, "[TraceConvert] %d timesteps -> %s", sub_ts,
+       out_path.c_str());
+  MLOG(MLOG_INFO, "[TraceConvert] %.2lf MB -> %.2lf MB (%.1lfx)",
+       bytes_in / 1e6, bytes_out / 1e6,
+       bytes_out ? bytes_in * 1.0 / bytes_out : 0.0);
+
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  ParseOptions(argc, argv);
+  return Run();
+}
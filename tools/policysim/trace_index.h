@@ -0,0 +1,154 @@
+#pragma once
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "tools-common/logging.h"
+
+namespace amr {
+//
+// TraceIndex: sidecar index (<trace>.idx) mapping sub_ts to the byte
+// offset of its first record in a trace file, so readers can seek to a
+// window instead of stepping from the start. Built once by a reader
+// specific scan, and rebuilt if the trace's size or mtime changes.
+// Ranks of a parallel replay may build the same index at once: each
+// writes its own temp file and renames it into place, and an index that
+// fails validation on load is rebuilt.
+//
+// Layout: magic[8], u64 trace_size, i64 trace_mtime, u64 n,
+// then n x {i32 sub_ts, u64 offset}, in file order
+//
+class TraceIndex {
+ public:
+  struct Entry {
+    int sub_ts;
+    uint64_t offset;
+  };
+
+  // LoadOrBuild: build(entries) returns 0 on success
+  template <typename F>
+  static int LoadOrBuild(std::string const& trace_path,
+                         std::vector<Entry>& entries, F build) {
+    std::string idx_path = trace_path + ".idx";
+
+    uint64_t size;
+    int64_t mtime;
+    if (Stat(trace_path, size, mtime) != 0) {
+      MLOG(MLOG_ERRO, "[TraceIndex] Unable to stat: %s", trace_path.c_str());
+      return -1;
+    }
+
+    if (Load(idx_path, size, mtime, entries) == 0) return 0;
+
+    MLOG(MLOG_INFO, "[TraceIndex] Building: %s", idx_path.c_str());
+    entries.clear();
+    int rv = build(entries);
+    if (rv) return rv;
+
+    // an unwritable sidecar only costs a rebuild next time
+    if (Save(idx_path, size, mtime, entries) != 0) {
+      MLOG(MLOG_WARN, "[TraceIndex] Unable to save: %s", idx_path.c_str());
+    }
+
+    return 0;
+  }
+
+  // Lookup: offset of the first record with sub_ts >= sub_ts, or eof_off
+  static uint64_t Lookup(std::vector<Entry> const& entries, int sub_ts,
+                         uint64_t eof_off) {
+    auto it = std::lower_bound(
+        entries.begin(), entries.end(), sub_ts,
+        [](Entry const& e, int key) { return e.sub_ts < key; });
+    return it == entries.end() ? eof_off : it->offset;
+  }
+
+  static int Stat(std::string const& fpath, uint64_t& size, int64_t& mtime) {
+    struct stat st;
+    if (stat(fpath.c_str(), &st) != 0) return -1;
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return 0;
+  }
+
+ private:
+  static const char* Magic() { return "AMRIDX1\0"; }
+
+  static int Load(std::string const& idx_path, uint64_t size, int64_t mtime,
+                  std::vector<Entry>& entries) {
+    FILE* f = fopen(idx_path.c_str(), "rb");
+    if (f == nullptr) return -1;
+
+    char magic[8];
+    uint64_t idx_size, n;
+    int64_t idx_mtime;
+    bool ok = fread(magic, 1, 8, f) == 8 and
+              memcmp(magic, Magic(), 8) == 0 and
+              fread(&idx_size, sizeof(idx_size), 1, f) == 1 and
+              fread(&idx_mtime, sizeof(idx_mtime), 1, f) == 1 and
+              fread(&n, sizeof(n), 1, f) == 1 and idx_size == size and
+              idx_mtime == mtime and n <= size;
+
+    if (ok) {
+      entries.resize(n);
+      for (size_t i = 0; ok and i < n; i++) {
+        auto& e = entries[i];
+        int32_t sub_ts;
+        ok = fread(&sub_ts, sizeof(sub_ts), 1, f) == 1 and
+             fread(&e.offset, sizeof(e.offset), 1, f) == 1;
+        e.sub_ts = sub_ts;
+
+        // entries must be in file order, and point into the trace
+        ok = ok and e.offset < size and
+             (i == 0 or (e.sub_ts >= entries[i - 1].sub_ts and
+                         e.offset > entries[i - 1].offset));
+      }
+    }
+
+    fclose(f);
+    if (not ok) entries.clear();
+    return ok ? 0 : -1;
+  }
+
+  static int Save(std::string const& idx_path, uint64_t size, int64_t mtime,
+                  std::vector<Entry> const& entries) {
+    // write to a temp file of our own, so a concurrent reader never sees a
+    // partial index, and concurrent writers do not clobber each other
+    std::string tmp_path = idx_path + ".tmp.XXXXXX";
+    int fd = mkstemp(&tmp_path[0]);
+    if (fd < 0) return -1;
+
+    FILE* f = fdopen(fd, "wb");
+    if (f == nullptr) {
+      close(fd);
+      unlink(tmp_path.c_str());
+      return -1;
+    }
+
+    uint64_t n = entries.size();
+    bool ok = fwrite(Magic(), 1, 8, f) == 8 and
+              fwrite(&size, sizeof(size), 1, f) == 1 and
+              fwrite(&mtime, sizeof(mtime), 1, f) == 1 and
+              fwrite(&n, sizeof(n), 1, f) == 1;
+
+    for (auto const& e : entries) {
+      int32_t sub_ts = e.sub_ts;
+      ok = ok and fwrite(&sub_ts, sizeof(sub_ts), 1, f) == 1 and
+           fwrite(&e.offset, sizeof(e.offset), 1, f) == 1;
+    }
+
+    ok = (fclose(f) == 0) and ok;
+    if (ok) ok = rename(tmp_path.c_str(), idx_path.c_str()) == 0;
+    if (not ok) unlink(tmp_path.c_str());
+
+    return ok ? 0 : -1;
+  }
+};
+}  // namespace amr